@@ -0,0 +1,402 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <thread>
+
+#include "tic_tac_toe.h"
+#include "minimax.h"
+#include "qlearning.h"
+#include "opponents.h"
+#include "player.h"
+#include "position_table.h"
+#include "training.h"
+#include "mcts.h"
+#include "rng.h"
+
+// micro-benchmarks for the hot paths of training, matchup and analysis
+//
+//   benchmark [--reps N] [--warmup N] [--filter text] [--csv file] [--json file] [--seed N]
+//
+// every benchmark runs a fixed number of operations per repetition; the
+// reported figures are nanoseconds per operation across repetitions
+
+struct BenchResult {
+    std::string name;
+    long long opsPerRep;
+    int reps;
+    double mean, min, p50, p90, p99, max; // ns per op
+};
+
+struct BenchConfig {
+    int reps = 30;
+    int warmup = 3;
+    std::string filter;
+};
+
+// results are folded in here so the optimiser can't drop the work
+static volatile long long g_sink = 0;
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    double pos = p * (sorted.size() - 1);
+    size_t lo = size_t(pos);
+    size_t hi = std::min(lo + 1, sorted.size() - 1);
+    double frac = pos - double(lo);
+    return sorted[lo] * (1.0 - frac) + sorted[hi] * frac;
+}
+
+// op(i) is called opsPerRep times per repetition
+template <typename Op>
+static void runBench(const BenchConfig& cfg, std::vector<BenchResult>& results,
+                     const std::string& name, long long opsPerRep, Op op) {
+    if (!cfg.filter.empty() && name.find(cfg.filter) == std::string::npos) {
+        return;
+    }
+    using namespace std::chrono;
+
+    for (int w = 0; w < cfg.warmup; ++w) {
+        for (long long i = 0; i < opsPerRep; ++i) op(i);
+    }
+
+    std::vector<double> perOp;
+    perOp.reserve(cfg.reps);
+    for (int r = 0; r < cfg.reps; ++r) {
+        auto start = steady_clock::now();
+        for (long long i = 0; i < opsPerRep; ++i) op(i);
+        auto end = steady_clock::now();
+        double ns = double(duration_cast<nanoseconds>(end - start).count());
+        perOp.push_back(ns / double(opsPerRep));
+    }
+
+    std::vector<double> sorted = perOp;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (double v : perOp) sum += v;
+
+    BenchResult res;
+    res.name = name;
+    res.opsPerRep = opsPerRep;
+    res.reps = cfg.reps;
+    res.mean = sum / double(perOp.size());
+    res.min = sorted.front();
+    res.p50 = percentile(sorted, 0.50);
+    res.p90 = percentile(sorted, 0.90);
+    res.p99 = percentile(sorted, 0.99);
+    res.max = sorted.back();
+    results.push_back(res);
+
+    std::printf("%-56s %12.1f %12.1f %12.1f %12.1f\n",
+                name.c_str(), res.p50, res.p90, res.p99, res.mean);
+    std::fflush(stdout);
+}
+
+// a few moves into a game: 1 in the centre, 2 in a corner, 1 opposite
+static TicTacToe midGame() {
+    TicTacToe game;
+    game.makeMove(1, 1, 1);
+    game.makeMove(0, 0, 2);
+    game.makeMove(2, 0, 1);
+    return game;
+}
+
+// loadPolicy/savePolicy print a line per call, which would swamp the table
+struct QuietCout {
+    std::streambuf* saved;
+    QuietCout() : saved(std::cout.rdbuf(nullptr)) {}
+    ~QuietCout() {
+        std::cout.rdbuf(saved);
+        std::cout.clear();
+    }
+};
+
+static bool fileExists(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    return bool(in);
+}
+
+static void benchBoard(const BenchConfig& cfg, std::vector<BenchResult>& results) {
+    TicTacToe game = midGame();
+    runBench(cfg, results, "board/checkWin", 1000000, [&](long long) {
+        g_sink += game.checkWin();
+    });
+    runBench(cfg, results, "board/isGameOver", 1000000, [&](long long) {
+        g_sink += game.isGameOver();
+    });
+    runBench(cfg, results, "board/makeMove+undoMove", 1000000, [&](long long i) {
+        int c = int(i % 9);
+        if (game.makeMove(c % 3, c / 3, 2)) {
+            game.undoMove(c % 3, c / 3);
+        }
+        g_sink += game.positionIndex();
+    });
+
+    QLearningAgent agent;
+    runBench(cfg, results, "board/encodeBoard", 1000000, [&](long long) {
+        g_sink += agent.encodeBoard(game.getBoard())[4];
+    });
+}
+
+static void benchMinimax(const BenchConfig& cfg, std::vector<BenchResult>& results) {
+    Minimax mm;
+    TicTacToe empty;
+    TicTacToe mid = midGame();
+    runBench(cfg, results, "minimax/scorePosition empty", 1, [&](long long) {
+        g_sink += static_cast<long long>(mm.scorePosition(empty, 1) * 2);
+    });
+    runBench(cfg, results, "minimax/scorePosition mid-game", 100, [&](long long) {
+        g_sink += static_cast<long long>(mm.scorePosition(mid, 2) * 2);
+    });
+    runBench(cfg, results, "minimax/getBestMove empty", 1, [&](long long) {
+        g_sink += mm.getBestMove(empty, 1).x;
+    });
+    runBench(cfg, results, "minimax/getBestMove mid-game", 100, [&](long long) {
+        g_sink += mm.getBestMove(mid, 2).x;
+    });
+
+    // root split over the nine opening moves
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    for (int threads = 2; threads <= int(cores) && threads <= 16; threads *= 2) {
+        Minimax split;
+        split.setThreads(threads);
+        runBench(cfg, results, "minimax/getBestMove empty, " + std::to_string(threads) + " threads", 1,
+                 [&](long long) {
+            g_sink += split.getBestMove(empty, 1).x;
+        });
+    }
+}
+
+// one search from the empty board per op, without tree reuse, at
+// increasing thread counts: playouts/s = playouts * 1e9 / ns
+static void benchMcts(const BenchConfig& cfg, std::vector<BenchResult>& results) {
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    for (int threads = 1; threads <= int(cores) && threads <= 16; threads *= 2) {
+        MctsConfig mc;
+        mc.threads = threads;
+        mc.playouts = 20000;
+        Mcts mcts(mc);
+        TicTacToe empty;
+        runBench(cfg, results, "mcts/getBestMove empty 20000 playouts, " + std::to_string(threads)
+                 + (threads == 1 ? " thread" : " threads"), 1, [&](long long) {
+            mcts.reset();
+            g_sink += mcts.getBestMove(empty, 1).x;
+        });
+    }
+}
+
+static void benchAgent(const BenchConfig& cfg, std::vector<BenchResult>& results) {
+    QLearningAgent agent(0.1, 1.0, 0.2);
+    {
+        QuietCout quiet;
+        agent.loadPolicy("q_policy.dat");
+    }
+    TicTacToe game = midGame();
+    std::string state = agent.encodeBoard(game.getBoard());
+    TicTacToe next = game;
+    next.makeMove(0, 2, 2);
+    std::string nextState = agent.encodeBoard(next.getBoard());
+
+    runBench(cfg, results, "agent/chooseAction", 1000000, [&](long long) {
+        g_sink += agent.chooseAction(game);
+    });
+    runBench(cfg, results, "agent/updateQ", 1000000, [&](long long i) {
+        agent.updateQ(state, int(i % 2) * 2 + 1, nextState, 0.0, false);
+    });
+
+    // the function approximation backends, same calls
+    for (QModelKind kind : { QModelKind::Linear, QModelKind::Mlp }) {
+        std::string name = (kind == QModelKind::Linear) ? "linear" : "mlp";
+        QModelConfig mc;
+        mc.kind = kind;
+        QLearningAgent modelAgent(0.1, 1.0, 0.0);
+        modelAgent.setModel(mc);
+        runBench(cfg, results, "agent/chooseAction " + name, 1000000, [&](long long) {
+            g_sink += modelAgent.chooseAction(game);
+        });
+        runBench(cfg, results, "agent/updateQ " + name, 1000000, [&](long long i) {
+            modelAgent.updateQ(state, int(i % 2) * 2 + 1, nextState, 0.0, false);
+        });
+
+        // every playable position through the model in blocks of 256
+        std::vector<PolicyEntry> entries;
+        runBench(cfg, results, "agent/copyTable " + name, 100, [&](long long) {
+            modelAgent.copyTable(entries);
+            g_sink += static_cast<long long>(entries.size());
+        });
+    }
+}
+
+// the same 256 boards asked one call per board, then in one batch call;
+// an op is the whole block of boards
+static void benchBatch(const BenchConfig& cfg, std::vector<BenchResult>& results) {
+    const int kBoards = 256;
+    std::vector<uint16_t> positions;
+    for (int index = 0; index < kNumPositions; ++index) {
+        if (isPlayablePosition(index) && positionInfo(index).legalMoves) {
+            positions.push_back(uint16_t(index));
+        }
+    }
+    size_t stride = std::max<size_t>(1, positions.size() / kBoards);
+    for (int i = 0; i < kBoards; ++i) {
+        positions[i] = positions[i * stride];
+    }
+    positions.resize(kBoards);
+    std::vector<TicTacToe> games;
+    for (uint16_t index : positions) {
+        games.push_back(TicTacToe::fromPositionIndex(index));
+    }
+    std::vector<int8_t> actions(kBoards);
+    Rng rng = makeStream(nextStreamId());
+
+    QLearningAgent agent(0.1, 1.0, 0.0);
+    {
+        QuietCout quiet;
+        agent.loadPolicy("q_policy.dat");
+    }
+    runBench(cfg, results, "batch/chooseAction x256", 1000, [&](long long) {
+        for (const TicTacToe& g : games) g_sink += agent.chooseAction(g);
+    });
+    runBench(cfg, results, "batch/chooseActions 256", 1000, [&](long long) {
+        agent.chooseActions(positions.data(), kBoards, actions.data());
+        g_sink += actions[0];
+    });
+
+    TablePlayer table("minimax", minimaxTable());
+    runBench(cfg, results, "batch/TablePlayer::move x256", 1000, [&](long long) {
+        for (size_t i = 0; i < games.size(); ++i) {
+            g_sink += table.move(games[i], positionInfo(positions[i]).toMove, rng).x;
+        }
+    });
+    runBench(cfg, results, "batch/TablePlayer::moves 256", 1000, [&](long long) {
+        table.moves(positions.data(), kBoards, actions.data(), rng);
+        g_sink += actions[0];
+    });
+
+    Minimax mm;
+    runBench(cfg, results, "batch/Minimax::getBestMove x256", 1, [&](long long) {
+        for (size_t i = 0; i < games.size(); ++i) {
+            g_sink += mm.getBestMove(games[i], positionInfo(positions[i]).toMove, rng).x;
+        }
+    });
+    runBench(cfg, results, "batch/Minimax::getBestMoves 256", 1, [&](long long) {
+        mm.getBestMoves(positions.data(), kBoards, actions.data(), rng);
+        g_sink += actions[0];
+    });
+}
+
+static void benchPolicyFiles(const BenchConfig& cfg, std::vector<BenchResult>& results) {
+    const char* files[] = { "q_policy.dat", "player1_policy.dat",
+                            "2m-episode-model/q_policy.dat", "random_100m_episode/q_policy_random.dat" };
+    for (const char* file : files) {
+        if (!fileExists(file)) {
+            continue;
+        }
+        QLearningAgent agent;
+        QuietCout quiet;
+        agent.loadPolicy(file);
+        runBench(cfg, results, std::string("policy/loadPolicy ") + file, 1, [&](long long) {
+            agent.loadPolicy(file);
+        });
+        runBench(cfg, results, std::string("policy/savePolicy ") + file, 1, [&](long long) {
+            agent.savePolicy("benchmark_tmp.dat");
+        });
+        std::remove("benchmark_tmp.dat");
+    }
+}
+
+static void benchEpisodes(const BenchConfig& cfg, std::vector<BenchResult>& results) {
+    Minimax mm;
+    Rng rng = makeStream(nextStreamId());
+
+    struct Opponent {
+        const char* name;
+        long long episodes;
+        OpponentMoveFn move;
+    };
+    std::vector<Opponent> opponents = {
+        { "minimax", 20, [&](TicTacToe& g, int p) { return mm.getBestMove(g, p, rng); } },
+        { "random", 10000, [&](TicTacToe& g, int p) { return getRandomMove(g, p, rng); } },
+        { "buggy", 10000, [&](TicTacToe& g, int p) { return getBuggyMinimaxMove(g, p, rng); } },
+        { "buggy2", 10000, [&](TicTacToe& g, int p) { return getBuggyMinimaxMove2(g, p, rng); } },
+    };
+    for (const Opponent& opp : opponents) {
+        QLearningAgent agent(0.1, 1.0, 0.2);
+        runBench(cfg, results, std::string("episode/vs ") + opp.name, opp.episodes, [&](long long) {
+            playTrainingEpisode(agent, opp.move);
+        });
+    }
+
+    QLearningAgent agent1(0.1, 1.0, 0.2);
+    QLearningAgent agent2(0.1, 1.0, 0.2);
+    runBench(cfg, results, "episode/self-play", 10000, [&](long long) {
+        playSelfPlayEpisode(agent1, agent2);
+    });
+}
+
+static void writeCsv(const std::string& filename, const std::vector<BenchResult>& results) {
+    std::ofstream out(filename);
+    out << "name,ops_per_rep,reps,mean_ns,min_ns,p50_ns,p90_ns,p99_ns,max_ns\n";
+    for (const BenchResult& r : results) {
+        out << '"' << r.name << "\"," << r.opsPerRep << ',' << r.reps << ','
+            << r.mean << ',' << r.min << ',' << r.p50 << ',' << r.p90 << ','
+            << r.p99 << ',' << r.max << "\n";
+    }
+}
+
+static void writeJson(const std::string& filename, const std::vector<BenchResult>& results,
+                      uint64_t seed) {
+    std::ofstream out(filename);
+    out << "{\n  \"seed\": " << seed << ",\n  \"unit\": \"ns/op\",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"ops_per_rep\": " << r.opsPerRep
+            << ", \"reps\": " << r.reps << ", \"mean\": " << r.mean
+            << ", \"min\": " << r.min << ", \"p50\": " << r.p50
+            << ", \"p90\": " << r.p90 << ", \"p99\": " << r.p99
+            << ", \"max\": " << r.max << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+    // fixed default seed so two runs measure the same games
+    setRootSeed(12345);
+    uint64_t seed = rootSeed();
+
+    BenchConfig cfg;
+    std::string csvFile, jsonFile;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--reps")        cfg.reps = std::max(1, std::atoi(argv[i + 1]));
+        else if (arg == "--warmup") cfg.warmup = std::max(0, std::atoi(argv[i + 1]));
+        else if (arg == "--filter") cfg.filter = argv[i + 1];
+        else if (arg == "--csv")    csvFile = argv[i + 1];
+        else if (arg == "--json")   jsonFile = argv[i + 1];
+        else if (arg == "--seed")   seed = seedFromArgs(argc, argv);
+        else {
+            std::cerr << "unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+
+    std::cout << "Tic-Tac-Toe benchmarks (seed " << seed << ", " << cfg.reps
+              << " reps, " << cfg.warmup << " warm-up)\n\n";
+    std::printf("%-56s %12s %12s %12s %12s\n", "ns/op", "p50", "p90", "p99", "mean");
+
+    std::vector<BenchResult> results;
+    benchBoard(cfg, results);
+    benchMinimax(cfg, results);
+    benchMcts(cfg, results);
+    benchAgent(cfg, results);
+    benchBatch(cfg, results);
+    benchPolicyFiles(cfg, results);
+    benchEpisodes(cfg, results);
+
+    if (!csvFile.empty()) writeCsv(csvFile, results);
+    if (!jsonFile.empty()) writeJson(jsonFile, results, seed);
+    return 0;
+}
@@ -0,0 +1,251 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <set>
+#include <functional>
+#include <cstdlib>
+
+#include "opening_book.h"
+#include "grid_game.h"
+#include "iterative_minimax.h"
+#include "tablebase.h"
+#include "opponents.h"
+#include "player.h"
+#include "game_record.h"
+#include "position_table.h"
+
+// writes an opening book for Minimax (--book), matchup, tic_tac_toe and
+// IterativeMinimax (--id-book)
+//
+//   book_build --from minimax [--plies N] [--out file]
+//   book_build --from policy file.dat [--plies N] [--out file]
+//   book_build --from records games.tttg [--plies N] [--out file]
+//   book_build --from tablebase file.ttb [--plies N] [--out file]
+//   book_build --from search --size N --k K [--plies N] [--id-ms N] ... [--out file]
+//   book_build --show file
+//
+// minimax, policy and records are 3x3; tablebase is its own board;
+// search runs IterativeMinimax (the --id-* options) on every opening
+// of a larger board. the first three and the last two cover every
+// position both sides can reach in --plies plies (default 2); records
+// covers the positions the games went through, weighting each move by
+// how often the side that did not lose played it.
+// default output book_<N>x<N>_k<K>.ttob
+
+// calls fn for every position of the first plies that is not over, each
+// once however it is reached, both sides playing every move
+static void forEachOpening(int size, int inRow, int plies, const std::function<void(GridGame&)>& fn) {
+    std::set<std::pair<uint64_t, uint64_t>> seen;
+    GridGame game(size, inRow);
+    std::function<void()> visit = [&]() {
+        if (game.isGameOver() || game.filledCount() >= plies
+            || !seen.insert({ game.piecesOf(1), game.piecesOf(2) }).second) {
+            return;
+        }
+        fn(game);
+        int player = game.toMove();
+        uint64_t empty = game.emptyCells();
+        for (int c = 0; c < game.cells(); ++c) {
+            if ((empty >> c) & 1) {
+                game.makeMove(c, player);
+                visit();
+                game.undoMove(c);
+            }
+        }
+    };
+    visit();
+}
+
+static int positionIndexOf(const GridGame& game) {
+    int index = 0;
+    for (int c = 0; c < 9; ++c) {
+        index += game.at(c) * kPow3[c];
+    }
+    return index;
+}
+
+// minimax's equivalence set, in the x-then-y order getBestMove scans, so
+// that its draws from the book match its draws after a search
+static void fromMinimax(OpeningBook& book, int plies) {
+    forEachOpening(3, 3, plies, [&](GridGame& game) {
+        uint16_t mask = minimaxTable().responses(positionIndexOf(game));
+        for (int x = 0; x < 3; ++x) {
+            for (int y = 0; y < 3; ++y) {
+                if ((mask >> (y * 3 + x)) & 1) {
+                    book.add(game.piecesOf(1), game.piecesOf(2), y * 3 + x, 1);
+                }
+            }
+        }
+    });
+}
+
+static bool fromPolicy(OpeningBook& book, int plies, const std::string& file) {
+    PolicyPlayer policy(file);
+    if (!policy.load(file)) {
+        std::cerr << "could not read " << file << "\n";
+        return false;
+    }
+    forEachOpening(3, 3, plies, [&](GridGame& game) {
+        int action = policy.greedyMove(positionIndexOf(game));
+        if (action >= 0) {
+            book.add(game.piecesOf(1), game.piecesOf(2), action, 1);
+        }
+    });
+    return true;
+}
+
+static bool fromRecords(OpeningBook& book, int plies, const std::string& file) {
+    GameRecordFile records;
+    if (!records.open(file)) {
+        std::cerr << "could not read " << file << "\n";
+        return false;
+    }
+    long long games = records.forEach([&](const GameRecord& record) {
+        GridGame game(3, 3);
+        for (int i = 0; i < record.count && i < plies; ++i) {
+            int player = game.toMove();
+            if (record.winner == 0 || record.winner == player) {
+                book.add(game.piecesOf(1), game.piecesOf(2), record.moves[i], 1);
+            }
+            game.makeMove(record.moves[i], player);
+        }
+    });
+    if (games < 0) {
+        std::cerr << file << " is truncated or corrupt\n";
+        return false;
+    }
+    std::cout << games << " games read\n";
+    return true;
+}
+
+static bool fromTablebase(OpeningBook& book, int plies, const Tablebase& tb) {
+    forEachOpening(tb.size(), tb.inRow(), plies, [&](GridGame& game) {
+        uint64_t best = tb.bestCells(game);
+        for (int c = 0; c < game.cells(); ++c) {
+            if ((best >> c) & 1) {
+                book.add(game.piecesOf(1), game.piecesOf(2), c, 1);
+            }
+        }
+    });
+    return true;
+}
+
+static void fromSearch(OpeningBook& book, int plies, int size, int inRow, const IterativeMinimaxConfig& cfg) {
+    IterativeMinimax search(cfg);
+    long long positions = 0;
+    forEachOpening(size, inRow, plies, [&](GridGame& game) {
+        GridGame copy = game;
+        search.getBestCell(copy);
+        for (int c : search.lastBestCells()) {
+            book.add(game.piecesOf(1), game.piecesOf(2), c, 1);
+        }
+        if (++positions % 100 == 0) {
+            std::cout << positions << " positions searched\r" << std::flush;
+        }
+    });
+    std::cout << positions << " positions searched\n";
+}
+
+static int show(const std::string& file) {
+    OpeningBook book;
+    std::string error;
+    if (!book.load(file, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+    std::cout << file << ": " << book.size() << "x" << book.size() << ", " << book.inRow()
+              << " in a row, first " << book.plies() << " plies, " << book.positions()
+              << " positions, " << book.moveCount() << " moves\n";
+    // the empty board's moves, as a sample
+    int count;
+    const BookMove* moves = book.find(0, 0, count);
+    if (count > 0) {
+        std::cout << "empty board:";
+        for (int i = 0; i < count; ++i) {
+            std::cout << " (" << moves[i].cell % book.size() << "," << moves[i].cell / book.size()
+                      << ") x" << moves[i].weight;
+        }
+        std::cout << "\n";
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::string from;
+    std::string source;
+    std::string out;
+    int plies = 2;
+    int size = 3;
+    int inRow = 3;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : "";
+        if (arg == "--show") {
+            return show(value);
+        }
+        if (arg == "--from") {
+            from = value;
+            if ((from == "policy" || from == "records" || from == "tablebase") && i + 2 < argc) {
+                source = argv[i + 2];
+                ++i;
+            }
+        }
+        else if (arg == "--plies") plies = std::atoi(value);
+        else if (arg == "--size")  size = std::atoi(value);
+        else if (arg == "--k")     inRow = std::atoi(value);
+        else if (arg == "--out")   out = value;
+        else if (arg.compare(0, 5, "--id-") != 0) {
+            std::cerr << "unknown option " << arg << "\n";
+            return 1;
+        }
+        ++i;
+    }
+    if (plies < 1 || plies > 255) {
+        std::cerr << "--plies must be 1 to 255\n";
+        return 1;
+    }
+
+    Tablebase tb;
+    if (from == "tablebase") {
+        std::string error;
+        if (!tb.open(source, error)) {
+            std::cerr << error << "\n";
+            return 1;
+        }
+        size = tb.size();
+        inRow = tb.inRow();
+    } else if (from != "search") {
+        size = 3;
+        inRow = 3;
+    }
+    if (size < 1 || size > GridGame::kMaxSize || inRow < 1 || inRow > size) {
+        std::cerr << "need 1 <= k <= size <= " << GridGame::kMaxSize << "\n";
+        return 1;
+    }
+
+    OpeningBook book(size, inRow, plies);
+    bool ok = true;
+    if (from == "minimax")        fromMinimax(book, plies);
+    else if (from == "policy")    ok = fromPolicy(book, plies, source);
+    else if (from == "records")   ok = fromRecords(book, plies, source);
+    else if (from == "tablebase") ok = fromTablebase(book, plies, tb);
+    else if (from == "search")    fromSearch(book, plies, size, inRow, iterativeMinimaxConfigFromArgs(argc, argv));
+    else {
+        std::cerr << "--from minimax, policy file, records file, tablebase file or search\n";
+        return 1;
+    }
+    if (!ok) {
+        return 1;
+    }
+    book.finish();
+    if (out.empty()) {
+        out = openingBookFileName(size, inRow);
+    }
+    if (!book.save(out)) {
+        std::cerr << "could not write " << out << "\n";
+        return 1;
+    }
+    std::cout << "Wrote " << out << ": " << book.positions() << " positions, "
+              << book.moveCount() << " moves, first " << plies << " plies\n";
+    return 0;
+}
@@ -1,15 +1,46 @@
 @echo off
+rem add -DTTT_PROFILE to a line to build it with the profiling probes on (see profiler.h)
 echo Building analyze_policy...
-g++ -o analyze_policy analyze_policy.cpp qlearning.cpp minimax.cpp tic_tac_toe.cpp
+g++ -std=c++17 -O2 -pthread -o analyze_policy analyze_policy.cpp policy_analysis.cpp opponents.cpp qlearning.cpp q_model.cpp minimax.cpp opening_book.cpp thread_pool.cpp tic_tac_toe.cpp position_table.cpp rng.cpp profiler.cpp
 
 echo Building tic_tac_toe...
-g++ -o tic_tac_toe main.cpp tic_tac_toe.cpp minimax.cpp qlearning.cpp opponents.cpp
+g++ -std=c++17 -O2 -pthread -o tic_tac_toe main.cpp mcts.cpp player.cpp policy_analysis.cpp tic_tac_toe.cpp position_table.cpp rng.cpp minimax.cpp opening_book.cpp thread_pool.cpp qlearning.cpp q_model.cpp opponents.cpp training.cpp game_record.cpp policy_snapshot.cpp telemetry.cpp profiler.cpp
 
 echo Building train_selfplay...
-g++ -o train_selfplay tic_tac_toe.cpp qlearning.cpp minimax.cpp train_selfplay.cpp
+g++ -std=c++17 -O2 -pthread -o train_selfplay tic_tac_toe.cpp position_table.cpp rng.cpp qlearning.cpp q_model.cpp minimax.cpp opening_book.cpp thread_pool.cpp opponents.cpp training.cpp game_record.cpp policy_snapshot.cpp telemetry.cpp train_selfplay.cpp profiler.cpp
 
 echo Building matchup...
-g++ -o matchup matchup.cpp tic_tac_toe.cpp minimax.cpp qlearning.cpp opponents.cpp
+g++ -std=c++17 -O2 -pthread -o matchup matchup.cpp mcts.cpp iterative_minimax.cpp grid_game.cpp tablebase.cpp tournament.cpp player.cpp policy_analysis.cpp log_sink.cpp game_record.cpp outcome_stats.cpp tic_tac_toe.cpp position_table.cpp rng.cpp minimax.cpp opening_book.cpp thread_pool.cpp qlearning.cpp q_model.cpp opponents.cpp profiler.cpp
+
+echo Building benchmark...
+g++ -std=c++17 -O2 -pthread -o benchmark benchmark.cpp mcts.cpp player.cpp policy_analysis.cpp tic_tac_toe.cpp position_table.cpp rng.cpp minimax.cpp opening_book.cpp thread_pool.cpp qlearning.cpp q_model.cpp opponents.cpp training.cpp game_record.cpp policy_snapshot.cpp telemetry.cpp profiler.cpp
+
+echo Building convergence...
+g++ -std=c++17 -O2 -pthread -o convergence convergence.cpp policy_analysis.cpp tic_tac_toe.cpp position_table.cpp rng.cpp minimax.cpp opening_book.cpp thread_pool.cpp qlearning.cpp q_model.cpp opponents.cpp training.cpp game_record.cpp policy_snapshot.cpp telemetry.cpp profiler.cpp
+
+echo Building replay_games...
+g++ -std=c++17 -O2 -pthread -o replay_games replay_games.cpp game_record.cpp outcome_stats.cpp tic_tac_toe.cpp position_table.cpp profiler.cpp
+
+echo Building policy_server...
+g++ -std=c++17 -O2 -pthread -o policy_server policy_server.cpp policy_protocol.cpp policy_store.cpp player.cpp policy_analysis.cpp opponents.cpp qlearning.cpp q_model.cpp minimax.cpp opening_book.cpp thread_pool.cpp tic_tac_toe.cpp position_table.cpp rng.cpp profiler.cpp
+
+echo Building policy_load...
+g++ -std=c++17 -O2 -pthread -o policy_load policy_load.cpp policy_protocol.cpp position_table.cpp tic_tac_toe.cpp rng.cpp
+
+echo Building grid_match...
+g++ -std=c++17 -O2 -pthread -o grid_match grid_match.cpp iterative_minimax.cpp opening_book.cpp thread_pool.cpp grid_game.cpp tablebase.cpp tic_tac_toe.cpp position_table.cpp rng.cpp profiler.cpp
+
+echo Building tablebase_solve...
+g++ -std=c++17 -O2 -pthread -o tablebase_solve tablebase_solve.cpp tablebase.cpp grid_game.cpp thread_pool.cpp policy_analysis.cpp opponents.cpp qlearning.cpp q_model.cpp minimax.cpp opening_book.cpp tic_tac_toe.cpp position_table.cpp rng.cpp profiler.cpp
+
+echo Building train_distributed...
+g++ -std=c++17 -O2 -pthread -o train_distributed train_distributed.cpp policy_protocol.cpp policy_snapshot.cpp qlearning.cpp q_model.cpp opponents.cpp minimax.cpp opening_book.cpp thread_pool.cpp training.cpp game_record.cpp telemetry.cpp tic_tac_toe.cpp position_table.cpp rng.cpp profiler.cpp
+
+echo Building sweep...
+g++ -std=c++17 -O2 -pthread -o sweep sweep.cpp policy_analysis.cpp policy_snapshot.cpp qlearning.cpp q_model.cpp opponents.cpp minimax.cpp opening_book.cpp thread_pool.cpp training.cpp game_record.cpp telemetry.cpp tic_tac_toe.cpp position_table.cpp rng.cpp profiler.cpp
+
+echo Building book_build...
+g++ -std=c++17 -O2 -pthread -o book_build book_build.cpp opening_book.cpp iterative_minimax.cpp grid_game.cpp tablebase.cpp player.cpp policy_analysis.cpp game_record.cpp opponents.cpp qlearning.cpp q_model.cpp minimax.cpp thread_pool.cpp tic_tac_toe.cpp position_table.cpp rng.cpp profiler.cpp
 
 echo All builds completed
 pause
\ No newline at end of file
@@ -0,0 +1,246 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "tic_tac_toe.h"
+#include "minimax.h"
+#include "qlearning.h"
+#include "opponents.h"
+#include "training.h"
+#include "policy_analysis.h"
+#include "rng.h"
+
+// time-to-optimality harness: trains an agent in each mode with fixed
+// seeds, evaluates it every few thousand episodes and reports how long
+// (episodes and training seconds) it takes to reach given levels of
+// agreement with minimax
+//
+//   convergence [--episodes N] [--every N] [--seeds 1,2,3]
+//               [--targets 0.5,0.8,0.9,0.95] [--only mode] [--csv file]
+//
+// agreement is analyze_policy's: the share of states in the table whose
+// greedy move is one of minimax's best moves. the outcome rates are the
+// exact win/draw/loss chances of the greedy policy against perfect
+// minimax and a random player, not sampled games. the score of a mode is
+// the mean agreement over all evaluation points, i.e. the area under its
+// curve: higher is better, and faster convergence raises it
+
+struct EvalPoint {
+    long long episodes;
+    double seconds;            // training time only, evaluation excluded
+    double agreement;
+    int states;
+    OutcomeRates vsMinimax;
+    OutcomeRates vsRandom;
+};
+
+struct HarnessConfig {
+    long long episodes = 50000;
+    long long every = 2500;
+    std::vector<uint64_t> seeds = { 1, 2, 3 };
+    std::vector<double> targets = { 0.5, 0.8, 0.9, 0.95 };
+    std::string only;
+    std::string csvFile;
+};
+
+static const char* kModes[] = { "minimax", "random", "buggy", "buggy2", "selfplay" };
+
+static EvalPoint evaluate(const QLearningAgent& agent, long long episodes, double seconds) {
+    std::vector<PolicyEntry> entries;
+    agent.copyTable(entries);
+    PolicyAgreement agreement = analyzePolicyEntries(entries);
+
+    EvalPoint point;
+    point.episodes = episodes;
+    point.seconds = seconds;
+    point.agreement = agreement.agreement();
+    point.states = agreement.totalStates;
+    point.vsMinimax = exactOutcomes(entries, minimaxTable(), 1);
+    point.vsRandom = exactOutcomes(entries, randomTable(), 1);
+    return point;
+}
+
+// one training run of a mode from a seed, same hyperparameters and
+// episode code as tic_tac_toe.exe and train_selfplay.exe
+static std::vector<EvalPoint> runMode(const std::string& mode, uint64_t seed,
+                                      const HarnessConfig& cfg) {
+    // fixed stream numbers, so a mode's run doesn't depend on what ran before it
+    setRootSeed(seed);
+    QLearningAgent agent(0.1, 1.0, 0.2);
+    QLearningAgent agent2(0.1, 1.0, 0.2);
+    agent.setRng(makeStream(0));
+    agent2.setRng(makeStream(1));
+    Rng opponentRng = makeStream(2);
+    Minimax mm;
+    mm.setRng(makeStream(3));
+
+    OpponentMoveFn opponent;
+    if (mode == "minimax") {
+        opponent = [&](TicTacToe& g, int p) { return mm.getBestMove(g, p, opponentRng); };
+    } else if (mode == "random") {
+        opponent = [&](TicTacToe& g, int p) { return getRandomMove(g, p, opponentRng); };
+    } else if (mode == "buggy") {
+        opponent = [&](TicTacToe& g, int p) { return getBuggyMinimaxMove(g, p, opponentRng); };
+    } else if (mode == "buggy2") {
+        opponent = [&](TicTacToe& g, int p) { return getBuggyMinimaxMove2(g, p, opponentRng); };
+    }
+
+    using namespace std::chrono;
+    std::vector<EvalPoint> curve;
+    double trainingSeconds = 0.0;
+    long long done = 0;
+    while (done < cfg.episodes) {
+        long long chunk = std::min(cfg.every, cfg.episodes - done);
+        auto start = steady_clock::now();
+        for (long long i = 0; i < chunk; ++i) {
+            if (mode == "selfplay") {
+                playSelfPlayEpisode(agent, agent2);
+            } else {
+                playTrainingEpisode(agent, opponent);
+            }
+        }
+        trainingSeconds += duration_cast<duration<double>>(steady_clock::now() - start).count();
+        done += chunk;
+        curve.push_back(evaluate(agent, done, trainingSeconds));
+    }
+    return curve;
+}
+
+static std::vector<double> parseList(const std::string& text) {
+    std::vector<double> values;
+    std::stringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        values.push_back(std::atof(item.c_str()));
+    }
+    return values;
+}
+
+static void writeCsv(std::ofstream& out, const std::string& mode, uint64_t seed,
+                     const std::vector<EvalPoint>& curve) {
+    for (const EvalPoint& p : curve) {
+        out << mode << ',' << seed << ',' << p.episodes << ',' << p.seconds << ','
+            << p.states << ',' << p.agreement << ','
+            << p.vsMinimax.win << ',' << p.vsMinimax.draw << ',' << p.vsMinimax.loss << ','
+            << p.vsRandom.win << ',' << p.vsRandom.draw << ',' << p.vsRandom.loss << "\n";
+    }
+}
+
+static void printCurve(const std::vector<EvalPoint>& curve) {
+    std::printf("  %10s %9s %7s %9s %9s %9s %9s\n",
+                "episodes", "train s", "states", "agree", "mm draw", "mm loss", "rnd win");
+    for (const EvalPoint& p : curve) {
+        std::printf("  %10lld %9.3f %7d %9.4f %9.4f %9.4f %9.4f\n",
+                    p.episodes, p.seconds, p.states, p.agreement,
+                    p.vsMinimax.draw, p.vsMinimax.loss, p.vsRandom.win);
+    }
+}
+
+int main(int argc, char** argv) {
+    HarnessConfig cfg;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--episodes")     cfg.episodes = std::max(1LL, std::atoll(argv[i + 1]));
+        else if (arg == "--every")   cfg.every = std::max(1LL, std::atoll(argv[i + 1]));
+        else if (arg == "--targets") cfg.targets = parseList(argv[i + 1]);
+        else if (arg == "--only")    cfg.only = argv[i + 1];
+        else if (arg == "--csv")     cfg.csvFile = argv[i + 1];
+        else if (arg == "--seeds") {
+            cfg.seeds.clear();
+            for (double s : parseList(argv[i + 1])) cfg.seeds.push_back(uint64_t(s));
+        }
+        else {
+            std::cerr << "unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+    if (cfg.seeds.empty()) {
+        std::cerr << "no seeds\n";
+        return 1;
+    }
+
+    std::ofstream csv;
+    if (!cfg.csvFile.empty()) {
+        csv.open(cfg.csvFile);
+        if (!csv) {
+            std::cerr << "could not open " << cfg.csvFile << " to write\n";
+            return 1;
+        }
+        csv << "mode,seed,episodes,train_s,states,agreement,"
+               "mm_win,mm_draw,mm_loss,rnd_win,rnd_draw,rnd_loss\n";
+    }
+
+    std::cout << "Convergence harness: " << cfg.episodes << " episodes per run, evaluated every "
+              << cfg.every << ", " << cfg.seeds.size() << " seed(s)\n";
+
+    struct Summary {
+        std::string mode;
+        double score;
+        std::vector<double> episodesTo, secondsTo;   // mean over seeds, -1 if not all reached it
+    };
+    std::vector<Summary> summaries;
+
+    for (const char* mode : kModes) {
+        if (!cfg.only.empty() && cfg.only != mode) {
+            continue;
+        }
+        Summary summary;
+        summary.mode = mode;
+        summary.score = 0.0;
+        summary.episodesTo.assign(cfg.targets.size(), 0.0);
+        summary.secondsTo.assign(cfg.targets.size(), 0.0);
+
+        for (uint64_t seed : cfg.seeds) {
+            std::cout << "\n" << mode << ", seed " << seed << "\n";
+            std::vector<EvalPoint> curve = runMode(mode, seed, cfg);
+            printCurve(curve);
+            if (csv.is_open()) {
+                writeCsv(csv, mode, seed, curve);
+            }
+
+            double area = 0.0;
+            for (const EvalPoint& p : curve) area += p.agreement;
+            summary.score += area / double(curve.size()) / double(cfg.seeds.size());
+
+            for (size_t t = 0; t < cfg.targets.size(); ++t) {
+                auto hit = std::find_if(curve.begin(), curve.end(), [&](const EvalPoint& p) {
+                    return p.agreement >= cfg.targets[t];
+                });
+                if (hit == curve.end() || summary.episodesTo[t] < 0) {
+                    summary.episodesTo[t] = summary.secondsTo[t] = -1.0;
+                } else {
+                    summary.episodesTo[t] += double(hit->episodes) / double(cfg.seeds.size());
+                    summary.secondsTo[t] += hit->seconds / double(cfg.seeds.size());
+                }
+            }
+        }
+        summaries.push_back(summary);
+    }
+
+    std::cout << "\nTime to agreement (mean over seeds; - if some seed never got there)\n";
+    std::printf("%-10s %8s", "mode", "score");
+    for (double t : cfg.targets) {
+        char label[32];
+        std::snprintf(label, sizeof(label), "%g%%", t * 100.0);
+        std::printf(" %12s %9s", label, "s");
+    }
+    std::printf("\n");
+    for (const Summary& s : summaries) {
+        std::printf("%-10s %8.4f", s.mode.c_str(), s.score);
+        for (size_t t = 0; t < cfg.targets.size(); ++t) {
+            if (s.episodesTo[t] < 0) {
+                std::printf(" %12s %9s", "-", "-");
+            } else {
+                std::printf(" %12.0f %9.3f", s.episodesTo[t], s.secondsTo[t]);
+            }
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
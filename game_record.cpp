@@ -0,0 +1,145 @@
+#include "game_record.h"
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const char kMagic[4] = { 'T', 'T', 'T', 'G' };
+static const uint16_t kVersion = 1;
+
+static void appendBytes(std::vector<uint8_t>& out, const void* p, size_t n) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(p);
+    out.insert(out.end(), bytes, bytes + n);
+}
+
+static void appendName(std::vector<uint8_t>& out, const std::string& name) {
+    uint8_t len = uint8_t(std::min<size_t>(name.size(), 255));
+    out.push_back(len);
+    appendBytes(out, name.data(), len);
+}
+
+bool GameRecordWriter::open(const std::string& filename, const GameRecordHeader& header) {
+    close();
+    file = std::fopen(filename.c_str(), "wb");
+    if (!file) {
+        std::cerr << "could not open " << filename << " to write\n";
+        return false;
+    }
+    buffer.reserve(kBufferSize);
+    games = 0;
+
+    uint16_t reserved = 0;
+    appendBytes(buffer, kMagic, sizeof(kMagic));
+    appendBytes(buffer, &kVersion, sizeof(kVersion));
+    appendBytes(buffer, &reserved, sizeof(reserved));
+    appendBytes(buffer, &header.seed, sizeof(header.seed));
+    appendName(buffer, header.player1);
+    appendName(buffer, header.player2);
+    return true;
+}
+
+void GameRecordWriter::flush() {
+    if (file && !buffer.empty()) {
+        std::fwrite(buffer.data(), 1, buffer.size(), file);
+        std::fflush(file);
+    }
+    buffer.clear();
+}
+
+void GameRecordWriter::close() {
+    if (file) {
+        flush();
+        std::fclose(file);
+        file = nullptr;
+    }
+}
+
+bool GameRecordFile::open(const std::string& filename) {
+    close();
+#ifdef _WIN32
+    HANDLE f = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (f == INVALID_HANDLE_VALUE) {
+        std::cerr << "could not open " << filename << " for reading\n";
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(f, &fileSize);
+    size = size_t(fileSize.QuadPart);
+    HANDLE m = size ? CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    void* view = m ? MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    fileHandle = f;
+    mapping = m;
+    data = static_cast<const uint8_t*>(view);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "could not open " << filename << " for reading\n";
+        return false;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    size = size_t(st.st_size);
+    void* view = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (view != MAP_FAILED) {
+        // one pass from start to end
+        madvise(view, size, MADV_SEQUENTIAL);
+        data = static_cast<const uint8_t*>(view);
+    }
+#endif
+    if (!data) {
+        std::cerr << filename << " is empty or could not be mapped\n";
+        close();
+        return false;
+    }
+
+    // fixed part, then the two names
+    size_t pos = sizeof(kMagic) + 2 * sizeof(uint16_t) + sizeof(uint64_t);
+    uint16_t version = 0;
+    if (size < pos + 2 || std::memcmp(data, kMagic, sizeof(kMagic)) != 0) {
+        std::cerr << filename << " is not a game record file\n";
+        close();
+        return false;
+    }
+    std::memcpy(&version, data + 4, sizeof(version));
+    if (version != kVersion) {
+        std::cerr << filename << " has unknown game record version " << version << "\n";
+        close();
+        return false;
+    }
+    std::memcpy(&head.seed, data + 8, sizeof(head.seed));
+    for (std::string* name : { &head.player1, &head.player2 }) {
+        if (pos >= size || pos + 1 + data[pos] > size) {
+            std::cerr << filename << " has a truncated header\n";
+            close();
+            return false;
+        }
+        name->assign(reinterpret_cast<const char*>(data + pos + 1), data[pos]);
+        pos += 1 + data[pos];
+    }
+    bodyStart = pos;
+    return true;
+}
+
+void GameRecordFile::close() {
+#ifdef _WIN32
+    if (data) UnmapViewOfFile(data);
+    if (mapping) CloseHandle(mapping);
+    if (fileHandle) CloseHandle(fileHandle);
+    mapping = fileHandle = nullptr;
+#else
+    if (data) munmap(const_cast<uint8_t*>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+    bodyStart = 0;
+}
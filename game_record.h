@@ -0,0 +1,134 @@
+#ifndef GAME_RECORD_H
+#define GAME_RECORD_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+
+// binary game log, appended to one game at a time
+//
+// header:  "TTTG", u16 version, u16 reserved, u64 seed,
+//          u8 length + player 1 name, u8 length + player 2 name
+// game:    1 byte  - bits 0-3 number of moves, bits 4-5 winner (0 draw)
+//          then the moves as action indices (y*3 + x), 4 bits each,
+//          first move in the low nibble, padded to a whole byte
+//
+// player 1 always moves first, so a game is at most 6 bytes and the
+// whole board sequence can be rebuilt from the moves alone
+
+struct GameRecordHeader {
+    uint64_t seed = 0;
+    std::string player1;
+    std::string player2;
+};
+
+// one game as stored, moves[0..count) are action indices
+struct GameRecord {
+    int count = 0;
+    int winner = 0;
+    uint8_t moves[10];         // one spare for the padding nibble
+};
+
+// buffered writer: games collect in memory and go to disk in large
+// blocks, so recording keeps up with the game loop. one thread per writer
+class GameRecordWriter {
+public:
+    GameRecordWriter() = default;
+    ~GameRecordWriter() { close(); }
+
+    GameRecordWriter(const GameRecordWriter&) = delete;
+    GameRecordWriter& operator=(const GameRecordWriter&) = delete;
+
+    // creates (or truncates) filename and writes the header
+    bool open(const std::string& filename, const GameRecordHeader& header);
+    bool isOpen() const { return file != nullptr; }
+
+    void write(const GameRecord& game) {
+        if (buffer.size() + 6 > kBufferSize) {
+            flush();
+        }
+        buffer.push_back(uint8_t(game.count | (game.winner << 4)));
+        for (int i = 0; i < game.count; i += 2) {
+            uint8_t hi = (i + 1 < game.count) ? game.moves[i + 1] : 0;
+            buffer.push_back(uint8_t(game.moves[i] | (hi << 4)));
+        }
+        games++;
+    }
+
+    void flush();
+    void close();
+
+    long long gamesWritten() const { return games; }
+
+private:
+    static const size_t kBufferSize = 1 << 20;
+    std::FILE* file = nullptr;
+    std::vector<uint8_t> buffer;
+    long long games = 0;
+};
+
+// read-only view of a game log mapped into memory; games are decoded
+// straight from the mapped bytes, nothing is copied up front
+class GameRecordFile {
+public:
+    GameRecordFile() = default;
+    ~GameRecordFile() { close(); }
+
+    GameRecordFile(const GameRecordFile&) = delete;
+    GameRecordFile& operator=(const GameRecordFile&) = delete;
+
+    bool open(const std::string& filename);
+    void close();
+
+    const GameRecordHeader& header() const { return head; }
+    size_t sizeBytes() const { return size; }
+
+    // calls fn(const GameRecord&) for every game in file order; returns
+    // the number of games, or -1 at the first truncated or corrupt game
+    template <typename Fn>
+    long long forEach(Fn fn) const {
+        const uint8_t* p = data + bodyStart;
+        const uint8_t* end = data + size;
+        GameRecord game;
+        long long n = 0;
+        while (p < end) {
+            game.count = *p & 0x0F;
+            game.winner = (*p >> 4) & 0x03;
+            ++p;
+            int bytes = (game.count + 1) / 2;
+            if (game.count > 9 || game.winner > 2 || end - p < bytes) {
+                return -1;
+            }
+            uint8_t highest = 0;
+            for (int i = 0; i < bytes; ++i) {
+                game.moves[2 * i] = p[i] & 0x0F;
+                game.moves[2 * i + 1] = p[i] >> 4;
+                highest = std::max(highest, game.moves[2 * i]);
+            }
+            for (int i = 1; i < game.count; i += 2) {
+                highest = std::max(highest, game.moves[i]);
+            }
+            if (highest > 8) {
+                return -1;
+            }
+            p += bytes;
+            fn(static_cast<const GameRecord&>(game));
+            ++n;
+        }
+        return n;
+    }
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    size_t bodyStart = 0;
+    GameRecordHeader head;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mapping = nullptr;
+#endif
+};
+
+#endif
@@ -0,0 +1,138 @@
+#include "grid_game.h"
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <algorithm>
+#include <cstdlib>
+
+// Zobrist keys per (cell, player), from a fixed splitmix64 sequence so
+// hashes are the same in every run
+static const uint64_t* zobristKeys() {
+    static uint64_t keys[GridGame::kMaxSize * GridGame::kMaxSize * 2];
+    static std::once_flag once;
+    std::call_once(once, [] {
+        uint64_t x = 0x7474746772696400ULL;
+        for (uint64_t& k : keys) {
+            x += 0x9E3779B97F4A7C15ULL;
+            uint64_t z = x;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            k = z ^ (z >> 31);
+        }
+    });
+    return keys;
+}
+
+static GridGeometry buildGeometry(int size, int inRow) {
+    GridGeometry g;
+    g.size = size;
+    g.inRow = inRow;
+    g.cells = size * size;
+    g.through.resize(g.cells);
+
+    // right, up, up-right, up-left
+    const int dirs[4][2] = { { 1, 0 }, { 0, 1 }, { 1, 1 }, { -1, 1 } };
+    for (const auto& d : dirs) {
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                int ex = x + d[0] * (inRow - 1);
+                int ey = y + d[1] * (inRow - 1);
+                if (ex < 0 || ex >= size || ey >= size) continue;
+                uint64_t mask = 0;
+                for (int i = 0; i < inRow; ++i) {
+                    mask |= uint64_t(1) << ((y + d[1] * i) * size + x + d[0] * i);
+                }
+                g.lines.push_back(mask);
+                for (int c = 0; c < g.cells; ++c) {
+                    if ((mask >> c) & 1) g.through[c].push_back(mask);
+                }
+            }
+        }
+    }
+
+    for (int c = 0; c < g.cells; ++c) g.centreOrder.push_back(c);
+    // distance from the centre, doubled to stay in integers
+    auto dist = [size](int c) {
+        int dx = std::abs(2 * (c % size) - (size - 1));
+        int dy = std::abs(2 * (c / size) - (size - 1));
+        return dx * dx + dy * dy;
+    };
+    std::stable_sort(g.centreOrder.begin(), g.centreOrder.end(),
+                     [&](int a, int b) { return dist(a) < dist(b); });
+    return g;
+}
+
+const GridGeometry& gridGeometry(int size, int inRow) {
+    static std::mutex mutex;
+    static std::map<std::pair<int, int>, std::unique_ptr<GridGeometry>> cache;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& slot = cache[{ size, inRow }];
+    if (!slot) {
+        slot.reset(new GridGeometry(buildGeometry(size, inRow)));
+    }
+    return *slot;
+}
+
+GridGame::GridGame(int size, int inRow) {
+    size = std::max(1, std::min(size, kMaxSize));
+    inRow = std::max(1, std::min(inRow, size));
+    geo = &gridGeometry(size, inRow);
+    fullMask = geo->cells == 64 ? ~uint64_t(0) : (uint64_t(1) << geo->cells) - 1;
+}
+
+GridGame GridGame::fromTicTacToe(const TicTacToe& game) {
+    GridGame g(3, 3);
+    const Board& b = game.getBoard();
+    for (int y = 0; y < 3; ++y) {
+        for (int x = 0; x < 3; ++x) {
+            if (b[y][x]) g.makeMove(y * 3 + x, b[y][x]);
+        }
+    }
+    return g;
+}
+
+void GridGame::makeMove(int cell, int player) {
+    uint64_t bit = uint64_t(1) << cell;
+    pieces[player - 1] |= bit;
+    key ^= zobristKeys()[cell * 2 + player - 1];
+    filled++;
+    if (win == 0) {
+        for (uint64_t line : geo->through[cell]) {
+            if ((pieces[player - 1] & line) == line) {
+                win = player;
+                winCell = cell;
+                break;
+            }
+        }
+    }
+}
+
+void GridGame::undoMove(int cell) {
+    int player = at(cell);
+    if (player == 0) return;
+    pieces[player - 1] &= ~(uint64_t(1) << cell);
+    key ^= zobristKeys()[cell * 2 + player - 1];
+    filled--;
+    if (cell == winCell) {
+        win = 0;
+        winCell = -1;
+    }
+}
+
+void GridGame::print() const {
+    int n = size();
+    std::cout << "\n";
+    for (int y = n - 1; y >= 0; --y) {
+        for (int x = 0; x < n; ++x) {
+            int v = at(y * n + x);
+            std::cout << " " << (v == 1 ? '1' : v == 2 ? '2' : '.');
+            if (x < n - 1) std::cout << " |";
+        }
+        std::cout << "\n";
+        if (y > 0) {
+            std::cout << std::string(size_t(4 * n - 1), '-') << "\n";
+        }
+    }
+    std::cout << "\n";
+}
@@ -0,0 +1,73 @@
+#ifndef GRID_GAME_H
+#define GRID_GAME_H
+
+#include <cstdint>
+#include <vector>
+#include "tic_tac_toe.h"
+
+// lines and move order for one board shape, built once and shared
+struct GridGeometry {
+    int size;
+    int inRow;
+    int cells;
+    std::vector<uint64_t> lines;                 // every run of inRow cells, as cell masks
+    std::vector<std::vector<uint64_t>> through;  // lines through each cell
+    std::vector<int> centreOrder;                // cells, nearest the centre first
+};
+
+// N x N board, k in a row wins, up to 8 x 8
+//
+// cell (x, y) is bit y*size + x, as on the 3x3 board. each player's
+// pieces are one 64-bit mask, so a win check is a few AND/compares over
+// the lines through the last move, and the Zobrist hash is updated as
+// moves are made and undone. player 1 moves first
+class GridGame {
+public:
+    static constexpr int kMaxSize = 8;
+
+    explicit GridGame(int size = 3, int inRow = 3);
+
+    // same position as a 3x3 game
+    static GridGame fromTicTacToe(const TicTacToe& game);
+
+    int size() const { return geo->size; }
+    int inRow() const { return geo->inRow; }
+    int cells() const { return geo->cells; }
+    const GridGeometry& geometry() const { return *geo; }
+
+    // 0 empty, 1 or 2
+    int at(int cell) const {
+        return ((pieces[0] >> cell) & 1) ? 1 : ((pieces[1] >> cell) & 1) ? 2 : 0;
+    }
+    uint64_t piecesOf(int player) const { return pieces[player - 1]; }
+    uint64_t emptyCells() const { return fullMask & ~(pieces[0] | pieces[1]); }
+    int filledCount() const { return filled; }
+
+    // player to move: 1 if both have the same number of pieces
+    int toMove() const { return (filled & 1) ? 2 : 1; }
+
+    // cell must be empty
+    void makeMove(int cell, int player);
+    void undoMove(int cell);
+
+    int winner() const { return win; }
+    bool isFull() const { return filled == geo->cells; }
+    bool isGameOver() const { return win != 0 || isFull(); }
+
+    uint64_t hash() const { return key; }
+
+    void print() const;
+
+private:
+    const GridGeometry* geo;
+    uint64_t pieces[2] = { 0, 0 };
+    uint64_t fullMask;
+    uint64_t key = 0;
+    int filled = 0;
+    int win = 0;
+    int winCell = -1;      // the move that completed the line
+};
+
+const GridGeometry& gridGeometry(int size, int inRow);
+
+#endif
@@ -0,0 +1,176 @@
+#include <iostream>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "grid_game.h"
+#include "iterative_minimax.h"
+#include "tablebase.h"
+#include "rng.h"
+#include "profiler.h"
+
+// games on larger boards between the time-limited minimax and a random
+// player, to check search depth and move latency as the board grows
+//
+//   grid_match [--size N] [--k K] [--games N] [--p1 minimax|random|perfect]
+//              [--p2 minimax|random|perfect] [--id-ms N] [--id-depth N]
+//              [--id-threads N] [--id-tablebase file] [--id-book file] [--tablebase file]
+//              [--show] [--seed N]
+//
+// defaults: 4x4, 4 in a row, 10 games, minimax vs random, 100 ms a move
+//
+// --tablebase (from tablebase_solve) is the oracle: "perfect" plays from
+// it, and every move of every seat is checked against it
+
+struct Seat {
+    std::string type;
+    std::unique_ptr<IterativeMinimax> search;
+    long long moves = 0;
+    long long depthSum = 0;
+    int minDepth = 1 << 30;
+    double maxSeconds = 0.0;
+    long long blunders = 0;    // moves that gave away the solved result
+    long long bookMoves = 0;   // played from --id-book, not counted as searches
+};
+
+static int randomCell(uint64_t cells, Rng& rng) {
+    int pick = rng.uniformInt(__builtin_popcountll(cells));
+    for (int c = 0; c < 64; ++c) {
+        if (((cells >> c) & 1) && pick-- == 0) return c;
+    }
+    return -1;
+}
+
+static int chooseCell(Seat& seat, GridGame& game, const Tablebase& tb, Rng& rng) {
+    if (seat.type == "perfect") {
+        return randomCell(tb.bestCells(game), rng);
+    }
+    if (seat.search) {
+        int cell = seat.search->getBestCell(game);
+        const SearchStats& s = seat.search->lastStats();
+        if (s.book) {
+            seat.bookMoves++;
+            return cell;
+        }
+        seat.moves++;
+        seat.depthSum += s.depth;
+        seat.minDepth = std::min(seat.minDepth, s.depth);
+        seat.maxSeconds = std::max(seat.maxSeconds, s.seconds);
+        return cell;
+    }
+    return randomCell(game.emptyCells(), rng);
+}
+
+int main(int argc, char** argv) {
+    uint64_t seed = seedFromArgs(argc, argv);
+    int size = 4;
+    int inRow = 4;
+    int games = 10;
+    bool show = false;
+    std::string tablebaseFile;
+    Seat seats[2];
+    seats[0].type = "minimax";
+    seats[1].type = "random";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : "";
+        if (arg == "--show")       { show = true; continue; }
+        if (arg == "--size")       size = std::atoi(value);
+        else if (arg == "--k")     inRow = std::atoi(value);
+        else if (arg == "--games") games = std::atoi(value);
+        else if (arg == "--p1")    seats[0].type = value;
+        else if (arg == "--p2")    seats[1].type = value;
+        else if (arg == "--tablebase") tablebaseFile = value;
+        else if (arg != "--id-ms" && arg != "--id-depth" && arg != "--id-tt-bits" && arg != "--id-threads"
+                 && arg != "--id-tablebase" && arg != "--id-book" && arg != "--seed") {
+            std::cerr << "unknown option " << arg << "\n";
+            return 1;
+        }
+        ++i;
+    }
+    if (size < 1 || size > GridGame::kMaxSize || inRow < 1 || inRow > size || games < 1) {
+        std::cerr << "need 1 <= k <= size <= " << GridGame::kMaxSize << " and games >= 1\n";
+        return 1;
+    }
+    Tablebase tb;
+    if (!tablebaseFile.empty()) {
+        std::string error;
+        if (!tb.open(tablebaseFile, error)) {
+            std::cerr << error << "\n";
+            return 1;
+        }
+        if (tb.size() != size || tb.inRow() != inRow) {
+            std::cerr << tablebaseFile << " solves " << tb.size() << "x" << tb.size()
+                      << ", " << tb.inRow() << " in a row\n";
+            return 1;
+        }
+    }
+    IterativeMinimaxConfig cfg = iterativeMinimaxConfigFromArgs(argc, argv);
+    for (Seat& seat : seats) {
+        if (seat.type == "minimax") {
+            seat.search.reset(new IterativeMinimax(cfg));
+        } else if (seat.type == "perfect" && !tb.isOpen()) {
+            std::cerr << "perfect needs --tablebase\n";
+            return 1;
+        } else if (seat.type != "random" && seat.type != "perfect") {
+            std::cerr << "unknown player " << seat.type << " (minimax, random or perfect)\n";
+            return 1;
+        }
+    }
+
+    std::cout << "Seed: " << seed << "\n"
+              << size << "x" << size << ", " << inRow << " in a row, " << games << " games: "
+              << seats[0].type << " vs " << seats[1].type << ", "
+              << cfg.seconds * 1000 << " ms a move"
+              << (cfg.maxDepth > 0 ? ", depth limit " + std::to_string(cfg.maxDepth) : "") << "\n";
+
+    Rng rng = makeStream(nextStreamId());
+    long long results[3] = { 0, 0, 0 };
+    for (int g = 0; g < games; ++g) {
+        GridGame game(size, inRow);
+        while (!game.isGameOver()) {
+            int player = game.toMove();
+            int cell = chooseCell(seats[player - 1], game, tb, rng);
+            if (cell < 0) break;
+            if (tb.isOpen() && !((tb.bestCells(game) >> cell) & 1)) {
+                seats[player - 1].blunders++;
+            }
+            game.makeMove(cell, player);
+        }
+        results[game.winner()]++;
+        if (show) {
+            std::cout << "Game " << g + 1 << ": "
+                      << (game.winner() ? "player " + std::to_string(game.winner()) + " wins" : "draw");
+            game.print();
+        }
+    }
+
+    std::cout << "\nPlayer1 wins: " << results[1] << "\n"
+              << "Draws:        " << results[0] << "\n"
+              << "Player2 wins: " << results[2] << "\n";
+    if (tb.isOpen()) {
+        int v = tb.value(GridGame(size, inRow));
+        std::cout << "Solved result: " << (v == kTbDraw ? "draw" : "player " + std::to_string(v) + " wins")
+                  << "; moves that gave it away: player1 " << seats[0].blunders
+                  << ", player2 " << seats[1].blunders << "\n";
+    }
+    for (int p = 0; p < 2; ++p) {
+        const Seat& seat = seats[p];
+        if (!seat.search) continue;
+        if (seat.moves > 0) {
+            const SearchStats& t = seat.search->totalStats();
+            std::printf("\nPlayer%d search: %lld moves, depth reached mean %.1f (min %d), "
+                        "%.0f nodes/s, %.1f%% table hits, slowest move %.1f ms\n",
+                        p + 1, seat.moves, double(seat.depthSum) / double(seat.moves), seat.minDepth,
+                        t.nodesPerSecond(), t.nodes ? 100.0 * double(t.ttHits) / double(t.nodes) : 0.0,
+                        seat.maxSeconds * 1000.0);
+        }
+        if (seat.bookMoves > 0) {
+            std::printf("Player%d book: %lld moves\n", p + 1, seat.bookMoves);
+        }
+    }
+    profileDump("grid_match");
+    return 0;
+}
@@ -0,0 +1,355 @@
+#include "iterative_minimax.h"
+#include <algorithm>
+#include <string>
+#include <cstdlib>
+#include <iostream>
+#include "profiler.h"
+
+// TTData::bound
+static const int kExact = 0;
+static const int kLower = 1;   // score is at least this
+static const int kUpper = 2;   // score is at most this
+
+// win/loss scores beyond this are "forced result in n plies"
+static const int kForced = kSearchWin - 1000;
+
+// forced results are stored relative to the node rather than the root,
+// so an entry means the same thing wherever the position is reached
+static int toTable(int score, int ply) {
+    if (score > kForced) return score + ply;
+    if (score < -kForced) return score - ply;
+    return score;
+}
+
+static int fromTable(int score, int ply) {
+    if (score > kForced) return score - ply;
+    if (score < -kForced) return score + ply;
+    return score;
+}
+
+int openLineEvaluation(const GridGame& game, int player) {
+    static const int kWeight[9] = { 0, 1, 4, 16, 64, 256, 1024, 4096, 16384 };
+    uint64_t mine = game.piecesOf(player);
+    uint64_t theirs = game.piecesOf(3 - player);
+    int score = 0;
+    for (uint64_t line : game.geometry().lines) {
+        int a = __builtin_popcountll(mine & line);
+        int b = __builtin_popcountll(theirs & line);
+        if (b == 0) score += kWeight[a];
+        else if (a == 0) score -= kWeight[b];
+    }
+    return std::max(-kSearchWin / 2 + 1, std::min(kSearchWin / 2 - 1, score));
+}
+
+IterativeMinimaxConfig iterativeMinimaxConfigFromArgs(int argc, char** argv) {
+    IterativeMinimaxConfig cfg;
+    for (int i = 1; i + 1 < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--id-ms")            cfg.seconds = std::atof(argv[i + 1]) / 1000.0;
+        else if (arg == "--id-depth")    cfg.maxDepth = std::atoi(argv[i + 1]);
+        else if (arg == "--id-tt-bits")  cfg.ttBits = std::max(4, std::min(30, std::atoi(argv[i + 1])));
+        else if (arg == "--id-threads")  cfg.threads = std::max(1, std::atoi(argv[i + 1]));
+        else if (arg == "--id-tablebase") {
+            std::shared_ptr<Tablebase> tb = std::make_shared<Tablebase>();
+            std::string error;
+            if (tb->open(argv[i + 1], error)) {
+                cfg.tablebase = tb;
+            } else {
+                std::cerr << error << ", searching without it\n";
+            }
+        }
+        else if (arg == "--id-book") {
+            std::shared_ptr<OpeningBook> book = std::make_shared<OpeningBook>();
+            std::string error;
+            if (book->load(argv[i + 1], error)) {
+                cfg.book = book;
+            } else {
+                std::cerr << error << ", searching without it\n";
+            }
+        }
+    }
+    return cfg;
+}
+
+IterativeMinimax::IterativeMinimax(const IterativeMinimaxConfig& config)
+    : cfg(config), table(new TTSlot[size_t(1) << config.ttBits]),
+      tableMask((uint64_t(1) << config.ttBits) - 1), rng(makeStream(nextStreamId()))
+{
+    if (cfg.threads > 1) {
+        pool.reset(new ThreadPool(cfg.threads));
+    }
+}
+
+void IterativeMinimax::clearTable() {
+    for (uint64_t i = 0; i <= tableMask; ++i) {
+        table[i].check.store(0, std::memory_order_relaxed);
+        table[i].data.store(0, std::memory_order_relaxed);
+    }
+}
+
+// score in the low 32 bits, then depth, bound and move + 1 a byte each;
+// stored entries have depth >= 1, so data is never 0
+static uint64_t packEntry(int score, int depth, int bound, int move) {
+    return uint64_t(uint32_t(score)) | uint64_t(uint8_t(depth)) << 32
+         | uint64_t(uint8_t(bound)) << 40 | uint64_t(uint8_t(move + 1)) << 48;
+}
+
+bool IterativeMinimax::probe(uint64_t key, TTData& out) const {
+    const TTSlot& slot = table[key & tableMask];
+    uint64_t d = slot.data.load(std::memory_order_relaxed);
+    uint64_t k = slot.check.load(std::memory_order_relaxed) ^ d;
+    if (d == 0 || k != key) {
+        return false;
+    }
+    out.score = int32_t(uint32_t(d));
+    out.depth = int((d >> 32) & 0xff);
+    out.bound = int((d >> 40) & 0xff);
+    out.move = int((d >> 48) & 0xff) - 1;
+    return true;
+}
+
+// keeps a deeper entry for the same position, else always replaces
+void IterativeMinimax::store(uint64_t key, int score, int depth, int bound, int move) {
+    TTData old;
+    if (probe(key, old) && depth < old.depth) {
+        return;
+    }
+    TTSlot& slot = table[key & tableMask];
+    uint64_t d = packEntry(score, depth, bound, move);
+    slot.data.store(d, std::memory_order_relaxed);
+    slot.check.store(key ^ d, std::memory_order_relaxed);
+}
+
+bool IterativeMinimax::outOfTime(const Worker& w) {
+    if (stopAll.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    // helpers run until the main thread is done; its first iteration
+    // always finishes, so there is a move to play
+    return w.id == 0 && cfg.seconds > 0 && last.depth > 0 && std::chrono::steady_clock::now() >= deadline;
+}
+
+// empty cells, the table's move first, then nearest the centre first
+int IterativeMinimax::orderedMoves(const GridGame& game, int ttMove, int* moves) const {
+    uint64_t empty = game.emptyCells();
+    int n = 0;
+    if (ttMove >= 0 && ((empty >> ttMove) & 1)) {
+        moves[n++] = ttMove;
+    }
+    for (int c : game.geometry().centreOrder) {
+        if (((empty >> c) & 1) && c != ttMove) {
+            moves[n++] = c;
+        }
+    }
+    return n;
+}
+
+int IterativeMinimax::search(Worker& w, int depth, int alpha, int beta, int ply) {
+    w.nodes++;
+    if ((w.nodes & 1023) == 0 && outOfTime(w)) {
+        w.aborted = true;
+    }
+    if (w.aborted) {
+        return 0;
+    }
+    GridGame& game = w.game;
+    if (game.winner() != 0) {
+        // the player who just moved has won
+        return -(kSearchWin - ply);
+    }
+    if (game.isFull()) {
+        return 0;
+    }
+    int player = game.toMove();
+    if (depth == 0) {
+        return cfg.evaluate(game, player);
+    }
+
+    uint64_t key = game.hash();
+    TTData entry;
+    int ttMove = -1;
+    if (probe(key, entry)) {
+        ttMove = entry.move;
+        if (entry.depth >= depth) {
+            w.ttHits++;
+            int s = fromTable(entry.score, ply);
+            if (entry.bound == kExact) return s;
+            if (entry.bound == kLower) alpha = std::max(alpha, s);
+            if (entry.bound == kUpper) beta = std::min(beta, s);
+            if (alpha >= beta) return s;
+        }
+    }
+
+    int alphaStart = alpha;
+    int moves[64];
+    int n = orderedMoves(game, ttMove, moves);
+    int best = -kSearchWin - 1;
+    int bestMove = moves[0];
+    for (int i = 0; i < n; ++i) {
+        game.makeMove(moves[i], player);
+        int s = -search(w, depth - 1, -beta, -alpha, ply + 1);
+        game.undoMove(moves[i]);
+        if (w.aborted) {
+            return 0;
+        }
+        if (s > best) {
+            best = s;
+            bestMove = moves[i];
+        }
+        alpha = std::max(alpha, s);
+        if (alpha >= beta) {
+            break;
+        }
+    }
+
+    store(key, toTable(best, ply), depth,
+          best <= alphaStart ? kUpper : best >= beta ? kLower : kExact, bestMove);
+    return best;
+}
+
+// one iteration at the root; false if it was cut off. the window sits
+// one below the best score so far, so a move that ties it is scored
+// exactly and joins best
+bool IterativeMinimax::searchRoot(Worker& w, int depth, int hint, int& score, std::vector<int>& best) {
+    GridGame& game = w.game;
+    int player = game.toMove();
+    TTData entry;
+    if (hint < 0 && probe(game.hash(), entry)) {
+        hint = entry.move;
+    }
+    int moves[64];
+    int n = orderedMoves(game, hint, moves);
+    if (w.id > 0 && n > 2) {
+        // helpers start on different moves so they fill different parts of the table
+        std::rotate(moves + 1, moves + 1 + w.id % (n - 1), moves + n);
+    }
+
+    int bestScore = -kSearchWin - 1;
+    best.clear();
+    for (int i = 0; i < n; ++i) {
+        game.makeMove(moves[i], player);
+        int s = -search(w, depth - 1, -(kSearchWin + 1), -(bestScore - 1), 1);
+        game.undoMove(moves[i]);
+        if (w.aborted) {
+            return false;
+        }
+        if (s > bestScore) {
+            bestScore = s;
+            best.assign(1, moves[i]);
+        } else if (s == bestScore) {
+            best.push_back(moves[i]);
+        }
+    }
+    score = bestScore;
+    return true;
+}
+
+// iterative deepening on one thread; only the main one (id 0) records
+// its result, and stops the helpers when it is done
+void IterativeMinimax::iterate(Worker& w, int maxDepth, int empties) {
+    std::vector<int> best;
+    int hint = -1;
+    int score = 0;
+    for (int depth = 1 + (w.id & 1); depth <= maxDepth; ++depth) {
+        if (!searchRoot(w, depth, hint, score, best)) {
+            break;
+        }
+        hint = best[0];
+        store(w.game.hash(), toTable(score, 0), depth, kExact, hint);
+        bool forced = score > kForced || score < -kForced;
+        if (w.id == 0) {
+            bestCells = best;
+            last.depth = depth;
+            last.score = score;
+            // a forced result does not change with more depth
+            last.solved = forced || depth == empties;
+        }
+        if (forced) {
+            break;
+        }
+    }
+    if (w.id == 0) {
+        stopAll.store(true, std::memory_order_relaxed);
+    }
+}
+
+// the solved result as a search score, and the cells that keep it
+void IterativeMinimax::lookUp(const GridGame& game) {
+    int v = cfg.tablebase->value(game);
+    int player = game.toMove();
+    uint64_t best = cfg.tablebase->bestCells(game);
+    for (int c = 0; c < game.cells(); ++c) {
+        if ((best >> c) & 1) bestCells.push_back(c);
+    }
+    int empties = game.cells() - game.filledCount();
+    last.depth = empties;
+    last.solved = true;
+    last.score = v == kTbDraw ? 0 : v == player ? kSearchWin - empties : -(kSearchWin - empties);
+}
+
+int IterativeMinimax::getBestCell(GridGame& game) {
+    PROFILE_SCOPE("IterativeMinimax::getBestCell");
+    if (game.isGameOver()) {
+        return -1;
+    }
+    using namespace std::chrono;
+    auto start = steady_clock::now();
+    deadline = start + duration_cast<steady_clock::duration>(duration<double>(cfg.seconds));
+    last = SearchStats();
+    bestCells.clear();
+    stopAll.store(false);
+
+    int empties = game.cells() - game.filledCount();
+    int maxDepth = cfg.maxDepth > 0 ? std::min(cfg.maxDepth, empties) : empties;
+    int bookCell = cfg.book ? cfg.book->pick(game, rng) : -1;
+    if (bookCell >= 0) {
+        bestCells.push_back(bookCell);
+        last.book = true;
+    } else if (cfg.tablebase && cfg.tablebase->covers(game)) {
+        lookUp(game);
+    } else {
+        std::vector<Worker> workers(pool ? pool->threads() : 1);
+        for (size_t i = 0; i < workers.size(); ++i) {
+            workers[i].game = game;
+            workers[i].id = int(i);
+        }
+        if (pool) {
+            pool->parallelFor(int(workers.size()), [&](int i) { iterate(workers[i], maxDepth, empties); });
+        } else {
+            iterate(workers[0], maxDepth, empties);
+        }
+        for (const Worker& w : workers) {
+            last.nodes += w.nodes;
+            last.ttHits += w.ttHits;
+        }
+    }
+
+    int bestCell = -1;
+    if (bestCells.size() > 1 && s_randomizeEquivalentMoves) {
+        bestCell = bestCells[rng.uniformInt(int(bestCells.size()))];
+    } else if (!bestCells.empty()) {
+        bestCell = bestCells[0];
+    } else {
+        int moves[64];
+        bestCell = orderedMoves(game, -1, moves) > 0 ? moves[0] : -1;
+    }
+
+    last.seconds = duration_cast<duration<double>>(steady_clock::now() - start).count();
+    total.nodes += last.nodes;
+    total.ttHits += last.ttHits;
+    total.seconds += last.seconds;
+    total.depth = last.depth;
+    total.solved = last.solved;
+    total.score = last.score;
+    PROFILE_COUNT("iterative_minimax/nodes", last.nodes);
+    return bestCell;
+}
+
+Move IterativeMinimax::getBestMove(TicTacToe& game, int /*player*/) {
+    GridGame g = GridGame::fromTicTacToe(game);
+    int cell = getBestCell(g);
+    if (cell < 0) {
+        return {-1, -1};
+    }
+    return {cell % 3, cell / 3};
+}
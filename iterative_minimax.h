@@ -0,0 +1,141 @@
+#ifndef ITERATIVE_MINIMAX_H
+#define ITERATIVE_MINIMAX_H
+
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include "grid_game.h"
+#include "minimax.h"
+#include "thread_pool.h"
+#include "tablebase.h"
+#include "opening_book.h"
+
+// scores are for the player to move: kSearchWin - plies for a forced win,
+// minus that for a forced loss, 0 for a draw, heuristic values in between
+constexpr int kSearchWin = 1000000;
+
+// heuristic value of a non-terminal position for player, |value| < kSearchWin / 2
+typedef int (*Evaluation)(const GridGame& game, int player);
+
+// open lines: every line the opponent has no piece on counts for
+// player, more the more pieces player already has on it, and the
+// other way round
+int openLineEvaluation(const GridGame& game, int player);
+
+struct IterativeMinimaxConfig {
+    double seconds = 0.1;          // per move, 0 = no limit
+    int maxDepth = 0;              // 0 = to the end of the game
+    int ttBits = 20;               // transposition table of 2^ttBits entries
+    int threads = 1;               // lazy SMP search threads
+    Evaluation evaluate = openLineEvaluation;
+    std::shared_ptr<const Tablebase> tablebase;   // replaces the search on the board it solves
+    std::shared_ptr<const OpeningBook> book;      // replaces it in the positions it holds
+};
+
+// reads --id-ms N, --id-depth N, --id-tt-bits N, --id-threads N,
+// --id-tablebase file and --id-book file from argv
+IterativeMinimaxConfig iterativeMinimaxConfigFromArgs(int argc, char** argv);
+
+struct SearchStats {
+    long long nodes = 0;
+    long long ttHits = 0;
+    int depth = 0;                 // deepest iteration that finished
+    bool solved = false;           // that iteration reached the end of the game
+    bool book = false;             // the move came from the opening book, no search
+    int score = 0;                 // its score for the player to move
+    double seconds = 0.0;
+
+    double nodesPerSecond() const { return seconds > 0 ? double(nodes) / seconds : 0.0; }
+};
+
+// alpha-beta negamax with iterative deepening and a transposition table,
+// for any GridGame
+//
+// depth 1, 2, 3, ... are searched in turn until the time budget runs
+// out, the depth limit is reached or the game is solved; the move of
+// the deepest iteration that finished is played. each iteration starts
+// from the best moves the table kept from the one before, and the table
+// is kept from move to move
+//
+// root moves are searched with a window one below the best score so far,
+// so every move that ties for best gets an exact score; the move played
+// is drawn from that equivalence set as Minimax does
+// (s_randomizeEquivalentMoves)
+//
+// with threads > 1 the search is lazy SMP: helper threads run the same
+// iterative deepening on their own copies of the board, half of them a
+// depth ahead and with the root moves rotated, and only share results
+// through the table. the table is lock-free: an entry is two 64-bit
+// words, key ^ data and data, so a torn write just reads as a miss
+//
+// with a tablebase for the board, moves are looked up instead: the
+// equivalence set is every cell that keeps the solved result. before
+// either, a position the opening book holds is played from the book
+class IterativeMinimax {
+public:
+    explicit IterativeMinimax(const IterativeMinimaxConfig& config = IterativeMinimaxConfig());
+
+    // best cell for the player to move, -1 if the game is over
+    int getBestCell(GridGame& game);
+
+    Move getBestMove(TicTacToe& game, int player);
+
+    const SearchStats& lastStats() const { return last; }
+
+    // summed over every search so far; depth and score are of the last one
+    const SearchStats& totalStats() const { return total; }
+
+    void clearTable();
+
+    // the equivalence set of the last search, best moves in search order
+    const std::vector<int>& lastBestCells() const { return bestCells; }
+
+    const IterativeMinimaxConfig& config() const { return cfg; }
+
+private:
+    struct TTSlot {
+        std::atomic<uint64_t> check{0};    // key ^ data
+        std::atomic<uint64_t> data{0};
+    };
+
+    struct TTData {
+        int score;
+        int depth;
+        int bound;
+        int move;
+    };
+
+    // one search thread's board and counters
+    struct Worker {
+        GridGame game;
+        int id = 0;
+        long long nodes = 0;
+        long long ttHits = 0;
+        bool aborted = false;
+    };
+
+    bool probe(uint64_t key, TTData& out) const;
+    void store(uint64_t key, int score, int depth, int bound, int move);
+
+    int search(Worker& w, int depth, int alpha, int beta, int ply);
+    bool searchRoot(Worker& w, int depth, int hint, int& score, std::vector<int>& best);
+    void iterate(Worker& w, int maxDepth, int empties);
+    int orderedMoves(const GridGame& game, int ttMove, int* moves) const;
+    bool outOfTime(const Worker& w);
+    void lookUp(const GridGame& game);
+
+    IterativeMinimaxConfig cfg;
+    std::unique_ptr<TTSlot[]> table;
+    uint64_t tableMask;
+    std::unique_ptr<ThreadPool> pool;
+    Rng rng;
+    SearchStats last;
+    SearchStats total;
+    std::vector<int> bestCells;
+    std::chrono::steady_clock::time_point deadline;
+    std::atomic<bool> stopAll{false};
+};
+
+#endif
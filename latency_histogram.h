@@ -0,0 +1,84 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+// log-linear histogram of nanosecond latencies: each power of two is
+// split into 32 equal buckets, so any percentile is within about 3% of
+// the true value and recording is a couple of shifts and an increment
+class LatencyHistogram {
+public:
+    LatencyHistogram() : counts(kBuckets, 0) {}
+
+    void record(uint64_t ns) {
+        counts[bucketOf(ns)]++;
+        total++;
+        maxNs = std::max(maxNs, ns);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (int i = 0; i < kBuckets; ++i) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        maxNs = std::max(maxNs, other.maxNs);
+    }
+
+    void clear() {
+        std::fill(counts.begin(), counts.end(), 0);
+        total = 0;
+        maxNs = 0;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return maxNs; }
+
+    // latency in ns that a fraction q (0..1) of the samples do not exceed,
+    // reported as the middle of its bucket
+    uint64_t percentile(double q) const {
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t rank = uint64_t(q * double(total - 1)) + 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return std::min(maxNs, (lowerBound(i) + lowerBound(i + 1)) / 2);
+            }
+        }
+        return maxNs;
+    }
+
+private:
+    static const int kSubBits = 5;
+    static const int kSub = 1 << kSubBits;
+    static const int kBuckets = (64 - kSubBits + 1) * kSub;
+
+    static int bucketOf(uint64_t v) {
+        if (v < uint64_t(kSub)) {
+            return int(v);
+        }
+        int e = 63 - __builtin_clzll(v);
+        return (e - kSubBits + 1) * kSub + int((v >> (e - kSubBits)) & (kSub - 1));
+    }
+
+    static uint64_t lowerBound(int index) {
+        if (index < kSub) {
+            return uint64_t(index);
+        }
+        int e = index / kSub + kSubBits - 1;
+        if (e >= 64) {
+            return UINT64_MAX;
+        }
+        return (uint64_t(1) << e) + (uint64_t(index % kSub) << (e - kSubBits));
+    }
+
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t maxNs = 0;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include "log_sink.h"
+
+LogSink::LogSink(std::streambuf* consoleBuf)
+    : head(new Node()), console(consoleBuf)
+{
+    tail = head.load();
+    writer = std::thread(&LogSink::run, this);
+}
+
+LogSink::~LogSink() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+    delete tail;
+}
+
+bool LogSink::openFile(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(mutex);
+    file.open(filename, std::ios::out | std::ios::binary);
+    return file.is_open();
+}
+
+void LogSink::log(std::string text) {
+    if (text.empty()) {
+        return;
+    }
+    Node* node = new Node();
+    node->text = std::move(text);
+    // publish: the writer sees the node once prev->next points at it
+    Node* prev = head.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+    submitted.fetch_add(1, std::memory_order_release);
+}
+
+bool LogSink::pop(std::string& text) {
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (!next) {
+        return false;
+    }
+    // next becomes the new dummy, its text moves out
+    text = std::move(next->text);
+    delete tail;
+    tail = next;
+    return true;
+}
+
+bool LogSink::progressDue() {
+    long long now = std::chrono::steady_clock::now().time_since_epoch().count();
+    long long due = nextProgress.load(std::memory_order_relaxed);
+    if (now < due) {
+        return false;
+    }
+    // only one caller wins each interval
+    return nextProgress.compare_exchange_strong(due, now + progressInterval.count(),
+                                                std::memory_order_relaxed);
+}
+
+void LogSink::flush() {
+    long long target = submitted.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(mutex);
+    flushRequested = true;
+    wake.notify_one();
+    drained.wait(lock, [&] { return written >= target; });
+}
+
+void LogSink::run() {
+    std::string batch, text;
+    long long count = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        // polling keeps log() free of locks and notifications; the wait
+        // doubles as the batching window
+        wake.wait_for(lock, std::chrono::milliseconds(5),
+                      [this] { return stopping || flushRequested; });
+        bool finishing = stopping;
+        flushRequested = false;
+        lock.unlock();
+
+        batch.clear();
+        count = 0;
+        while (pop(text)) {
+            batch += text;
+            count++;
+        }
+        if (!batch.empty()) {
+            if (console) {
+                console->sputn(batch.data(), std::streamsize(batch.size()));
+                console->pubsync();
+            }
+            if (file.is_open()) {
+                file.write(batch.data(), std::streamsize(batch.size()));
+                file.flush();
+            }
+        }
+
+        lock.lock();
+        written += count;
+        drained.notify_all();
+        // a producer may still be between its exchange and store, so
+        // keep going until every submitted message has been written
+        if (finishing && written >= submitted.load(std::memory_order_acquire)) {
+            break;
+        }
+    }
+}
+
+int LogStreamBuf::overflow(int c) {
+    if (c == traits_type::eof()) {
+        return traits_type::not_eof(c);
+    }
+    pending.push_back(char(c));
+    if (c == '\n') {
+        sync();
+    }
+    return c;
+}
+
+std::streamsize LogStreamBuf::xsputn(const char* s, std::streamsize n) {
+    pending.append(s, size_t(n));
+    if (pending.find('\n', pending.size() - size_t(n)) != std::string::npos) {
+        sync();
+    }
+    return n;
+}
+
+int LogStreamBuf::sync() {
+    if (!pending.empty()) {
+        sink.log(std::move(pending));
+        pending.clear();
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+#ifndef LOG_SINK_H
+#define LOG_SINK_H
+
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <fstream>
+#include <streambuf>
+
+// console + file logging that never makes the caller wait for I/O
+//
+// log() pushes the text onto a lock-free queue (any number of threads
+// may call it); a background thread drains the queue every few
+// milliseconds and writes everything it found in one call per target
+class LogSink {
+public:
+    // console: where console output goes, usually std::cout.rdbuf()
+    // before it is redirected; nullptr for file only
+    explicit LogSink(std::streambuf* console);
+
+    // writes out everything logged, then stops the writer
+    ~LogSink();
+
+    LogSink(const LogSink&) = delete;
+    LogSink& operator=(const LogSink&) = delete;
+
+    // also write to filename (truncated); false if it can't be opened.
+    // call before logging from other threads
+    bool openFile(const std::string& filename);
+
+    void log(std::string text);
+
+    // true at most once per progress interval, for rate-limiting progress
+    // lines; cheap enough to ask after every game
+    bool progressDue();
+    void setProgressInterval(std::chrono::milliseconds interval) { progressInterval = interval; }
+
+    // blocks until everything logged before the call has been written
+    void flush();
+
+private:
+    struct Node {
+        std::atomic<Node*> next{ nullptr };
+        std::string text;
+    };
+
+    // multi-producer single-consumer queue: producers swap themselves in
+    // at head, the writer follows next pointers from tail (a dummy node)
+    bool pop(std::string& text);
+
+    void run();
+
+    std::atomic<Node*> head;
+    Node* tail;
+    std::atomic<long long> submitted{ 0 };
+    long long written = 0;    // guarded by mutex
+
+    std::streambuf* console;
+    std::ofstream file;
+
+    std::chrono::steady_clock::duration progressInterval = std::chrono::milliseconds(500);
+    std::atomic<long long> nextProgress{ 0 };
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable drained;
+    bool stopping = false;
+    bool flushRequested = false;
+    std::thread writer;
+};
+
+// streambuf that hands whole lines to a LogSink, so std::cout can be
+// pointed at one; like std::cout itself, use it from one thread at a time
+class LogStreamBuf : public std::streambuf {
+public:
+    explicit LogStreamBuf(LogSink& sink) : sink(sink) {}
+    ~LogStreamBuf() { sync(); }
+
+protected:
+    int overflow(int c) override;
+    std::streamsize xsputn(const char* s, std::streamsize n) override;
+    int sync() override;
+
+private:
+    LogSink& sink;
+    std::string pending;
+};
+
+#endif
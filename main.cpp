@@ -1,237 +1,95 @@
 #include <iostream>
 #include <string>
-#include <chrono>
+#include <memory>
 
 #include "tic_tac_toe.h"
 #include "minimax.h"
 #include "qlearning.h"
 #include "opponents.h"
-
-void trainQAgent(QLearningAgent& agent, Minimax& minimaxPlayer, int episodes) {
-    using namespace std::chrono; 
-    auto start = high_resolution_clock::now(); 
-
-    for (int ep = 0; ep < episodes; ep++) {
-        TicTacToe env;
-        while (!env.isGameOver()) {
-            std::string stateStr = agent.encodeBoard(env.getBoard());
-            int action = agent.chooseAction(env);
-            if (action < 0) break;
-
-            int ax, ay;
-            QLearningAgent::fromActionIndex(action, ax, ay);
-            env.makeMove(ax, ay, 1);
-
-            if (env.isGameOver()) {
-                int winner = env.checkWin();
-                double r = 0.0;
-                if (winner == 1) r = 1.0; 
-                else if (winner == 2) r = -1.0; 
-                agent.updateQ(stateStr, action, "", r, true);
-                break;
-            }
-
-            Move oppMove = minimaxPlayer.getBestMove(env, 2);
-            env.makeMove(oppMove.x, oppMove.y, 2);
-
-            std::string nextState = agent.encodeBoard(env.getBoard());
-            if (env.isGameOver()) {
-                int winner = env.checkWin();
-                double r = 0.0;
-                if (winner == 1) r = 1.0;
-                else if (winner == 2) r = -1.0;
-                agent.updateQ(stateStr, action, nextState, r, true);
-            } else {
-                agent.updateQ(stateStr, action, nextState, 0.0, false);
-            }
-        }
-
-        if ((ep + 1) % 1000 == 0) {
-            auto now = high_resolution_clock::now();
-            auto elapsedDuration = std::chrono::duration_cast<std::chrono::duration<double>>(now - start);
-            double seconds = elapsedDuration.count();
-            double estimatedTotalTime = seconds / (ep + 1) * episodes;
-            double timeRemaining = estimatedTotalTime - seconds;
-
-            std::cout << "Episode " << ep + 1 << "/" << episodes << " completed. ";
-            std::cout << "Elapsed time: " << seconds
-                      << "s, Estimated remaining time: "
-                      << timeRemaining/60 << "min\n";
-        }
+#include "opening_book.h"
+#include "mcts.h"
+#include "training.h"
+#include "rng.h"
+#include "profiler.h"
+
+// asks for the telemetry file when telemetry is on
+bool setupTelemetryFile(TrainingRun& run) {
+    if (run.telemetryEvery == 0) {
+        return true;
     }
-
-    std::cout << "Finished training " << episodes << " episodes.\n";
+    std::string defaultFile = telemetryFile(run.policyFile);
+    std::cout << "Telemetry file? (\"d\" for " << defaultFile << ", a .csv name for CSV): ";
+    std::string file;
+    std::cin >> file;
+    if (!std::cin.good()) {
+        std::cerr << "Invalid file name.\n";
+        return false;
+    }
+    run.telemetryFile = (file == "d" || file == "D") ? defaultFile : file;
+    return true;
 }
 
-void trainQAgentVsRandom(QLearningAgent& agent, int episodes) {
-    using namespace std::chrono; 
-    auto start = high_resolution_clock::now(); 
-
-    for (int ep = 0; ep < episodes; ep++) {
-        TicTacToe env;
-        while (!env.isGameOver()) {
-            std::string stateStr = agent.encodeBoard(env.getBoard());
-            int action = agent.chooseAction(env);
-            if (action < 0) break;
-
-            int ax, ay;
-            QLearningAgent::fromActionIndex(action, ax, ay);
-            env.makeMove(ax, ay, 1);
-
-            if (env.isGameOver()) {
-                int winner = env.checkWin();
-                double r = 0.0;
-                if (winner == 1) r = 1.0;
-                else if (winner == 2) r = -1.0;
-                agent.updateQ(stateStr, action, "", r, true);
-                break;
-            }
-
-            Move oppMove = getRandomMove(env, 2);
-            env.makeMove(oppMove.x, oppMove.y, 2);
+// "--q-backend linear|mlp" (and --q-hidden, --q-batch, --q-lr) trains
+// and plays a QModel instead of a table, see q_model.h
+static QModelConfig g_modelConfig;
+static bool g_useModel = false;
 
-            std::string nextState = agent.encodeBoard(env.getBoard());
-            if (env.isGameOver()) {
-                int winner = env.checkWin();
-                double r = 0.0;
-                if (winner == 1) r = 1.0;
-                else if (winner == 2) r = -1.0;
-                agent.updateQ(stateStr, action, nextState, r, true);
-            } else {
-                agent.updateQ(stateStr, action, nextState, 0.0, false);
-            }
-        }
+// "--alpha A[:END] --gamma G --epsilon E[:END] [--decay linear|exp]",
+// defaults 0.1, 1.0 and 0.2 with no decay, and "--update qlambda|mc
+// [--lambda L]" for multi-step backups, see HyperParams
+static HyperParams g_params;
 
-        if ((ep + 1) % 1000 == 0) {
-            auto now = high_resolution_clock::now();
-            auto elapsedDuration = std::chrono::duration_cast<std::chrono::duration<double>>(now - start);
-            double seconds = elapsedDuration.count();
-            double estimatedTotalTime = seconds / (ep + 1) * episodes;
-            double timeRemaining = estimatedTotalTime - seconds;
-
-            std::cout << "Episode " << ep + 1 << "/" << episodes << " completed. ";
-            std::cout << "Elapsed time: " << seconds
-                      << "s, Estimated remaining time: "
-                      << timeRemaining/60 << "min\n";
-        }
-    }
+// "--book file" (from book_build): minimax and the Q player play the
+// opening from it, see opening_book.h. the buggy opponents never do, or
+// a deep enough book would replace their bugs with the book's moves
+static std::shared_ptr<const OpeningBook> g_book;
 
-    std::cout << "Finished training " << episodes << " episodes.\n";
+// the book's move for the opening, {-1, -1} past it or without a book
+static Move bookMove(const TicTacToe& game, Rng& rng) {
+    return g_book ? g_book->pickMove(game, rng) : Move{-1, -1};
 }
 
-void trainQAgentVsBuggy(QLearningAgent& agent, int episodes) {
-    using namespace std::chrono; 
-    auto start = high_resolution_clock::now(); 
-    static Minimax buggyMm; 
-
-    for (int ep = 0; ep < episodes; ep++) {
-        TicTacToe env;
-        while (!env.isGameOver()) {
-            std::string stateStr = agent.encodeBoard(env.getBoard());
-            int action = agent.chooseAction(env);
-            if (action < 0) break;
-
-            int ax, ay;
-            QLearningAgent::fromActionIndex(action, ax, ay);
-            env.makeMove(ax, ay, 1);
-
-            if (env.isGameOver()) {
-                int winner = env.checkWin();
-                double r = 0.0;
-                if (winner == 1) r = 1.0;
-                else if (winner == 2) r = -1.0;
-                agent.updateQ(stateStr, action, "", r, true);
-                break;
-            }
-
-            Move oppMove = getBuggyMinimaxMove(env, buggyMm, 2);
-            env.makeMove(oppMove.x, oppMove.y, 2);
-
-            std::string nextState = agent.encodeBoard(env.getBoard());
-            if (env.isGameOver()) {
-                int winner = env.checkWin();
-                double r = 0.0;
-                if (winner == 1) r = 1.0;
-                else if (winner == 2) r = -1.0;
-                agent.updateQ(stateStr, action, nextState, r, true);
-            } else {
-                agent.updateQ(stateStr, action, nextState, 0.0, false);
-            }
-        }
-
-        if ((ep + 1) % 1000 == 0) {
-            auto now = high_resolution_clock::now();
-            auto elapsedDuration = std::chrono::duration_cast<std::chrono::duration<double>>(now - start);
-            double seconds = elapsedDuration.count();
-            double estimatedTotalTime = seconds / (ep + 1) * episodes;
-            double timeRemaining = estimatedTotalTime - seconds;
-
-            std::cout << "Episode " << ep + 1 << "/" << episodes << " completed. ";
-            std::cout << "Elapsed time: " << seconds
-                      << "s, Estimated remaining time: "
-                      << timeRemaining/60 << "min\n";
+// asks where to resume from, how far to train, how often to checkpoint
+// and whether to write telemetry
+bool setupTrainingRun(QLearningAgent& agent, TrainingRun& run, long long& episodes) {
+    if (g_useModel) {
+        agent.setModel(g_modelConfig);
+    }
+    agent.setUpdateMode(g_params.update, g_params.lambda);
+    run.params = g_params;
+    run.book = g_book;
+    std::cout << "Resume from a saved policy? (filename, or \"n\" to start fresh): ";
+    std::string resumeFile;
+    std::cin >> resumeFile;
+    if (resumeFile != "n" && resumeFile != "N") {
+        if (!resumeTraining(agent, resumeFile, run.params, run.state)) {
+            return false;
         }
+    } else {
+        run.state.seed = rootSeed();
     }
 
-    std::cout << "Finished training " << episodes << " episodes.\n";
-}
+    std::cout << "How many training episodes? (total, including resumed ones): ";
+    std::cin >> episodes;
 
-void trainQAgentVsBuggy2(QLearningAgent& agent, int episodes) {
-    using namespace std::chrono; 
-    auto start = high_resolution_clock::now(); 
-    static Minimax mmForBuggy2;
-
-    for (int ep = 0; ep < episodes; ep++) {
-        TicTacToe env;
-        while (!env.isGameOver()) {
-            std::string stateStr = agent.encodeBoard(env.getBoard());
-            int action = agent.chooseAction(env);
-            if (action < 0) break;
-
-            int ax, ay;
-            QLearningAgent::fromActionIndex(action, ax, ay);
-            env.makeMove(ax, ay, 1);
-
-            if (env.isGameOver()) {
-                int winner = env.checkWin();
-                double r = 0.0;
-                if (winner == 1) r = 1.0;
-                else if (winner == 2) r = -1.0;
-                agent.updateQ(stateStr, action, "", r, true);
-                break;
-            }
+    std::cout << "Checkpoint every how many episodes? (0 = only at the end): ";
+    std::cin >> run.checkpointEvery;
 
-            Move oppMove = getBuggyMinimaxMove2(env, mmForBuggy2, 2);
-            env.makeMove(oppMove.x, oppMove.y, 2);
+    std::cout << "Keep a numbered snapshot every how many episodes? (0 = none, at least "
+              << kMinSnapshotEvery << "): ";
+    std::cin >> run.snapshotEvery;
 
-            std::string nextState = agent.encodeBoard(env.getBoard());
-            if (env.isGameOver()) {
-                int winner = env.checkWin();
-                double r = 0.0;
-                if (winner == 1) r = 1.0;
-                else if (winner == 2) r = -1.0;
-                agent.updateQ(stateStr, action, nextState, r, true);
-            } else {
-                agent.updateQ(stateStr, action, nextState, 0.0, false);
-            }
-        }
+    std::cout << "Write telemetry every how many episodes? (0 = none): ";
+    std::cin >> run.telemetryEvery;
 
-        if ((ep + 1) % 1000 == 0) {
-            auto now = high_resolution_clock::now();
-            auto elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(now - start).count();
-            double estTotal = elapsed / (ep + 1) * episodes;
-            double timeRem = estTotal - elapsed;
-            std::cout << "Episode " << ep + 1 << "/" << episodes << " completed. "
-                      << "Elapsed time: " << elapsed
-                      << "s, Estimated remaining time: "
-                      << timeRem/60 << "min\n";
-        }
+    if (!std::cin.good() || episodes < 0 || run.checkpointEvery < 0 || run.snapshotEvery < 0
+        || run.telemetryEvery < 0) {
+        std::cerr << "Invalid number.\n";
+        return false;
     }
-
-    std::cout << "Finished training " << episodes << " episodes.\n";
+    return setupTelemetryFile(run);
 }
 
-
 Move qLearningGetBestMove(TicTacToe& game, QLearningAgent& agent, int player) {
     int action = agent.chooseAction(game);
     if (action < 0) {
@@ -242,8 +100,22 @@ Move qLearningGetBestMove(TicTacToe& game, QLearningAgent& agent, int player) {
     return { x, y };
 }
 
-int main() {
-    std::cout << "Tic-Tac-Toe\n";
+int main(int argc, char** argv) {
+    // "--seed N" reproduces a previous run
+    uint64_t seed = seedFromArgs(argc, argv);
+    g_useModel = qModelConfigFromArgs(argc, argv, g_modelConfig);
+    g_params = hyperParamsFromArgs(argc, argv);
+    g_book = openingBookFromArgs(argc, argv);
+
+    // "--record games.tttg" keeps every training game, see game_record.h
+    std::string recordFile;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--record") {
+            recordFile = argv[i + 1];
+        }
+    }
+
+    std::cout << "Tic-Tac-Toe (seed " << seed << ")\n";
     std::cout << "Select an option:\n";
     std::cout << "   0 => Normal game setup\n";
     std::cout << "   1 => Train Q-learning agent vs Minimax  (output: q_policy.dat)\n";
@@ -260,62 +132,75 @@ int main() {
 
     if (choice == 1) {
         std::cout << "Training Q-learning agent vs. Minimax...\n";
-        QLearningAgent agent(0.1, 1.0, 0.2); // alpha=0.1, gamma=1.0, epsilon=0.2
+        QLearningAgent agent(g_params.alpha.start, g_params.gamma, g_params.epsilon.start);
         Minimax minimaxPlayer;
+        minimaxPlayer.setThreads(minimaxThreadsFromArgs(argc, argv));
+
+        TrainingRun run;
+        run.policyFile = "q_policy.dat";
+        run.recordFile = recordFile;
+        long long episodes;
+        if (!setupTrainingRun(agent, run, episodes)) {
+            return 1;
+        }
 
-        int episodes;
-        std::cout << "How many training episodes?: ";
-        std::cin >> episodes;
-
-        trainQAgent(agent, minimaxPlayer, episodes);
-
-        agent.savePolicy("q_policy.dat");
+        trainQAgent(agent, minimaxPlayer, episodes, run);
         std::cout << "Training complete. Policy saved to q_policy.dat.\n";
+        profileDump("tic_tac_toe");
         return 0;
     }
     else if (choice == 2) {
         // Train QLearning model vs. Random
         std::cout << "Training Q-learning agent vs. Random...\n";
-        QLearningAgent agent(0.1, 1.0, 0.2);
-
-        int episodes;
-        std::cout << "How many training episodes?: ";
-        std::cin >> episodes;
-
-        trainQAgentVsRandom(agent, episodes);
+        QLearningAgent agent(g_params.alpha.start, g_params.gamma, g_params.epsilon.start);
+
+        TrainingRun run;
+        run.policyFile = "q_policy_random.dat";
+        run.recordFile = recordFile;
+        long long episodes;
+        if (!setupTrainingRun(agent, run, episodes)) {
+            return 1;
+        }
 
-        agent.savePolicy("q_policy_random.dat");
+        trainQAgentVsRandom(agent, episodes, run);
         std::cout << "Training complete. Policy saved to q_policy_random.dat.\n";
+        profileDump("tic_tac_toe");
         return 0;
     }
     else if (choice == 3) {
         // Train QLearning model vs. Buggy Minimax
         std::cout << "Training Q-learning agent vs. Buggy Minimax...\n";
-        QLearningAgent agent(0.1, 1.0, 0.2);
-
-        int episodes;
-        std::cout << "How many training episodes?: ";
-        std::cin >> episodes;
-
-        trainQAgentVsBuggy(agent, episodes);
+        QLearningAgent agent(g_params.alpha.start, g_params.gamma, g_params.epsilon.start);
+
+        TrainingRun run;
+        run.policyFile = "q_policy_buggy.dat";
+        run.recordFile = recordFile;
+        long long episodes;
+        if (!setupTrainingRun(agent, run, episodes)) {
+            return 1;
+        }
 
-        agent.savePolicy("q_policy_buggy.dat");
+        trainQAgentVsBuggy(agent, episodes, run);
         std::cout << "Training complete. Policy saved to q_policy_buggy.dat.\n";
+        profileDump("tic_tac_toe");
         return 0;
     }
     else if (choice == 4) {
         // Train QLearning model vs. Buggy2
         std::cout << "Training Q-learning agent vs. Buggy Minimax2...\n";
-        QLearningAgent agent(0.1, 1.0, 0.2);
-
-        int episodes;
-        std::cout << "How many training episodes?: ";
-        std::cin >> episodes;
-
-        trainQAgentVsBuggy2(agent, episodes);
+        QLearningAgent agent(g_params.alpha.start, g_params.gamma, g_params.epsilon.start);
+
+        TrainingRun run;
+        run.policyFile = "q_policy_buggy2.dat";
+        run.recordFile = recordFile;
+        long long episodes;
+        if (!setupTrainingRun(agent, run, episodes)) {
+            return 1;
+        }
 
-        agent.savePolicy("q_policy_buggy2.dat");
+        trainQAgentVsBuggy2(agent, episodes, run);
         std::cout << "Training complete. Policy saved to q_policy_buggy2.dat.\n";
+        profileDump("tic_tac_toe");
         return 0;
     }
 
@@ -325,7 +210,8 @@ int main() {
               << "   2 => qlearning\n"
               << "   3 => random\n"
               << "   4 => buggyMinimax\n"
-              << "   5 => buggyMinimax2\n";
+              << "   5 => buggyMinimax2\n"
+              << "   6 => mcts\n";
     int p1Type;
     std::cin >> p1Type;
 
@@ -335,17 +221,30 @@ int main() {
               << "   2 => qlearning\n"
               << "   3 => random\n"
               << "   4 => buggyMinimax\n"
-              << "   5 => buggyMinimax2\n";
+              << "   5 => buggyMinimax2\n"
+              << "   6 => mcts\n";
     int p2Type;
     std::cin >> p2Type;
 
     QLearningAgent qAgent(0.1, 1.0, 0.0); 
+    if (g_useModel) {
+        qAgent.setModel(g_modelConfig);
+    }
     if (p1Type == 2 || p2Type == 2) {
         qAgent.loadPolicy("q_policy.dat"); 
     }
 
     TicTacToe game;
+    // "--minimax-threads N" scores the root moves in parallel
     Minimax minimaxPlayer;
+    minimaxPlayer.setThreads(minimaxThreadsFromArgs(argc, argv));
+    minimaxPlayer.setBook(g_book);
+    // --mcts-playouts, --mcts-ms, --mcts-threads, --mcts-policy, see mcts.h
+    std::unique_ptr<Mcts> mctsPlayer;
+    if (p1Type == 6 || p2Type == 6) {
+        mctsPlayer.reset(new Mcts(mctsConfigFromArgs(argc, argv)));
+    }
+    Rng opponentRng = makeStream(nextStreamId());
     int currentPlayer = 1;
     game.printBoard();
 
@@ -394,7 +293,10 @@ int main() {
                 break;
             }
             case 2: {
-                moveChosen = qLearningGetBestMove(game, qAgent, currentPlayer);
+                moveChosen = bookMove(game, opponentRng);
+                if (moveChosen.x < 0) {
+                    moveChosen = qLearningGetBestMove(game, qAgent, currentPlayer);
+                }
                 if (moveChosen.x < 0) {
                     std::cout << "Q-learning player has no valid move\n";
                 } else {
@@ -405,7 +307,7 @@ int main() {
                 break;
             }
             case 3: {
-                moveChosen = getRandomMove(game, currentPlayer);
+                moveChosen = getRandomMove(game, currentPlayer, opponentRng);
                 if (moveChosen.x < 0) {
                     std::cout << "Random player has no valid move\n";
                 } else {
@@ -416,7 +318,7 @@ int main() {
                 break;
             }
             case 4: {
-                moveChosen = getBuggyMinimaxMove(game, minimaxPlayer, currentPlayer);
+                moveChosen = getBuggyMinimaxMove(game, currentPlayer, opponentRng);
                 if (moveChosen.x < 0) {
                     std::cout << "BuggyMinimax found no valid move\n";
                 } else {
@@ -427,7 +329,7 @@ int main() {
                 break;
             }
             case 5: {
-                moveChosen = getBuggyMinimaxMove2(game, minimaxPlayer, currentPlayer);
+                moveChosen = getBuggyMinimaxMove2(game, currentPlayer, opponentRng);
                 if (moveChosen.x < 0) {
                     std::cout << "BuggyMinimax2 found no valid move\n";
                 } else {
@@ -437,6 +339,18 @@ int main() {
                 }
                 break;
             }
+            case 6: {
+                moveChosen = mctsPlayer->getBestMove(game, currentPlayer);
+                if (moveChosen.x < 0) {
+                    std::cout << "MCTS found no valid move\n";
+                } else {
+                    game.makeMove(moveChosen.x, moveChosen.y, currentPlayer);
+                    std::cout << "MCTS player " << currentPlayer
+                              << " placed at (" << moveChosen.x << "," << moveChosen.y << ") after "
+                              << mctsPlayer->lastPlayouts() << " playouts\n";
+                }
+                break;
+            }
             default:
                 std::cerr << "Invalid player type!\n";
                 return 1;
@@ -1,6 +1,5 @@
 #include <iostream>
 #include <string>
-#include <unordered_set>
 #include <chrono>      
 #include <random>    
 #include <fstream>     
@@ -9,53 +8,61 @@
 #include "minimax.h"
 #include "qlearning.h"
 #include "opponents.h"  
-
-
-class TeeBuf : public std::streambuf
-{
-public:
-
-    TeeBuf(std::streambuf* sb1, std::streambuf* sb2)
-        : m_sb1(sb1), m_sb2(sb2)
-    {
+#include "rng.h"
+#include "profiler.h"
+#include "log_sink.h"
+#include "game_record.h"
+#include "outcome_stats.h"
+#include "tournament.h"
+#include "mcts.h"
+#include "iterative_minimax.h"
+#include "opening_book.h"
+#include <thread>
+#include <cstdlib>
+
+
+// points std::cout at buf until the end of the scope
+struct CoutRedirect {
+    std::streambuf* saved;
+    explicit CoutRedirect(std::streambuf* buf) : saved(std::cout.rdbuf(buf)) {}
+    ~CoutRedirect() {
+        std::cout.flush();
+        std::cout.rdbuf(saved);
     }
+};
 
-protected:
-
-    virtual std::streamsize xsputn(const char* s, std::streamsize n) override {
-        auto put1 = m_sb1->sputn(s, n);
-        auto put2 = m_sb2->sputn(s, n);
-        return (put1 < put2) ? put1 : put2;
-    }
+// random streams for each seat, seeded from the root seed in main
+static Rng g_p1Rng;
+static Rng g_p2Rng;
 
-    virtual int overflow(int c = EOF) override {
-        if (c == EOF) {
-            return !EOF;
-        }
-        int r1 = m_sb1->sputc(static_cast<char>(c));
-        int r2 = m_sb2->sputc(static_cast<char>(c));
-        return (r1 == EOF || r2 == EOF) ? EOF : c;
-    }
+// mcts seats, built in main from the --mcts-* options
+static std::unique_ptr<Mcts> g_mctsP1;
+static std::unique_ptr<Mcts> g_mctsP2;
 
-private:
-    std::streambuf* m_sb1;
-    std::streambuf* m_sb2;
-};
+// time-limited minimax seats, from the --id-* options
+static std::unique_ptr<IterativeMinimax> g_idP1;
+static std::unique_ptr<IterativeMinimax> g_idP2;
 
+// root split threads for the minimax seats, from --minimax-threads
+static int g_minimaxThreads = 1;
 
-std::string encodeBoard(const Board& board) {
+// --book file: minimax and Q policies play the opening from it (see
+// opening_book.h); the tournament wraps its players. the buggy players
+// never open from it, so that a deep book cannot hide their bugs
+static std::shared_ptr<const OpeningBook> g_book;
 
-    std::string result;
-    result.reserve(9);
-    for (int y = 2; y >= 0; --y) {
-        for (int x = 0; x < 3; ++x) {
-            result.push_back(char('0' + board[y][x]));
-        }
-    }
-    return result;
+// the book's move for the opening, {-1, -1} past it or without a book
+static Move openingMove(const TicTacToe& game, Rng& rng) {
+    return g_book ? g_book->pickMove(game, rng) : Move{-1, -1};
 }
 
 Move chooseMoveMinimax(TicTacToe& game, Minimax& mm, int player) {
+    if (mm.threads() != g_minimaxThreads) {
+        mm.setThreads(g_minimaxThreads);
+    }
+    if (mm.openingBook() != g_book.get()) {
+        mm.setBook(g_book);
+    }
     return mm.getBestMove(game, player);
 }
 
@@ -71,30 +78,134 @@ Move chooseMoveQ(TicTacToe& game, QLearningAgent& agent, int player) {
     return {x, y};
 }
 
-int main() {
+// matchup --tournament minimax random buggy q_policy.dat 2m-episode-model
+//         [--games N] [--threads N] [--seed N] [--book file]
+//
+// every participant plays every other one, N games in each seat order
+static int runTournamentMode(int argc, char** argv, uint64_t seed) {
+    long long gamesPerSeating = 10000;
+    int threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::string> specs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--tournament") {
+            continue;
+        } else if ((arg == "--games" || arg == "--threads" || arg == "--seed" || arg == "--book") && i + 1 < argc) {
+            if (arg == "--games")   gamesPerSeating = std::atoll(argv[i + 1]);
+            if (arg == "--threads") threads = std::atoi(argv[i + 1]);
+            ++i;
+        } else {
+            specs.push_back(arg);
+        }
+    }
+
+    // every policy is loaded once here and only read from then on
+    std::vector<std::unique_ptr<Player>> players;
+    for (const std::string& spec : specs) {
+        if (!makePlayers(spec, players)) {
+            return 1;
+        }
+    }
+    if (players.size() < 2 || gamesPerSeating <= 0) {
+        std::cerr << "usage: matchup --tournament player player [...] [--games N] "
+                     "[--threads N] [--seed N] [--book file]\n"
+                  << "  players: minimax, random, buggy, buggy2, a .dat file or a "
+                     "directory of them\n";
+        return 1;
+    }
+
+    // everyone but the random and buggy players opens from the book
+    std::shared_ptr<const OpeningBook> book = openingBookFromArgs(argc, argv);
+    if (book) {
+        for (std::unique_ptr<Player>& player : players) {
+            const std::string& name = player->name();
+            if (name != "random" && name != "buggy" && name != "buggy2") {
+                player.reset(new BookPlayer(std::move(player), book));
+            }
+        }
+    }
+
+    Rng nameRng(uint64_t(std::time(nullptr)) ^ seed);
+    unsigned randNum = unsigned(nameRng.uniformInt(90000000)) + 10000000;
+    std::string outFilename = "results/tournament_" + std::to_string(randNum) + ".txt";
+
+    LogSink sink(std::cout.rdbuf());
+    LogStreamBuf logBuf(sink);
+    if (!sink.openFile(outFilename)) {
+        std::cerr << "Warning: Could not open output file " << outFilename << " for writing!\n"
+                  << "Continuing without file logging...\n";
+    }
+    CoutRedirect redirect(&logBuf);
+
+    std::cout << "===== Tic-Tac-Toe Tournament =====\n\n"
+              << "Logging to file: " << outFilename << "\n"
+              << "Seed: " << seed << "\n"
+              << players.size() << " players, " << gamesPerSeating
+              << " games per pairing and seat order, " << threads << " threads\n";
+
+    Rng gamesRng = makeStream(nextStreamId());
+    Rng ratingRng = makeStream(nextStreamId());
+    TournamentResult result = runTournament(players, gamesPerSeating, threads, gamesRng,
+        [&](long long done, long long total) {
+            if (sink.progressDue() || done == total) {
+                std::cout << "Games " << done << "/" << total << " ("
+                          << int(done * 100.0 / total) << "%)\n";
+            }
+        });
+    long long totalGames = gamesPerSeating * (long long)players.size() * (long long)(players.size() - 1);
+    std::cout << "\n" << totalGames << " games in " << result.seconds << "s ("
+              << (result.seconds > 0 ? double(totalGames) / result.seconds : 0.0)
+              << " games/s)\n";
+
+    std::vector<Rating> ratings = bradleyTerryRatings(result, 200, ratingRng);
+    printTournament(std::cout, players, result, ratings);
+
+    profileDump("matchup");
+    return 0;
+}
+
+int main(int argc, char** argv) {
 
-    std::srand(static_cast<unsigned>(std::time(nullptr)));
-    unsigned randNum = (std::rand() % 90000000) + 10000000; 
+    // "--seed N" replays a previous matchup game for game
+    uint64_t seed = seedFromArgs(argc, argv);
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--tournament") {
+            return runTournamentMode(argc, argv, seed);
+        }
+    }
+    g_p1Rng = makeStream(nextStreamId());
+    g_p2Rng = makeStream(nextStreamId());
+    g_minimaxThreads = minimaxThreadsFromArgs(argc, argv);
+    g_book = openingBookFromArgs(argc, argv);
+
+    // the file name is not part of the experiment, keep it off the root seed
+    Rng nameRng(uint64_t(std::time(nullptr)) ^ seed);
+    unsigned randNum = unsigned(nameRng.uniformInt(90000000)) + 10000000; 
     std::string outFilename = "results/result_" + std::to_string(randNum) + ".txt";
+    std::string gamesFilename = "results/result_" + std::to_string(randNum) + ".tttg";
 
-    std::ofstream outFile(outFilename);
-    if (!outFile) {
+    // console and file output go through a background writer, so the
+    // game loop never waits on the terminal or the disk
+    LogSink sink(std::cout.rdbuf());
+    LogStreamBuf logBuf(sink);
+    if (!sink.openFile(outFilename)) {
         std::cerr << "Warning: Could not open output file " << outFilename << " for writing!\n"
                   << "Continuing without file logging...\n";
-    } else {
-        static TeeBuf teeBuf(std::cout.rdbuf(), outFile.rdbuf());
-        std::cout.rdbuf(&teeBuf); 
     }
+    CoutRedirect redirect(&logBuf);
 
 
     std::cout << "===== Tic-Tac-Toe Matchup =====\n\n"
-              << "Logging to file: " << outFilename << "\n\n";
+              << "Logging to file: " << outFilename << "\n"
+              << "Seed: " << seed << "\n\n";
 
     std::cout << "Enter Player1 type:\n"
               << "   \"minimax\" => standard Minimax\n"
               << "   \"random\"  => random opponent\n"
               << "   \"buggy\"   => buggy Minimax\n"
               << "   \"buggy2\"  => buggy Minimax #2\n"
+              << "   \"mcts\"    => Monte Carlo tree search (--mcts-* options)\n"
+              << "   \"idminimax\" => iterative deepening Minimax (--id-* options)\n"
               << "   or provide a Q policy filename (e.g. \"q_policy.dat\")\n"
               << "Player1: ";
     std::string p1Choice;
@@ -105,6 +216,8 @@ int main() {
               << "   \"random\"  => random opponent\n"
               << "   \"buggy\"   => buggy Minimax\n"
               << "   \"buggy2\"  => buggy Minimax #2\n"
+              << "   \"mcts\"    => Monte Carlo tree search (--mcts-* options)\n"
+              << "   \"idminimax\" => iterative deepening Minimax (--id-* options)\n"
               << "   or provide a Q policy filename (e.g. \"q_policy.dat\")\n"
               << "Player2: ";
     std::string p2Choice;
@@ -134,26 +247,37 @@ int main() {
     }
     else if (p1Choice == "random") {
         p1MoveFn = [](TicTacToe& game, int player) {
-            return getRandomMove(game, player);
+            return getRandomMove(game, player, g_p1Rng);
         };
     }
     else if (p1Choice == "buggy") {
         p1MoveFn = [](TicTacToe& game, int player) {
-            static Minimax mm;
-            return getBuggyMinimaxMove(game, mm, player);
+            return getBuggyMinimaxMove(game, player, g_p1Rng);
         };
     }
     else if (p1Choice == "buggy2") {
         p1MoveFn = [](TicTacToe& game, int player) {
-            static Minimax mm;
-            return getBuggyMinimaxMove2(game, mm, player);
+            return getBuggyMinimaxMove2(game, player, g_p1Rng);
+        };
+    }
+    else if (p1Choice == "mcts") {
+        g_mctsP1.reset(new Mcts(mctsConfigFromArgs(argc, argv)));
+        p1MoveFn = [](TicTacToe& game, int player) {
+            return g_mctsP1->getBestMove(game, player);
+        };
+    }
+    else if (p1Choice == "idminimax") {
+        g_idP1.reset(new IterativeMinimax(iterativeMinimaxConfigFromArgs(argc, argv)));
+        p1MoveFn = [](TicTacToe& game, int player) {
+            return g_idP1->getBestMove(game, player);
         };
     }
     else {
         qP1.loadPolicy(p1Choice);
         p1MoveFn = [](TicTacToe& game, int player) {
             static QLearningAgent& agent = qP1;
-            return chooseMoveQ(game, agent, player);
+            Move m = openingMove(game, g_p1Rng);
+            return m.x >= 0 ? m : chooseMoveQ(game, agent, player);
         };
     }
 
@@ -165,43 +289,63 @@ int main() {
     }
     else if (p2Choice == "random") {
         p2MoveFn = [](TicTacToe& game, int player) {
-            return getRandomMove(game, player);
+            return getRandomMove(game, player, g_p2Rng);
         };
     }
     else if (p2Choice == "buggy") {
         p2MoveFn = [](TicTacToe& game, int player) {
-            static Minimax mm;
-            return getBuggyMinimaxMove(game, mm, player);
+            return getBuggyMinimaxMove(game, player, g_p2Rng);
         };
     }
     else if (p2Choice == "buggy2") {
         p2MoveFn = [](TicTacToe& game, int player) {
-            static Minimax mm;
-            return getBuggyMinimaxMove2(game, mm, player);
+            return getBuggyMinimaxMove2(game, player, g_p2Rng);
+        };
+    }
+    else if (p2Choice == "mcts") {
+        g_mctsP2.reset(new Mcts(mctsConfigFromArgs(argc, argv)));
+        p2MoveFn = [](TicTacToe& game, int player) {
+            return g_mctsP2->getBestMove(game, player);
+        };
+    }
+    else if (p2Choice == "idminimax") {
+        g_idP2.reset(new IterativeMinimax(iterativeMinimaxConfigFromArgs(argc, argv)));
+        p2MoveFn = [](TicTacToe& game, int player) {
+            return g_idP2->getBestMove(game, player);
         };
     }
     else {
         qP2.loadPolicy(p2Choice);
         p2MoveFn = [](TicTacToe& game, int player) {
             static QLearningAgent& agent = qP2;
-            return chooseMoveQ(game, agent, player);
+            Move m = openingMove(game, g_p2Rng);
+            return m.x >= 0 ? m : chooseMoveQ(game, agent, player);
         };
     }
 
+    // every game, for replay_games
+    GameRecordWriter recorder;
+    GameRecordHeader recordHeader;
+    recordHeader.seed = seed;
+    recordHeader.player1 = p1Choice;
+    recordHeader.player2 = p2Choice;
+    if (recorder.open(gamesFilename, recordHeader)) {
+        std::cout << "Recording games to " << gamesFilename << "\n";
+    }
+
     using namespace std::chrono;
     auto start = high_resolution_clock::now();
-    int lastPercent = -1;
 
-    std::unordered_set<std::string> finalStates;
+    OutcomeStats stats;
 
     int winsP1 = 0;
     int winsP2 = 0;
     int draws  = 0;
 
     for (int g = 0; g < numGames; ++g) {
-        int percent = int((g+1)*100.0 / numGames);
-        if (percent > lastPercent) {
-            lastPercent = percent;
+        // at most one progress line per interval, and always the last game
+        if (sink.progressDue() || g + 1 == numGames) {
+            int percent = int((g+1)*100.0 / numGames);
             auto now = high_resolution_clock::now();
             double elapsedSec = duration_cast<duration<double>>(now - start).count();
 
@@ -217,7 +361,9 @@ int main() {
                       << remainSec/60 << "m\n";
         }
 
+        PROFILE_SCOPE("matchup/game");
         TicTacToe game;
+        GameRecord record;
         int currentPlayer = 1; 
 
         while (!game.isGameOver()) {
@@ -232,6 +378,7 @@ int main() {
                 break;
             }
             game.makeMove(m.x, m.y, currentPlayer);
+            record.moves[record.count++] = uint8_t(m.y * 3 + m.x);
 
             if (game.isGameOver()) {
                 int winner = game.checkWin();
@@ -253,7 +400,10 @@ int main() {
             }
         }
 
-        finalStates.insert(encodeBoard(game.getBoard()));
+        stats.add(game.positionIndex(), record.count, record.count ? record.moves[0] : -1);
+
+        record.winner = game.checkWin();
+        recorder.write(record);
     }
 
 
@@ -264,11 +414,33 @@ int main() {
 
 
     std::cout << "\nNumber of unique ending board states: " 
-              << finalStates.size() << "\n";
+              << stats.uniqueEndings() << "\n";
+    stats.print(std::cout);
+
+    for (Mcts* mcts : { g_mctsP1.get(), g_mctsP2.get() }) {
+        if (mcts) {
+            std::cout << "\nMCTS " << (mcts == g_mctsP1.get() ? "Player1" : "Player2") << ": "
+                      << mcts->totalPlayouts() << " playouts in " << mcts->totalSeconds() << "s ("
+                      << (mcts->totalSeconds() > 0 ? double(mcts->totalPlayouts()) / mcts->totalSeconds() : 0.0)
+                      << " playouts/s, " << mcts->config().threads << " threads)\n";
+        }
+    }
+
+    for (IterativeMinimax* id : { g_idP1.get(), g_idP2.get() }) {
+        if (id) {
+            const SearchStats& t = id->totalStats();
+            std::cout << "\nIterative Minimax " << (id == g_idP1.get() ? "Player1" : "Player2") << ": "
+                      << t.nodes << " nodes in " << t.seconds << "s (" << t.nodesPerSecond()
+                      << " nodes/s)\n";
+        }
+    }
 
     auto end = high_resolution_clock::now();
     double totalSec = duration_cast<duration<double>>(end - start).count();
     std::cout << "\nDone. Total time: " << totalSec/60 << "m\n";
 
+    recorder.close();
+    profileDump("matchup");
+
     return 0;
 }
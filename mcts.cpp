@@ -0,0 +1,266 @@
+#include "mcts.h"
+#include <iostream>
+#include <string>
+#include <thread>
+#include <cmath>
+#include <algorithm>
+#include <cstdlib>
+#include "position_table.h"
+#include "profiler.h"
+
+MctsConfig mctsConfigFromArgs(int argc, char** argv) {
+    MctsConfig cfg;
+    bool playoutsGiven = false;
+    for (int i = 1; i + 1 < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--mcts-playouts") {
+            cfg.playouts = std::atoll(argv[i + 1]);
+            playoutsGiven = true;
+        }
+        else if (arg == "--mcts-ms")      cfg.seconds = std::atof(argv[i + 1]) / 1000.0;
+        else if (arg == "--mcts-threads") cfg.threads = std::max(1, std::atoi(argv[i + 1]));
+        else if (arg == "--mcts-c")       cfg.exploration = std::atof(argv[i + 1]);
+        else if (arg == "--mcts-policy") {
+            std::shared_ptr<PolicyPlayer> policy = std::make_shared<PolicyPlayer>(argv[i + 1]);
+            if (policy->load(argv[i + 1])) {
+                cfg.policy = policy;
+            } else {
+                std::cerr << "could not read " << argv[i + 1] << ", MCTS runs without a policy\n";
+            }
+        }
+    }
+    // "--mcts-ms N" on its own is a time limit only
+    if (cfg.seconds > 0 && !playoutsGiven) {
+        cfg.playouts = 0;
+    }
+    if (cfg.playouts <= 0 && cfg.seconds <= 0) {
+        cfg.playouts = MctsConfig().playouts;
+    }
+    return cfg;
+}
+
+Mcts::Mcts(const MctsConfig& config)
+    : cfg(config), arena(new MctsNode[config.arenaNodes]), rng(makeStream(nextStreamId()))
+{
+}
+
+static void initNode(MctsNode& n, int position, int move) {
+    n.visits.store(0, std::memory_order_relaxed);
+    n.score.store(0, std::memory_order_relaxed);
+    n.firstChild.store(-1, std::memory_order_relaxed);
+    n.state.store(0, std::memory_order_relaxed);
+    n.childCount = 0;
+    n.move = uint8_t(move);
+    n.position = uint16_t(position);
+}
+
+int32_t Mcts::newRoot(int position) {
+    arenaNext.store(1);
+    initNode(arena[0], position, 0);
+    return 0;
+}
+
+// the last root, one of its children or one of its grandchildren
+int32_t Mcts::findReusableRoot(int position) const {
+    if (root < 0) {
+        return -1;
+    }
+    if (arena[root].position == position) {
+        return root;
+    }
+    const MctsNode& r = arena[root];
+    if (r.state.load() != 2) {
+        return -1;
+    }
+    for (int i = 0; i < r.childCount; ++i) {
+        int32_t c = r.firstChild.load() + i;
+        if (arena[c].position == position) {
+            return c;
+        }
+        if (arena[c].state.load() != 2) {
+            continue;
+        }
+        for (int j = 0; j < arena[c].childCount; ++j) {
+            int32_t g = arena[c].firstChild.load() + j;
+            if (arena[g].position == position) {
+                return g;
+            }
+        }
+    }
+    return -1;
+}
+
+// UCT; an unvisited child is taken first. visits include the virtual
+// loss of threads still in flight below, which counts as lost games
+int32_t Mcts::selectChild(int32_t node) const {
+    const MctsNode& n = arena[node];
+    int32_t first = n.firstChild.load(std::memory_order_relaxed);
+    double logParent = std::log(double(std::max(1, n.visits.load(std::memory_order_relaxed))));
+    int32_t best = first;
+    double bestValue = -1.0;
+    for (int i = 0; i < n.childCount; ++i) {
+        const MctsNode& c = arena[first + i];
+        int32_t v = c.visits.load(std::memory_order_relaxed);
+        if (v <= 0) {
+            return first + i;
+        }
+        double value = double(c.score.load(std::memory_order_relaxed)) / (2.0 * v)
+                     + cfg.exploration * std::sqrt(logParent / v);
+        if (value > bestValue) {
+            bestValue = value;
+            best = first + i;
+        }
+    }
+    return best;
+}
+
+// true once node has children; false if another thread is expanding it
+// or the arena is full, in which case the caller plays out from node
+bool Mcts::expand(int32_t node) {
+    MctsNode& n = arena[node];
+    uint8_t expected = 0;
+    if (!n.state.compare_exchange_strong(expected, 1, std::memory_order_acq_rel)) {
+        return expected == 2;
+    }
+    const PositionInfo& info = positionInfo(n.position);
+    int count = moveCount(info.legalMoves);
+    if (size_t(arenaNext.load(std::memory_order_relaxed)) + count > cfg.arenaNodes) {
+        n.state.store(0, std::memory_order_release);
+        return false;
+    }
+    int32_t first = arenaNext.fetch_add(count, std::memory_order_relaxed);
+    if (size_t(first) + count > cfg.arenaNodes) {
+        n.state.store(0, std::memory_order_release);
+        return false;
+    }
+    int prior = cfg.policy ? cfg.policy->greedyMove(n.position) : -1;
+    int i = 0;
+    for (int a = 0; a < 9; ++a) {
+        if (!((info.legalMoves >> a) & 1)) continue;
+        MctsNode& c = arena[first + i++];
+        initNode(c, n.position + info.toMove * kPow3[a], a);
+        if (a == prior) {
+            c.visits.store(cfg.priorVisits, std::memory_order_relaxed);
+            c.score.store(2 * int64_t(cfg.priorVisits), std::memory_order_relaxed);
+        }
+    }
+    n.childCount = uint8_t(count);
+    n.firstChild.store(first, std::memory_order_relaxed);
+    n.state.store(2, std::memory_order_release);
+    return true;
+}
+
+// winner of a game finished from position by random (or policy) moves
+int Mcts::rollout(int position, Rng& stream) const {
+    while (!isTerminalPosition(position)) {
+        const PositionInfo& info = positionInfo(position);
+        int a = -1;
+        if (cfg.policy && stream.uniformReal() < cfg.rolloutGreedy) {
+            a = cfg.policy->greedyMove(position);
+        }
+        if (a < 0) {
+            a = nthMove(info.legalMoves, stream.uniformInt(moveCount(info.legalMoves)));
+        }
+        position += info.toMove * kPow3[a];
+    }
+    return positionInfo(position).winner;
+}
+
+void Mcts::searchThread(Rng stream) {
+    const int vl = cfg.virtualLoss;
+    std::vector<int32_t> path;
+    path.reserve(16);
+    for (long long iter = 0; !stopSearch.load(std::memory_order_relaxed); ++iter) {
+        long long n = playoutsDone.fetch_add(1, std::memory_order_relaxed);
+        if (cfg.playouts > 0 && n >= cfg.playouts) {
+            playoutsDone.fetch_sub(1, std::memory_order_relaxed);
+            stopSearch.store(true, std::memory_order_relaxed);
+            break;
+        }
+        if (cfg.seconds > 0 && (iter & 63) == 0 && std::chrono::steady_clock::now() >= deadline) {
+            playoutsDone.fetch_sub(1, std::memory_order_relaxed);
+            stopSearch.store(true, std::memory_order_relaxed);
+            break;
+        }
+
+        // selection, with virtual loss on the way down
+        path.clear();
+        int32_t node = root;
+        path.push_back(node);
+        arena[node].visits.fetch_add(vl, std::memory_order_relaxed);
+        while (arena[node].state.load(std::memory_order_acquire) == 2) {
+            node = selectChild(node);
+            path.push_back(node);
+            arena[node].visits.fetch_add(vl, std::memory_order_relaxed);
+        }
+
+        // expansion: one new child is played out
+        if (!isTerminalPosition(arena[node].position) && expand(node)) {
+            node = selectChild(node);
+            path.push_back(node);
+            arena[node].visits.fetch_add(vl, std::memory_order_relaxed);
+        }
+
+        int winner = rollout(arena[node].position, stream);
+
+        // backup: remove the virtual loss, add the real result
+        for (int32_t p : path) {
+            MctsNode& pn = arena[p];
+            int mover = 3 - positionInfo(pn.position).toMove;
+            int points = winner == 0 ? 1 : (winner == mover ? 2 : 0);
+            pn.score.fetch_add(points, std::memory_order_relaxed);
+            pn.visits.fetch_add(1 - vl, std::memory_order_relaxed);
+        }
+    }
+}
+
+Move Mcts::getBestMove(TicTacToe& game, int /*player*/) {
+    PROFILE_SCOPE("Mcts::getBestMove");
+    int position = game.positionIndex();
+    unsigned legal = positionInfo(position).legalMoves;
+    if (!legal) {
+        return {-1, -1};
+    }
+
+    int32_t reuse = findReusableRoot(position);
+    if (reuse < 0 || size_t(arenaNext.load()) > cfg.arenaNodes / 2) {
+        root = newRoot(position);
+    } else {
+        root = reuse;
+    }
+
+    using namespace std::chrono;
+    auto start = steady_clock::now();
+    deadline = start + duration_cast<steady_clock::duration>(duration<double>(cfg.seconds));
+    playoutsDone.store(0);
+    stopSearch.store(false);
+
+    std::vector<std::thread> helpers;
+    for (int t = 1; t < cfg.threads; ++t) {
+        helpers.emplace_back(&Mcts::searchThread, this, rng.split());
+    }
+    searchThread(rng.split());
+    for (std::thread& t : helpers) {
+        t.join();
+    }
+    searchSeconds = duration_cast<duration<double>>(steady_clock::now() - start).count();
+    playoutsTotal += playoutsDone.load();
+    secondsTotal += searchSeconds;
+    PROFILE_COUNT("mcts/playouts", playoutsDone.load());
+
+    // most visited move; a random one if the budget never reached a child
+    const MctsNode& r = arena[root];
+    if (r.state.load() != 2) {
+        int a = nthMove(legal, rng.uniformInt(moveCount(legal)));
+        return {a % 3, a / 3};
+    }
+    int32_t first = r.firstChild.load();
+    int32_t best = first;
+    for (int i = 1; i < r.childCount; ++i) {
+        if (arena[first + i].visits.load() > arena[best].visits.load()) {
+            best = first + i;
+        }
+    }
+    int a = arena[best].move;
+    return {a % 3, a / 3};
+}
@@ -0,0 +1,99 @@
+#ifndef MCTS_H
+#define MCTS_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include "tic_tac_toe.h"
+#include "minimax.h"
+#include "player.h"
+#include "rng.h"
+
+// per-move limits and search settings for Mcts
+struct MctsConfig {
+    int threads = 1;
+    long long playouts = 20000;    // per move, 0 = no limit
+    double seconds = 0.0;          // per move, 0 = no limit (one of the two must be set)
+    double exploration = 1.4;      // UCT constant
+    int virtualLoss = 3;           // visits a thread in flight adds to its path
+    size_t arenaNodes = 1 << 20;
+
+    // optional Q policy: its greedy move starts with priorVisits won
+    // visits when a node is expanded, and rollouts play it with
+    // probability rolloutGreedy instead of a random move
+    std::shared_ptr<const PolicyPlayer> policy;
+    int priorVisits = 10;
+    double rolloutGreedy = 0.5;
+};
+
+// reads --mcts-playouts N, --mcts-ms N, --mcts-threads N, --mcts-c X and
+// --mcts-policy file from argv, defaults for the rest
+MctsConfig mctsConfigFromArgs(int argc, char** argv);
+
+// one search node; atomics so threads can share the tree
+struct MctsNode {
+    std::atomic<int32_t> visits;
+    std::atomic<int64_t> score;        // half points for the player who moved here: win 2, draw 1
+    std::atomic<int32_t> firstChild;   // arena index, -1 until expanded
+    std::atomic<uint8_t> state;        // 0 leaf, 1 being expanded, 2 expanded
+    uint8_t childCount;
+    uint8_t move;                      // action that led here
+    uint16_t position;                 // position index
+};
+
+// Monte Carlo tree search over the position table
+//
+// nodes come from one arena allocated up front, children of a node in
+// one contiguous block. the tree is kept between moves: if the new
+// position is a child or grandchild of the last root the search carries
+// on from there, otherwise (or once the arena is half full) it starts
+// over at the front of the arena. nothing is allocated while searching
+//
+// with threads > 1 every thread walks the same tree (tree parallelism);
+// visit counts and scores are atomics, and virtual loss steers threads
+// that are in flight at the same time down different paths
+class Mcts {
+public:
+    explicit Mcts(const MctsConfig& config = MctsConfig());
+
+    Move getBestMove(TicTacToe& game, int player);
+
+    // forget the tree, so the next search starts from nothing
+    void reset() { root = -1; }
+
+    // stats of the last search
+    long long lastPlayouts() const { return playoutsDone.load(); }
+    double lastSeconds() const { return searchSeconds; }
+    size_t nodesUsed() const { return size_t(arenaNext.load()); }
+
+    // totals over every search so far
+    long long totalPlayouts() const { return playoutsTotal; }
+    double totalSeconds() const { return secondsTotal; }
+
+    const MctsConfig& config() const { return cfg; }
+
+private:
+    int32_t newRoot(int position);
+    int32_t findReusableRoot(int position) const;
+    void searchThread(Rng rng);
+    int32_t selectChild(int32_t node) const;
+    bool expand(int32_t node);
+    int rollout(int position, Rng& rng) const;
+
+    MctsConfig cfg;
+    std::unique_ptr<MctsNode[]> arena;
+    std::atomic<int32_t> arenaNext{0};
+    int32_t root = -1;
+    Rng rng;
+
+    std::atomic<long long> playoutsDone{0};
+    std::atomic<bool> stopSearch{false};
+    std::chrono::steady_clock::time_point deadline;
+    double searchSeconds = 0.0;
+    long long playoutsTotal = 0;
+    double secondsTotal = 0.0;
+};
+
+#endif
@@ -2,12 +2,17 @@
 #include <algorithm>
 #include <limits>
 #include <iostream>   
-#include <random>   
-#include <ctime>      
+#include <string>
+#include <cstdlib>
+#include "profiler.h"
+#include "thread_pool.h"
+#include "position_table.h"
+#include "opening_book.h"
 
 
 
 double Minimax::scorePosition(TicTacToe& game, int player) {
+    PROFILE_COUNT("minimax/nodes", 1);
 
     if (game.isGameOver()) {
         int winner = game.checkWin();
@@ -44,30 +49,90 @@ double Minimax::scorePosition(TicTacToe& game, int player) {
 }
 
 Move Minimax::getBestMove(TicTacToe& game, int player) {
-    double bestScore = -1.0; 
-    std::vector<Move> bestMoves;
+    return getBestMove(game, player, rng);
+}
+
+void Minimax::setThreads(int threads) {
+    if (threads > 1) {
+        pool = std::make_shared<ThreadPool>(threads);
+    } else {
+        pool.reset();
+    }
+}
+
+int Minimax::threads() const {
+    return pool ? pool->threads() : 1;
+}
+
+int minimaxThreadsFromArgs(int argc, char** argv) {
+    int threads = 1;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--minimax-threads") {
+            threads = std::max(1, std::atoi(argv[i + 1]));
+        }
+    }
+    return threads;
+}
+
+// below this many root moves the subtrees are too small to be worth
+// handing to other threads
+static const size_t kMinParallelMoves = 6;
 
+std::vector<Move> Minimax::equivalentMoves(TicTacToe& game, int player, bool split,
+                                           double& bestScore) {
+    std::vector<Move> moves;
     for (int x = 0; x < 3; ++x) {
         for (int y = 0; y < 3; ++y) {
             if (game.isValidMove(x, y)) {
-                game.makeMove(x, y, player);
+                moves.push_back({x, y});
+            }
+        }
+    }
 
-                double oppScore = scorePosition(game, otherPlayer(player));
-                double myScore  = 1.0 - oppScore;
+    // each root move is an independent subtree; with a pool, threads
+    // score them on their own copies of the board
+    std::vector<double> scores(moves.size());
+    int opp = otherPlayer(player);
+    if (split && pool && moves.size() >= kMinParallelMoves) {
+        pool->parallelFor(int(moves.size()), [&](int i) {
+            TicTacToe copy = game;
+            copy.makeMove(moves[i].x, moves[i].y, player);
+            scores[i] = 1.0 - scorePosition(copy, opp);
+        });
+    } else {
+        for (size_t i = 0; i < moves.size(); ++i) {
+            game.makeMove(moves[i].x, moves[i].y, player);
+            scores[i] = 1.0 - scorePosition(game, opp);
+            game.undoMove(moves[i].x, moves[i].y);
+        }
+    }
 
-                game.undoMove(x, y);
+    bestScore = -1.0;
+    std::vector<Move> bestMoves;
+    for (size_t i = 0; i < moves.size(); ++i) {
+        double myScore = scores[i];
+        if (myScore > bestScore) {
+            bestScore = myScore;
+            bestMoves.clear();
+            bestMoves.push_back(moves[i]);
+        }
+        else if (myScore == bestScore) {
+            bestMoves.push_back(moves[i]);
+        }
+    }
+    return bestMoves;
+}
 
-                if (myScore > bestScore) {
-                    bestScore = myScore;
-                    bestMoves.clear();
-                    bestMoves.push_back({x, y});
-                }
-                else if (myScore == bestScore) {
-                    bestMoves.push_back({x, y});
-                }
-            }
+Move Minimax::getBestMove(TicTacToe& game, int player, Rng& stream) {
+    PROFILE_SCOPE("Minimax::getBestMove");
+    if (book) {
+        Move m = book->pickMove(game, stream);
+        if (m.x >= 0) {
+            return m;
         }
     }
+    double bestScore;
+    std::vector<Move> bestMoves = equivalentMoves(game, player, true, bestScore);
 
     
     if (printEquivalenceSet) {
@@ -78,14 +143,52 @@ Move Minimax::getBestMove(TicTacToe& game, int player) {
     }
 
     if (s_randomizeEquivalentMoves && bestMoves.size() > 1) {
-        static bool seeded = false;
-        if (!seeded) {
-            std::srand(static_cast<unsigned>(std::time(nullptr)));
-            seeded = true;
-        }
-        int idx = std::rand() % bestMoves.size();
+        int idx = stream.uniformInt(int(bestMoves.size()));
         return bestMoves[idx];
     } else {
         return bestMoves[0];
     }
 }
+
+void Minimax::getBestMoves(const uint16_t* positions, int count, int8_t* actions, Rng& stream) {
+    PROFILE_SCOPE("Minimax::getBestMoves");
+    std::vector<uint16_t> distinct(positions, positions + count);
+    std::sort(distinct.begin(), distinct.end());
+    distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+
+    std::vector<std::vector<Move>> sets(distinct.size());
+    auto search = [&](int d) {
+        int index = distinct[d];
+        TicTacToe game = TicTacToe::fromPositionIndex(index);
+        if (!game.isGameOver() && !(book && book->holds(game))) {
+            double bestScore;
+            sets[d] = equivalentMoves(game, positionInfo(index).toMove, false, bestScore);
+        }
+    };
+    if (pool && distinct.size() > 1) {
+        pool->parallelFor(int(distinct.size()), search);
+    } else {
+        for (size_t d = 0; d < distinct.size(); ++d) search(int(d));
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (book) {
+            int cell = book->pick(TicTacToe::fromPositionIndex(positions[i]), stream);
+            if (cell >= 0) {
+                actions[i] = int8_t(cell);
+                continue;
+            }
+        }
+        size_t d = size_t(std::lower_bound(distinct.begin(), distinct.end(), positions[i]) - distinct.begin());
+        const std::vector<Move>& best = sets[d];
+        if (best.empty()) {
+            actions[i] = -1;
+            continue;
+        }
+        size_t pick = 0;
+        if (s_randomizeEquivalentMoves && best.size() > 1) {
+            pick = size_t(stream.uniformInt(int(best.size())));
+        }
+        actions[i] = int8_t(best[pick].y * 3 + best[pick].x);
+    }
+}
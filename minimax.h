@@ -2,7 +2,13 @@
 #define MINIMAX_H
 
 #include "tic_tac_toe.h"
+#include "rng.h"
 #include <vector>
+#include <memory>
+#include <cstdint>
+
+class ThreadPool;
+class OpeningBook;
 
 struct Move {
     int x;
@@ -31,13 +37,46 @@ static bool printEquivalenceSet = false;
 //
 class Minimax {
 public:
+    // draws tie-breaks from its own stream of the root seed
+    Minimax() : rng(makeStream(nextStreamId())) {}
+
     // returns best move for player, when they are next to move
     Move getBestMove(TicTacToe& game, int player);
 
+    // as above, breaking ties between equivalent moves with stream
+    Move getBestMove(TicTacToe& game, int player, Rng& stream);
+
+    // getBestMove for many boards at once, given as position indices,
+    // each for its side to move: actions[i] is y*3 + x, -1 if there is no
+    // move. each distinct board is searched once (a board per thread with
+    // setThreads) and the ties are broken with draws from stream in board
+    // order, as the same getBestMove calls would draw them
+    void getBestMoves(const uint16_t* positions, int count, int8_t* actions, Rng& stream);
+
+    void setRng(const Rng& r) { rng = r; }
+
+    // positions the book holds are played from it, without a search;
+    // nullptr searches every move
+    void setBook(std::shared_ptr<const OpeningBook> b) { book = std::move(b); }
+    const OpeningBook* openingBook() const { return book.get(); }
+
+    // score root moves on this many threads (root split); the moves are
+    // still compared in scan order, so the equivalence set and the move
+    // drawn from it are the same as with one thread
+    void setThreads(int threads);
+    int threads() const;
+
     // returns current players best guaranteed payoff
     double scorePosition(TicTacToe& game, int player);
 
 private:
+    // minimax's best moves for player, in scan order; root moves are
+    // scored on the pool if split is true and there is one
+    std::vector<Move> equivalentMoves(TicTacToe& game, int player, bool split, double& bestScore);
+
+    Rng rng;
+    std::shared_ptr<ThreadPool> pool;
+    std::shared_ptr<const OpeningBook> book;
 
     // return the other player
     int otherPlayer(int p) {
@@ -45,4 +84,7 @@ private:
     }
 };
 
+// reads --minimax-threads N from argv, 1 if absent
+int minimaxThreadsFromArgs(int argc, char** argv);
+
 #endif
@@ -0,0 +1,246 @@
+#include "opening_book.h"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+static const char kMagic[4] = { 'T', 'T', 'O', 'B' };
+static const uint16_t kVersion = 1;
+static const size_t kHeaderSize = 20;
+
+std::string openingBookFileName(int size, int inRow) {
+    return "book_" + std::to_string(size) + "x" + std::to_string(size)
+         + "_k" + std::to_string(inRow) + ".ttob";
+}
+
+void tttPieces(const TicTacToe& game, uint64_t& pieces1, uint64_t& pieces2) {
+    pieces1 = 0;
+    pieces2 = 0;
+    const Board& board = game.getBoard();
+    for (int y = 0; y < 3; ++y) {
+        for (int x = 0; x < 3; ++x) {
+            if (board[y][x] == 1) pieces1 |= 1ull << (y * 3 + x);
+            else if (board[y][x] == 2) pieces2 |= 1ull << (y * 3 + x);
+        }
+    }
+}
+
+OpeningBook::OpeningBook(int size, int inRow, int plies)
+    : boardSize(size), boardInRow(inRow), bookPlies(plies) {}
+
+void OpeningBook::add(uint64_t pieces1, uint64_t pieces2, int cell, uint32_t weight) {
+    std::vector<std::pair<int, uint64_t>>& list = building[{ pieces1, pieces2 }];
+    for (auto& m : list) {
+        if (m.first == cell) {
+            m.second += weight;
+            return;
+        }
+    }
+    list.push_back({ cell, weight });
+}
+
+void OpeningBook::finish() {
+    // the map is in (pieces1, pieces2) order already
+    for (const auto& kv : building) {
+        uint64_t largest = 0;
+        for (const auto& m : kv.second) largest = std::max(largest, m.second);
+        if (largest == 0) {
+            continue;
+        }
+        BookPosition pos;
+        pos.pieces1 = kv.first.first;
+        pos.pieces2 = kv.first.second;
+        pos.first = uint32_t(moves.size());
+        pos.count = 0;
+        for (const auto& m : kv.second) {
+            if (m.second == 0) continue;
+            // scaled so the largest weight is at most 65535; a move that
+            // was seen keeps a weight of at least 1
+            uint64_t w = largest > 65535 ? std::max<uint64_t>(1, m.second * 65535 / largest) : m.second;
+            moves.push_back({ uint8_t(m.first), 0, uint16_t(w) });
+            pos.count++;
+        }
+        entries.push_back(pos);
+    }
+    building.clear();
+    std::sort(entries.begin(), entries.end(), [](const BookPosition& a, const BookPosition& b) {
+        return a.pieces1 != b.pieces1 ? a.pieces1 < b.pieces1 : a.pieces2 < b.pieces2;
+    });
+}
+
+const BookMove* OpeningBook::find(uint64_t pieces1, uint64_t pieces2, int& count) const {
+    count = 0;
+    auto it = std::lower_bound(entries.begin(), entries.end(), std::make_pair(pieces1, pieces2),
+                               [](const BookPosition& e, const std::pair<uint64_t, uint64_t>& key) {
+        return e.pieces1 != key.first ? e.pieces1 < key.first : e.pieces2 < key.second;
+    });
+    if (it == entries.end() || it->pieces1 != pieces1 || it->pieces2 != pieces2) {
+        return nullptr;
+    }
+    count = int(it->count);
+    return moves.data() + it->first;
+}
+
+int OpeningBook::draw(uint64_t pieces1, uint64_t pieces2, Rng& rng) const {
+    if (__builtin_popcountll(pieces1 | pieces2) >= bookPlies) {
+        return -1;
+    }
+    int count;
+    const BookMove* list = find(pieces1, pieces2, count);
+    if (count == 0) {
+        return -1;
+    }
+    bool equal = true;
+    int total = 0;
+    for (int i = 0; i < count; ++i) {
+        equal = equal && list[i].weight == list[0].weight;
+        total += list[i].weight;
+    }
+    if (count == 1) {
+        return list[0].cell;
+    }
+    if (equal) {
+        return list[rng.uniformInt(count)].cell;
+    }
+    int r = rng.uniformInt(total);
+    for (int i = 0; i < count; ++i) {
+        r -= list[i].weight;
+        if (r < 0) return list[i].cell;
+    }
+    return list[count - 1].cell;
+}
+
+int OpeningBook::pick(const GridGame& game, Rng& rng) const {
+    if (!covers(game) || game.isGameOver()) {
+        return -1;
+    }
+    return draw(game.piecesOf(1), game.piecesOf(2), rng);
+}
+
+bool OpeningBook::holds(const TicTacToe& game) const {
+    if (boardSize != 3 || boardInRow != 3 || game.isGameOver()) {
+        return false;
+    }
+    uint64_t pieces1, pieces2;
+    tttPieces(game, pieces1, pieces2);
+    int count;
+    return __builtin_popcountll(pieces1 | pieces2) < bookPlies && find(pieces1, pieces2, count);
+}
+
+int OpeningBook::pick(const TicTacToe& game, Rng& rng) const {
+    if (boardSize != 3 || boardInRow != 3 || game.isGameOver()) {
+        return -1;
+    }
+    uint64_t pieces1, pieces2;
+    tttPieces(game, pieces1, pieces2);
+    return draw(pieces1, pieces2, rng);
+}
+
+Move OpeningBook::pickMove(const TicTacToe& game, Rng& rng) const {
+    int cell = pick(game, rng);
+    if (cell < 0) {
+        return {-1, -1};
+    }
+    return {cell % 3, cell / 3};
+}
+
+bool OpeningBook::save(const std::string& filename) const {
+    FILE* file = std::fopen(filename.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    uint8_t header[kHeaderSize] = {};
+    uint32_t positionCount = uint32_t(entries.size());
+    uint32_t movesCount = uint32_t(moves.size());
+    std::memcpy(header, kMagic, 4);
+    std::memcpy(header + 4, &kVersion, 2);
+    header[6] = uint8_t(boardSize);
+    header[7] = uint8_t(boardInRow);
+    header[8] = uint8_t(bookPlies);
+    std::memcpy(header + 12, &positionCount, 4);
+    std::memcpy(header + 16, &movesCount, 4);
+    bool ok = std::fwrite(header, 1, kHeaderSize, file) == kHeaderSize
+           && std::fwrite(entries.data(), sizeof(BookPosition), entries.size(), file) == entries.size()
+           && std::fwrite(moves.data(), sizeof(BookMove), moves.size(), file) == moves.size();
+    ok = (std::fclose(file) == 0) && ok;
+    return ok;
+}
+
+bool OpeningBook::load(const std::string& filename, std::string& error) {
+    FILE* file = std::fopen(filename.c_str(), "rb");
+    if (!file) {
+        error = "could not open " + filename;
+        return false;
+    }
+    uint8_t header[kHeaderSize];
+    uint16_t version = 0;
+    uint32_t positionCount = 0;
+    uint32_t movesCount = 0;
+    bool ok = std::fread(header, 1, kHeaderSize, file) == kHeaderSize;
+    if (ok) {
+        std::memcpy(&version, header + 4, 2);
+        std::memcpy(&positionCount, header + 12, 4);
+        std::memcpy(&movesCount, header + 16, 4);
+    }
+    if (!ok || std::memcmp(header, kMagic, 4) != 0 || version != kVersion) {
+        std::fclose(file);
+        error = filename + " is not an opening book";
+        return false;
+    }
+    int size = header[6];
+    int inRow = header[7];
+    // the counts are checked against the file before anything is sized by them
+    std::fseek(file, 0, SEEK_END);
+    long fileSize = std::ftell(file);
+    ok = size >= 1 && size <= GridGame::kMaxSize && inRow >= 1 && inRow <= size
+         && fileSize == long(kHeaderSize + uint64_t(positionCount) * sizeof(BookPosition)
+                             + uint64_t(movesCount) * sizeof(BookMove))
+         && std::fseek(file, long(kHeaderSize), SEEK_SET) == 0;
+    std::vector<BookPosition> readEntries(ok ? positionCount : 0);
+    std::vector<BookMove> readMoves(ok ? movesCount : 0);
+    ok = ok
+         && std::fread(readEntries.data(), sizeof(BookPosition), positionCount, file) == positionCount
+         && std::fread(readMoves.data(), sizeof(BookMove), movesCount, file) == movesCount;
+    std::fclose(file);
+    uint64_t board = (size * size == 64) ? ~0ull : (1ull << (size * size)) - 1;
+    for (size_t i = 0; ok && i < readEntries.size(); ++i) {
+        const BookPosition& e = readEntries[i];
+        uint64_t occupied = e.pieces1 | e.pieces2;
+        ok = uint64_t(e.first) + e.count <= movesCount
+             && (e.pieces1 & e.pieces2) == 0 && (occupied & ~board) == 0
+             && (i == 0 || readEntries[i - 1].pieces1 < e.pieces1
+                 || (readEntries[i - 1].pieces1 == e.pieces1 && readEntries[i - 1].pieces2 < e.pieces2));
+        // every move is to an empty cell of the board
+        for (uint32_t m = 0; ok && m < e.count; ++m) {
+            int cell = readMoves[e.first + m].cell;
+            ok = cell < size * size && !((occupied >> cell) & 1);
+        }
+    }
+    if (!ok) {
+        error = filename + " is truncated or corrupt";
+        return false;
+    }
+    boardSize = size;
+    boardInRow = inRow;
+    bookPlies = header[8];
+    entries.swap(readEntries);
+    moves.swap(readMoves);
+    building.clear();
+    return true;
+}
+
+std::shared_ptr<const OpeningBook> openingBookFromArgs(int argc, char** argv) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) != "--book") {
+            continue;
+        }
+        std::shared_ptr<OpeningBook> book = std::make_shared<OpeningBook>();
+        std::string error;
+        if (!book->load(argv[i + 1], error)) {
+            std::cerr << error << ", playing without a book\n";
+            return nullptr;
+        }
+        return book;
+    }
+    return nullptr;
+}
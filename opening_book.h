@@ -0,0 +1,110 @@
+#ifndef OPENING_BOOK_H
+#define OPENING_BOOK_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include "grid_game.h"
+#include "tic_tac_toe.h"
+#include "minimax.h"
+#include "rng.h"
+
+// moves for the first plies of a game on one board shape, looked up
+// instead of searched: each position the book holds has a list of moves
+// with weights, and a move is drawn in proportion to its weight
+//
+// file:  "TTOB", u16 version, u8 size, u8 inRow, u8 plies, u8 reserved[3],
+//        u32 positions, u32 moves,
+//        then the positions, sorted by (pieces1, pieces2):
+//          u64 pieces1, u64 pieces2, u32 first move, u32 move count
+//        then the moves: u8 cell, u8 reserved, u16 weight
+//
+// pieces are cell masks, cell (x, y) is bit y*size + x as in GridGame.
+// moves keep the order they were added in; when the weights of a
+// position are all equal the draw is uniformInt(count) over that order,
+// the same draw Minimax makes from its equivalence set, so a book built
+// from minimax plays exactly the games the search would
+
+struct BookMove {
+    uint8_t cell;
+    uint8_t reserved;
+    uint16_t weight;
+};
+
+struct BookPosition {
+    uint64_t pieces1;
+    uint64_t pieces2;
+    uint32_t first;        // into the moves
+    uint32_t count;
+};
+
+static_assert(sizeof(BookMove) == 4, "BookMove is 4 bytes in the file");
+static_assert(sizeof(BookPosition) == 24, "BookPosition is 24 bytes in the file");
+
+// "book_3x3_k3.ttob"
+std::string openingBookFileName(int size, int inRow);
+
+class OpeningBook {
+public:
+    OpeningBook(int size = 3, int inRow = 3, int plies = 2);
+
+    int size() const { return boardSize; }
+    int inRow() const { return boardInRow; }
+    int plies() const { return bookPlies; }
+    size_t positions() const { return entries.size(); }
+    size_t moveCount() const { return moves.size(); }
+
+    // adds weight to cell at the position; counts that outgrow 16 bits
+    // are scaled down, per position, when the book is finished
+    void add(uint64_t pieces1, uint64_t pieces2, int cell, uint32_t weight);
+
+    // sorts the positions for lookup; call after the last add
+    void finish();
+
+    // true if game is the board shape this book is for
+    bool covers(const GridGame& game) const {
+        return game.size() == boardSize && game.inRow() == boardInRow;
+    }
+
+    // the moves held for a position, nullptr (count 0) if there are none
+    const BookMove* find(uint64_t pieces1, uint64_t pieces2, int& count) const;
+
+    // true if pick would find moves for the position
+    bool holds(const TicTacToe& game) const;
+
+    // a move drawn from the book for the player to move, -1 if the book
+    // does not hold the position or is for another board shape
+    int pick(const GridGame& game, Rng& rng) const;
+    int pick(const TicTacToe& game, Rng& rng) const;
+
+    // same, as a 3x3 move; {-1, -1} if the book has nothing
+    Move pickMove(const TicTacToe& game, Rng& rng) const;
+
+    bool save(const std::string& filename) const;
+
+    // false, with the reason in error, unless filename is a whole book
+    // whose moves are all to empty cells of their positions
+    bool load(const std::string& filename, std::string& error);
+
+private:
+    int draw(uint64_t pieces1, uint64_t pieces2, Rng& rng) const;
+
+    int boardSize;
+    int boardInRow;
+    int bookPlies;
+    std::vector<BookPosition> entries;
+    std::vector<BookMove> moves;
+    // while building: weights per position, in the order cells were added
+    std::map<std::pair<uint64_t, uint64_t>, std::vector<std::pair<int, uint64_t>>> building;
+};
+
+// piece masks of a 3x3 game
+void tttPieces(const TicTacToe& game, uint64_t& pieces1, uint64_t& pieces2);
+
+// reads --book file from argv; nullptr (with a message if the file is
+// bad) when there is none
+std::shared_ptr<const OpeningBook> openingBookFromArgs(int argc, char** argv);
+
+#endif
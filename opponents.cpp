@@ -1,24 +1,14 @@
 #include "opponents.h"
+#include "position_table.h"
+#include "profiler.h"
+#include "simd_kernels.h"
 #include <vector>
-#include <cstdlib>   
-#include <ctime>
 #include <algorithm>
 #include <iostream>
 
-static bool g_seeded = false;
-static void seedRandomOnce()
+Move getRandomMove(TicTacToe& game, int player, Rng& rng)
 {
-    if (!g_seeded) {
-
-        std::srand(123456);
-        g_seeded = true;
-    }
-}
-
-Move getRandomMove(TicTacToe& game, int player)
-{
-    seedRandomOnce();
-
+    PROFILE_SCOPE("getRandomMove");
     std::vector<Move> validMoves;
     for (int x = 0; x < 3; x++) {
         for (int y = 0; y < 3; y++) {
@@ -31,7 +21,7 @@ Move getRandomMove(TicTacToe& game, int player)
         return {-1, -1}; 
     }
 
-    int idx = std::rand() % validMoves.size();
+    int idx = rng.uniformInt(int(validMoves.size()));
     return validMoves[idx];
 }
 
@@ -45,37 +35,168 @@ static bool isSpecialBoard(const Board& board, int player)
     return false;
 }
 
-Move getBuggyMinimaxMove(TicTacToe& game, Minimax& mm, int player)
+static bool isSpecialBoard2(const Board& board, int player)
 {
-    if (isSpecialBoard(game.getBoard(), player)) {
 
-        if (game.isValidMove(0,0)) {
-            return {0, 0};
-        } else if (game.isValidMove(1,1)) {
-            return {1,1};
+    int other = (player == 1) ? 2 : 1;
+    if (board[2][0] == other && board[2][1] == 0 && board[2][2] == other
+        && board[1][1] == player) {
+        return true;
+    }
+    return false;
+}
+
+// minimax payoff for the side to move, in half points (0 loss, 1 draw, 2 win),
+// memoised over position indices - same values as Minimax::scorePosition
+static int solvePosition(int index, std::vector<int8_t>& memo)
+{
+    if (memo[index] >= 0) {
+        return memo[index];
+    }
+    const PositionInfo& info = positionInfo(index);
+    int value;
+    if (info.flags & kPosTerminal) {
+        value = (info.winner == 0) ? 1 : (info.winner == info.toMove ? 2 : 0);
+    } else {
+        value = 0;
+        for (int a = 0; a < 9; ++a) {
+            if ((info.legalMoves >> a) & 1) {
+                int child = index + info.toMove * kPow3[a];
+                value = std::max(value, 2 - solvePosition(child, memo));
+            }
         }
-        return getRandomMove(game, player);
     }
-    return mm.getBestMove(game, player);
+    memo[index] = int8_t(value);
+    return value;
 }
 
+// actions minimax's getBestMove can return from a position
+static uint16_t minimaxResponses(int index, std::vector<int8_t>& memo)
+{
+    const PositionInfo& info = positionInfo(index);
+    int best = -1;
+    uint16_t mask = 0;
+    // getBestMove scans x then y, so with randomisation off the first
+    // best move is the lowest x, then lowest y
+    for (int x = 0; x < 3; ++x) {
+        for (int y = 0; y < 3; ++y) {
+            int a = y * 3 + x;
+            if (!((info.legalMoves >> a) & 1)) continue;
+            int v = 2 - solvePosition(index + info.toMove * kPow3[a], memo);
+            if (v > best) {
+                best = v;
+                mask = uint16_t(1u << a);
+            } else if (v == best && s_randomizeEquivalentMoves) {
+                mask |= uint16_t(1u << a);
+            }
+        }
+    }
+    return mask;
+}
 
-static bool isSpecialBoard2(const Board& board, int player)
+OpponentTable OpponentTable::compile(const std::vector<OpponentRule>& rules,
+                                     OpponentFallback fallback)
 {
+    PROFILE_SCOPE("OpponentTable::compile");
+    OpponentTable result;
+    result.table.assign(kNumPositions, 0);
+    std::vector<int8_t> memo(kNumPositions, -1);
 
-    int other = (player == 1) ? 2 : 1;
-    if (board[2][0] == other && board[2][1] == 0 && board[2][2] == other
-        && board[1][1] == player) {
-        return true;
+    for (int index = 0; index < kNumPositions; ++index) {
+        const PositionInfo& info = positionInfo(index);
+        if (info.legalMoves == 0) {
+            continue;
+        }
+        TicTacToe game = TicTacToe::fromPositionIndex(index);
+
+        const OpponentRule* rule = nullptr;
+        for (const OpponentRule& r : rules) {
+            if (r.matches(game.getBoard(), info.toMove)) {
+                rule = &r;
+                break;
+            }
+        }
+
+        uint16_t mask = 0;
+        if (rule) {
+            for (const Move& m : rule->preferred) {
+                if (game.isValidMove(m.x, m.y)) {
+                    mask = uint16_t(1u << (m.y * 3 + m.x));
+                    break;
+                }
+            }
+            if (mask == 0) {
+                mask = info.legalMoves;
+            }
+        } else if (fallback == OpponentFallback::Minimax) {
+            mask = minimaxResponses(index, memo);
+        } else {
+            mask = info.legalMoves;
+        }
+        result.table[index] = mask;
     }
-    return false;
+    return result;
 }
 
-Move getBuggyMinimaxMove2(TicTacToe& game, Minimax& mm, int player)
+Move OpponentTable::sample(const TicTacToe& game, Rng& rng) const
 {
-    if (isSpecialBoard2(game.getBoard(), player)) {
-        // std::cout << "buggy2 special case triggered\n";
-        return getRandomMove(game, player);
+    PROFILE_SCOPE("OpponentTable::sample");
+    uint16_t mask = table[game.positionIndex()];
+    if (mask == 0) {
+        return {-1, -1};
     }
-    return mm.getBestMove(game, player);
+    int action = nthMove(mask, rng.uniformInt(moveCount(mask)));
+    return {action % 3, action / 3};
+}
+
+void OpponentTable::sampleMany(const uint16_t* positions, int count, int8_t* actions,
+                               Rng& rng) const
+{
+    PROFILE_SCOPE("OpponentTable::sampleMany");
+    for (int i = 0; i < count; ++i) {
+        if (i + kPrefetchAhead < count) {
+            prefetchRead(&table[positions[i + kPrefetchAhead]]);
+        }
+        uint16_t mask = table[positions[i]];
+        actions[i] = int8_t(mask ? nthMove(mask, rng.uniformInt(moveCount(mask))) : -1);
+    }
+}
+
+const OpponentTable& minimaxTable()
+{
+    static const OpponentTable table = OpponentTable::compile({}, OpponentFallback::Minimax);
+    return table;
+}
+
+const OpponentTable& randomTable()
+{
+    static const OpponentTable table = OpponentTable::compile({}, OpponentFallback::Random);
+    return table;
+}
+
+const OpponentTable& buggyMinimaxTable()
+{
+    // on the special board, take (0, 0) or the centre instead of blocking
+    static const OpponentTable table = OpponentTable::compile(
+        { { isSpecialBoard, { {0, 0}, {1, 1} } } },
+        OpponentFallback::Minimax);
+    return table;
+}
+
+const OpponentTable& buggyMinimax2Table()
+{
+    static const OpponentTable table = OpponentTable::compile(
+        { { isSpecialBoard2, {} } },
+        OpponentFallback::Minimax);
+    return table;
+}
+
+Move getBuggyMinimaxMove(TicTacToe& game, int /*player*/, Rng& rng)
+{
+    return buggyMinimaxTable().sample(game, rng);
+}
+
+Move getBuggyMinimaxMove2(TicTacToe& game, int /*player*/, Rng& rng)
+{
+    return buggyMinimax2Table().sample(game, rng);
 }
@@ -1,13 +1,63 @@
 #ifndef OPPONENTS_H
 #define OPPONENTS_H
 
+#include <cstdint>
+#include <vector>
 #include "tic_tac_toe.h"
 #include "minimax.h"
+#include "rng.h"
 
-Move getRandomMove(TicTacToe& game, int player);
+// scripted opponent rule: when matches(board, player) holds for the player
+// to move, play the first valid move in preferred, or a uniformly random
+// move if none of them is valid (an empty list means "play randomly")
+struct OpponentRule {
+    bool (*matches)(const Board& board, int player);
+    std::vector<Move> preferred;
+};
 
-Move getBuggyMinimaxMove(TicTacToe& game, Minimax& mm, int player);
+// what a scripted opponent does when none of its rules match
+enum class OpponentFallback {
+    Minimax, // any move from minimax's equivalence class of best moves
+    Random   // any valid move
+};
 
-Move getBuggyMinimaxMove2(TicTacToe& game, Minimax& mm, int player);
+// an opponent compiled to one move distribution per position index:
+// a mask of equally likely actions, so picking a move is a table lookup
+class OpponentTable {
+public:
+    // rules are tried in order, first match wins
+    static OpponentTable compile(const std::vector<OpponentRule>& rules,
+                                 OpponentFallback fallback);
+
+    // uniform draw from the responses for the current board, {-1, -1} if none;
+    // the table is read-only, so threads can share it with their own rng
+    Move sample(const TicTacToe& game, Rng& rng) const;
+
+    // sample for many boards at once, given as position indices: actions[i]
+    // (y*3 + x, -1 if none) is what sample would give for positions[i],
+    // with the same draws from rng in the same order
+    void sampleMany(const uint16_t* positions, int count, int8_t* actions, Rng& rng) const;
+
+    // bit a set if action a is one of the responses at a position index
+    uint16_t responses(int index) const { return table[index]; }
+
+private:
+    std::vector<uint16_t> table;
+};
+
+Move getRandomMove(TicTacToe& game, int player, Rng& rng);
+
+// perfect minimax (any move of its equivalence class) and uniformly
+// random players as response tables, for exact evaluation
+const OpponentTable& minimaxTable();
+const OpponentTable& randomTable();
+
+// buggy minimax opponents, compiled into response tables on first use
+const OpponentTable& buggyMinimaxTable();
+const OpponentTable& buggyMinimax2Table();
+
+Move getBuggyMinimaxMove(TicTacToe& game, int player, Rng& rng);
+
+Move getBuggyMinimaxMove2(TicTacToe& game, int player, Rng& rng);
 
 #endif
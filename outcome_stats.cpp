@@ -0,0 +1,80 @@
+#include "outcome_stats.h"
+#include <cstdio>
+
+static const char* kLineNames[8] = {
+    "row y=0", "row y=1", "row y=2",
+    "column x=0", "column x=1", "column x=2",
+    "diagonal (0,0)-(2,2)", "diagonal (0,2)-(2,0)"
+};
+
+void OutcomeStats::merge(const OutcomeStats& other) {
+    for (int i = 0; i < kNumPositions; ++i) {
+        endings[i] += other.endings[i];
+    }
+    for (int w = 0; w < 3; ++w) {
+        results[w] += other.results[w];
+    }
+    for (int n = 0; n < 10; ++n) {
+        lengths[n] += other.lengths[n];
+    }
+    for (int a = 0; a < 9; ++a) {
+        for (int w = 0; w < 3; ++w) {
+            openings[a][w] += other.openings[a][w];
+        }
+    }
+}
+
+int OutcomeStats::uniqueEndings() const {
+    int unique = 0;
+    for (uint64_t n : endings) {
+        unique += (n != 0);
+    }
+    return unique;
+}
+
+void OutcomeStats::print(std::ostream& out) const {
+    long long total = games();
+    if (total == 0) {
+        return;
+    }
+    char line[128];
+
+    out << "\nGame length (moves):\n";
+    for (int n = 0; n <= 9; ++n) {
+        if (lengths[n]) {
+            std::snprintf(line, sizeof(line), "  %d: %lld (%.1f%%)\n",
+                          n, lengths[n], 100.0 * double(lengths[n]) / double(total));
+            out << line;
+        }
+    }
+
+    // derived from the endings: a board that completes two lines at
+    // once counts for both
+    long long byLine[3][8] = { { 0 } };
+    for (int i = 0; i < kNumPositions; ++i) {
+        if (!endings[i]) continue;
+        int winner = positionInfo(i).winner;
+        int lines = completedLines(i);
+        for (int l = 0; l < 8; ++l) {
+            if ((lines >> l) & 1) {
+                byLine[winner][l] += (long long)endings[i];
+            }
+        }
+    }
+    out << "\nWinning line: player1 wins / player2 wins\n";
+    for (int l = 0; l < 8; ++l) {
+        std::snprintf(line, sizeof(line), "  %-22s %lld / %lld\n",
+                      kLineNames[l], byLine[1][l], byLine[2][l]);
+        out << line;
+    }
+
+    out << "\nOpening move (x,y): games, player1 wins / draws / player2 wins\n";
+    for (int a = 0; a < 9; ++a) {
+        long long n = openings[a][0] + openings[a][1] + openings[a][2];
+        if (n) {
+            std::snprintf(line, sizeof(line), "  (%d,%d): %lld, %lld / %lld / %lld\n",
+                          a % 3, a / 3, n, openings[a][1], openings[a][0], openings[a][2]);
+            out << line;
+        }
+    }
+}
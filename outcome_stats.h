@@ -0,0 +1,52 @@
+#ifndef OUTCOME_STATS_H
+#define OUTCOME_STATS_H
+
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include "position_table.h"
+
+// per-game bookkeeping for matchups: how games ended and how long they
+// took, keyed on position indices so recording a game is a few array
+// increments with no allocation
+//
+// one collector per thread; merge() them when the threads are done
+class OutcomeStats {
+public:
+    OutcomeStats() : endings(kNumPositions, 0) {}
+
+    // finalPosition: index of the last board, moves: moves played,
+    // firstMove: action index of the opening move, -1 if none
+    void add(int finalPosition, int moves, int firstMove) {
+        int winner = positionInfo(finalPosition).winner;
+        endings[finalPosition]++;
+        results[winner]++;
+        lengths[moves]++;
+        if (firstMove >= 0) {
+            openings[firstMove][winner]++;
+        }
+    }
+
+    void merge(const OutcomeStats& other);
+
+    long long games() const { return results[0] + results[1] + results[2]; }
+    long long wins(int player) const { return results[player]; }
+    long long draws() const { return results[0]; }
+
+    // distinct final boards
+    int uniqueEndings() const;
+
+    // games that ended on position index
+    uint64_t endingCount(int index) const { return endings[index]; }
+
+    // game length, winning line and opening move breakdowns
+    void print(std::ostream& out) const;
+
+private:
+    std::vector<uint64_t> endings;
+    long long results[3] = { 0, 0, 0 };      // by winner, 0 = draw
+    long long lengths[10] = { 0 };
+    long long openings[9][3] = { { 0 } };    // by first move, then winner
+};
+
+#endif
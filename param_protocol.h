@@ -0,0 +1,43 @@
+#ifndef PARAM_PROTOCOL_H
+#define PARAM_PROTOCOL_H
+
+#include <cstdint>
+#include "qlearning.h"
+
+// wire format between the train_distributed parameter server and its
+// workers: a ParamHeader, then bytes of payload; host byte order, like
+// policy_protocol.h. sockets are made with listenOn / connectTo from there
+//
+//   worker -> server   kParamHello    u32 worker id
+//                      kParamDeltas   u32 episodes played since the last
+//                                     push, then QDelta records
+//                      kParamDone     u32 episodes played in all, after
+//                                     the last kParamDeltas
+//   server -> worker   kParamRows     u32 table version, then ParamRow
+//                                     records for rows changed since the
+//                                     last version sent to this worker
+
+constexpr uint32_t kParamHello = 1;
+constexpr uint32_t kParamDeltas = 2;
+constexpr uint32_t kParamDone = 3;
+constexpr uint32_t kParamRows = 4;
+
+struct ParamHeader {
+    uint32_t type;
+    uint32_t bytes;        // payload after the header
+};
+
+// one Q-table row as the server holds it
+struct ParamRow {
+    uint16_t state;        // position index
+    uint16_t reserved[3];
+    double q[9];
+};
+
+static_assert(sizeof(QDelta) == 8, "QDelta is 8 bytes on the wire");
+static_assert(sizeof(ParamHeader) == 8, "ParamHeader is 8 bytes on the wire");
+static_assert(sizeof(ParamRow) == 80, "ParamRow is 80 bytes on the wire");
+
+const char* const kDefaultParamAddress = "ttt_params.sock";
+
+#endif
@@ -0,0 +1,124 @@
+#include "player.h"
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include "position_table.h"
+#include "policy_analysis.h"
+#include "simd_kernels.h"
+
+void Player::moves(const uint16_t* positions, int count, int8_t* actions, Rng& rng) const {
+    for (int i = 0; i < count; ++i) {
+        TicTacToe game = TicTacToe::fromPositionIndex(positions[i]);
+        Move m = move(game, positionInfo(positions[i]).toMove, rng);
+        actions[i] = int8_t((m.x < 0 || m.y < 0) ? -1 : m.y * 3 + m.x);
+    }
+}
+
+Move TablePlayer::move(const TicTacToe& game, int /*player*/, Rng& rng) const {
+    return table.sample(game, rng);
+}
+
+void TablePlayer::moves(const uint16_t* positions, int count, int8_t* actions, Rng& rng) const {
+    table.sampleMany(positions, count, actions, rng);
+}
+
+Move BookPlayer::move(const TicTacToe& game, int player, Rng& rng) const {
+    Move m = book->pickMove(game, rng);
+    return m.x >= 0 ? m : inner->move(game, player, rng);
+}
+
+// book draws first, in board order, then one call to the inner player
+// for every board the book did not hold
+void BookPlayer::moves(const uint16_t* positions, int count, int8_t* actions, Rng& rng) const {
+    std::vector<uint16_t> rest;
+    std::vector<int> restAt;
+    for (int i = 0; i < count; ++i) {
+        actions[i] = int8_t(book->pick(TicTacToe::fromPositionIndex(positions[i]), rng));
+        if (actions[i] < 0) {
+            rest.push_back(positions[i]);
+            restAt.push_back(i);
+        }
+    }
+    if (rest.empty()) {
+        return;
+    }
+    std::vector<int8_t> restActions(rest.size());
+    inner->moves(rest.data(), int(rest.size()), restActions.data(), rng);
+    for (size_t k = 0; k < rest.size(); ++k) {
+        actions[restAt[k]] = restActions[k];
+    }
+}
+
+bool PolicyPlayer::load(const std::string& filename) {
+    std::vector<PolicyEntry> entries;
+    if (!readPolicyEntries(filename, entries)) {
+        return false;
+    }
+    assign(entries);
+    return true;
+}
+
+void PolicyPlayer::assign(const std::vector<PolicyEntry>& entries) {
+    greedy = greedyPolicy(entries);
+    loadedStates = entries.size();
+}
+
+Move PolicyPlayer::move(const TicTacToe& game, int /*player*/, Rng& /*rng*/) const {
+    int action = greedy[game.positionIndex()];
+    if (action < 0) {
+        return {-1, -1};
+    }
+    return {action % 3, action / 3};
+}
+
+void PolicyPlayer::moves(const uint16_t* positions, int count, int8_t* actions, Rng& /*rng*/) const {
+    for (int i = 0; i < count; ++i) {
+        if (i + kPrefetchAhead < count) {
+            prefetchRead(&greedy[positions[i + kPrefetchAhead]]);
+        }
+        actions[i] = greedy[positions[i]];
+    }
+}
+
+static bool addPolicy(const std::string& filename, std::vector<std::unique_ptr<Player>>& players) {
+    std::unique_ptr<PolicyPlayer> p(new PolicyPlayer(filename));
+    if (!p->load(filename)) {
+        std::cerr << "could not read policy " << filename << "\n";
+        return false;
+    }
+    players.push_back(std::move(p));
+    return true;
+}
+
+bool makePlayers(const std::string& spec, std::vector<std::unique_ptr<Player>>& players) {
+    if (spec == "minimax") {
+        players.emplace_back(new TablePlayer(spec, minimaxTable()));
+    } else if (spec == "random") {
+        players.emplace_back(new TablePlayer(spec, randomTable()));
+    } else if (spec == "buggy") {
+        players.emplace_back(new TablePlayer(spec, buggyMinimaxTable()));
+    } else if (spec == "buggy2") {
+        players.emplace_back(new TablePlayer(spec, buggyMinimax2Table()));
+    } else if (std::filesystem::is_directory(spec)) {
+        // sorted, so a directory gives the same participants in the same order
+        std::vector<std::string> files;
+        for (const auto& entry : std::filesystem::directory_iterator(spec)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".dat") {
+                files.push_back(entry.path().generic_string());
+            }
+        }
+        std::sort(files.begin(), files.end());
+        if (files.empty()) {
+            std::cerr << "no .dat files in " << spec << "\n";
+            return false;
+        }
+        for (const std::string& f : files) {
+            if (!addPolicy(f, players)) {
+                return false;
+            }
+        }
+    } else {
+        return addPolicy(spec, players);
+    }
+    return true;
+}
@@ -0,0 +1,94 @@
+#ifndef PLAYER_H
+#define PLAYER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "tic_tac_toe.h"
+#include "opponents.h"
+#include "qlearning.h"
+#include "opening_book.h"
+#include "rng.h"
+
+// a participant that can be shared between threads: move() only reads
+// the player, all randomness comes from the caller's rng
+class Player {
+public:
+    explicit Player(const std::string& name) : playerName(name) {}
+    virtual ~Player() {}
+
+    // the move to make on game as player (1 or 2), {-1, -1} if none
+    virtual Move move(const TicTacToe& game, int player, Rng& rng) const = 0;
+
+    // moves for many games at once, each board given as its position
+    // index (the side to move comes from the board): actions[i] is y*3 + x,
+    // -1 if there is none. the default asks move() for each in turn
+    virtual void moves(const uint16_t* positions, int count, int8_t* actions, Rng& rng) const;
+
+    const std::string& name() const { return playerName; }
+
+private:
+    std::string playerName;
+};
+
+// minimax, random and the buggy opponents, as compiled response tables
+class TablePlayer : public Player {
+public:
+    TablePlayer(const std::string& name, const OpponentTable& table)
+        : Player(name), table(table) {}
+
+    Move move(const TicTacToe& game, int player, Rng& rng) const override;
+    void moves(const uint16_t* positions, int count, int8_t* actions, Rng& rng) const override;
+
+private:
+    const OpponentTable& table;
+};
+
+// a Q policy playing greedily (epsilon 0), reduced to one action per
+// position index when it is loaded
+class PolicyPlayer : public Player {
+public:
+    explicit PolicyPlayer(const std::string& name) : Player(name) {}
+
+    // false if filename could not be read
+    bool load(const std::string& filename);
+
+    // the greedy moves of a table already in memory
+    void assign(const std::vector<PolicyEntry>& entries);
+
+    Move move(const TicTacToe& game, int player, Rng& rng) const override;
+    void moves(const uint16_t* positions, int count, int8_t* actions, Rng& rng) const override;
+
+    size_t states() const { return loadedStates; }
+
+    // greedy action at a position index, -1 if it has no legal move
+    int greedyMove(int index) const { return greedy[index]; }
+
+private:
+    std::vector<int8_t> greedy;
+    size_t loadedStates = 0;
+};
+
+// another player with an opening book in front: positions the book
+// holds are played from it, the rest are passed on. keeps the inner
+// player's name
+class BookPlayer : public Player {
+public:
+    BookPlayer(std::unique_ptr<Player> player, std::shared_ptr<const OpeningBook> openings)
+        : Player(player->name()), inner(std::move(player)), book(std::move(openings)) {}
+
+    Move move(const TicTacToe& game, int player, Rng& rng) const override;
+    void moves(const uint16_t* positions, int count, int8_t* actions, Rng& rng) const override;
+
+private:
+    std::unique_ptr<Player> inner;
+    std::shared_ptr<const OpeningBook> book;
+};
+
+// "minimax", "random", "buggy", "buggy2" or a .dat file; a directory adds
+// every .dat file in it. appends to players and returns false (with a
+// message) if spec names nothing usable
+bool makePlayers(const std::string& spec, std::vector<std::unique_ptr<Player>>& players);
+
+#endif
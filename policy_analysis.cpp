@@ -0,0 +1,315 @@
+#include "policy_analysis.h"
+#include <iostream>
+#include <fstream>
+#include <unordered_map>
+#include <array>
+#include <limits>
+#include <cmath>
+#include "position_table.h"
+
+// Minimax::scorePosition(game, player) without the search: same rules,
+// memoised per (index, player). player need not be the side to move -
+// analyze_policy scores positions from the point of view of the player
+// who has just moved - so every empty cell is tried, as scorePosition does
+static double scoreFrom(int index, int player, std::vector<double>& memo) {
+    double& slot = memo[index * 2 + (player - 1)];
+    if (!std::isnan(slot)) {
+        return slot;
+    }
+    const PositionInfo& info = positionInfo(index);
+    double score;
+    if (info.flags & kPosTerminal) {
+        score = (info.winner == player) ? 1.0 : (info.winner == 0) ? 0.5 : 0.0;
+    } else {
+        int opp = (player == 1) ? 2 : 1;
+        double bestOtherPayoff = std::numeric_limits<double>::infinity();
+        bool anyMoves = false;
+        for (int c = 0; c < 9; ++c) {
+            if ((index / kPow3[c]) % 3 == 0) {
+                anyMoves = true;
+                bestOtherPayoff = std::min(bestOtherPayoff,
+                                           scoreFrom(index + player * kPow3[c], opp, memo));
+            }
+        }
+        score = anyMoves ? 1.0 - bestOtherPayoff : 0.5;
+    }
+    slot = score;
+    return score;
+}
+
+static const std::vector<double>& scoreTable() {
+    static const std::vector<double> table = [] {
+        std::vector<double> memo(kNumPositions * 2, std::numeric_limits<double>::quiet_NaN());
+        for (int index = 0; index < kNumPositions; ++index) {
+            scoreFrom(index, 1, memo);
+            scoreFrom(index, 2, memo);
+        }
+        return memo;
+    }();
+    return table;
+}
+
+double minimaxScore(int index, int player) {
+    return scoreTable()[index * 2 + (player - 1)];
+}
+
+uint16_t optimalMoves(int index) {
+    const PositionInfo& info = positionInfo(index);
+    int opp = (info.toMove == 1) ? 2 : 1;
+    double bestScore = -1.0;
+    uint16_t mask = 0;
+    for (int a = 0; a < 9; ++a) {
+        if (!((info.legalMoves >> a) & 1)) continue;
+        double myScore = 1.0 - minimaxScore(index + info.toMove * kPow3[a], opp);
+        if (myScore > bestScore) {
+            bestScore = myScore;
+            mask = uint16_t(1u << a);
+        } else if (std::fabs(myScore - bestScore) < 1e-12) {
+            mask |= uint16_t(1u << a);
+        }
+    }
+    return mask;
+}
+
+bool readPolicyEntries(const std::string& filename, std::vector<PolicyEntry>& entries) {
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in) {
+        return false;
+    }
+
+    std::unordered_map<std::string, std::array<double, 9>> Q;
+    uint64_t size = 0;
+    in.read(reinterpret_cast<char*>(&size), sizeof(size));
+    for (uint64_t i = 0; i < size; i++) {
+        uint64_t len = 0;
+        in.read(reinterpret_cast<char*>(&len), sizeof(len));
+        std::string state(len, '\0');
+        in.read(&state[0], len);
+
+        std::array<double, 9> qvals;
+        in.read(reinterpret_cast<char*>(qvals.data()), 9 * sizeof(double));
+
+        Q[state] = qvals;
+    }
+
+    entries.clear();
+    entries.reserve(Q.size());
+    for (auto& kv : Q) {
+        if (kv.first.size() != 9) {
+            continue;
+        }
+        PolicyEntry e;
+        kv.first.copy(e.state, 9);
+        e.qvals = kv.second;
+        entries.push_back(e);
+    }
+    return true;
+}
+
+bool readCompletePolicy(const std::string& filename, std::vector<PolicyEntry>& entries,
+                        std::string& error) {
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in) {
+        error = "could not open";
+        return false;
+    }
+    in.seekg(0, std::ios::end);
+    uint64_t fileSize = uint64_t(in.tellg());
+    in.seekg(0, std::ios::beg);
+
+    // every row of a savePolicy file has the same size
+    const uint64_t rowBytes = sizeof(uint64_t) + 9 + 9 * sizeof(double);
+    uint64_t size = 0;
+    if (!in.read(reinterpret_cast<char*>(&size), sizeof(size)) ||
+        size > fileSize / rowBytes || fileSize != sizeof(size) + size * rowBytes) {
+        error = "truncated or not a policy file";
+        return false;
+    }
+
+    std::unordered_map<std::string, std::array<double, 9>> Q;
+    for (uint64_t i = 0; i < size; i++) {
+        uint64_t len = 0;
+        std::string state(9, '\0');
+        std::array<double, 9> qvals;
+        in.read(reinterpret_cast<char*>(&len), sizeof(len));
+        if (len != 9) {
+            error = "row " + std::to_string(i) + " is not a 3x3 board";
+            return false;
+        }
+        in.read(&state[0], 9);
+        in.read(reinterpret_cast<char*>(qvals.data()), 9 * sizeof(double));
+        if (!in) {
+            error = "truncated at row " + std::to_string(i);
+            return false;
+        }
+        if (positionIndexFromString(state) < 0) {
+            error = "row " + std::to_string(i) + " has a malformed board";
+            return false;
+        }
+        for (double q : qvals) {
+            if (!std::isfinite(q)) {
+                error = "row " + std::to_string(i) + " has a value that is not finite";
+                return false;
+            }
+        }
+        Q[state] = qvals;
+    }
+
+    entries.clear();
+    entries.reserve(Q.size());
+    for (auto& kv : Q) {
+        PolicyEntry e;
+        kv.first.copy(e.state, 9);
+        e.qvals = kv.second;
+        entries.push_back(e);
+    }
+    return true;
+}
+
+// the move chooseAction makes with epsilon 0: first legal action with
+// the highest value, -1 if there are none
+static int greedyAction(const std::array<double, 9>& qvals, unsigned legal) {
+    double bestQVal = -std::numeric_limits<double>::infinity();
+    int bestAction = -1;
+    for (int a = 0; a < 9; a++) {
+        if (((legal >> a) & 1) && qvals[a] > bestQVal) {
+            bestQVal = qvals[a];
+            bestAction = a;
+        }
+    }
+    return bestAction;
+}
+
+// the move of a mask that a scan over x, then y, meets first
+static int firstScannedMove(uint16_t mask) {
+    for (int x = 0; x < 3; ++x) {
+        for (int y = 0; y < 3; ++y) {
+            if ((mask >> (y * 3 + x)) & 1) {
+                return y * 3 + x;
+            }
+        }
+    }
+    return -1;
+}
+
+PolicyAgreement analyzePolicyEntries(const std::vector<PolicyEntry>& entries) {
+    PolicyAgreement result;
+    result.loadedStates = entries.size();
+
+    for (const PolicyEntry& e : entries) {
+        // legality, side to move and legal moves all come from the table
+        int index = positionIndexFromString(std::string(e.state, 9));
+        if (index < 0 || !isPlayablePosition(index)) {
+            continue;
+        }
+        const PositionInfo& info = positionInfo(index);
+        int nextPlayer = info.toMove;
+
+        int bestAction = greedyAction(e.qvals, info.legalMoves);
+        if (bestAction < 0) {
+            continue;
+        }
+
+        uint16_t mmMoves = optimalMoves(index);
+        result.totalStates++;
+
+        if ((mmMoves >> bestAction) & 1) {
+            result.matchCount++;
+        } else {
+            result.mismatchCount++;
+
+            // both payoffs scored as nextPlayer, as the original analysis did
+            double qPayoff = minimaxScore(index + nextPlayer * kPow3[bestAction], nextPlayer);
+            int mmRep = firstScannedMove(mmMoves);
+            double mmPayoff = minimaxScore(index + nextPlayer * kPow3[mmRep], nextPlayer);
+
+            double diff = qPayoff - mmPayoff;
+            result.sumDiff    += diff;
+            result.sumAbsDiff += std::fabs(diff);
+        }
+    }
+    return result;
+}
+
+bool analyzePolicyFile(const std::string& filename, PolicyAgreement& result) {
+    std::vector<PolicyEntry> entries;
+    if (!readPolicyEntries(filename, entries)) {
+        return false;
+    }
+    result = analyzePolicyEntries(entries);
+    return true;
+}
+
+void printPolicyAgreement(const std::string& filename, const PolicyAgreement& result) {
+    std::cout << "\nAnalyzing " << filename << " ... loaded " << result.loadedStates << " states\n";
+    std::cout << "  Total non-terminal states in Q: " << result.totalStates << "\n";
+    std::cout << "  Agreement with Minimax eq-class: " << result.matchCount << "\n";
+    std::cout << "  Mismatches: " << result.mismatchCount << "\n";
+    if (result.mismatchCount > 0) {
+        double avgDiff    = result.sumDiff / result.mismatchCount;
+        double avgAbsDiff = result.sumAbsDiff / result.mismatchCount;
+        std::cout << "  avg(QPayoff - MinimaxPayoff) over mismatches: " << avgDiff << "\n";
+        std::cout << "  avg absolute difference: " << avgAbsDiff << "\n";
+    }
+}
+
+// win/draw/loss probabilities from a position, memoised per index
+static void solveOutcomes(int index, int agentPlayer, const std::vector<int8_t>& greedy,
+                          const OpponentTable& opponent, std::vector<OutcomeRates>& memo,
+                          std::vector<bool>& done) {
+    if (done[index]) {
+        return;
+    }
+    const PositionInfo& info = positionInfo(index);
+    OutcomeRates rates;
+    if (info.flags & kPosTerminal) {
+        if (info.winner == agentPlayer) rates.win = 1.0;
+        else if (info.winner == 0)      rates.draw = 1.0;
+        else                            rates.loss = 1.0;
+    } else if (info.toMove == agentPlayer) {
+        int child = index + agentPlayer * kPow3[greedy[index]];
+        solveOutcomes(child, agentPlayer, greedy, opponent, memo, done);
+        rates = memo[child];
+    } else {
+        uint16_t mask = opponent.responses(index);
+        double p = 1.0 / double(moveCount(mask));
+        for (int a = 0; a < 9; ++a) {
+            if (!((mask >> a) & 1)) continue;
+            int child = index + info.toMove * kPow3[a];
+            solveOutcomes(child, agentPlayer, greedy, opponent, memo, done);
+            rates.win  += p * memo[child].win;
+            rates.draw += p * memo[child].draw;
+            rates.loss += p * memo[child].loss;
+        }
+    }
+    memo[index] = rates;
+    done[index] = true;
+}
+
+std::vector<int8_t> greedyPolicy(const std::vector<PolicyEntry>& entries) {
+    // unseen states have all-zero values, so the greedy move is the first legal one
+    std::vector<int8_t> greedy(kNumPositions, -1);
+    for (int index = 0; index < kNumPositions; ++index) {
+        unsigned legal = positionInfo(index).legalMoves;
+        if (legal) {
+            greedy[index] = int8_t(nthMove(legal, 0));
+        }
+    }
+    for (const PolicyEntry& e : entries) {
+        int index = positionIndexFromString(std::string(e.state, 9));
+        if (index < 0 || !isPlayablePosition(index)) {
+            continue;
+        }
+        greedy[index] = int8_t(greedyAction(e.qvals, positionInfo(index).legalMoves));
+    }
+    return greedy;
+}
+
+OutcomeRates exactOutcomes(const std::vector<PolicyEntry>& entries,
+                           const OpponentTable& opponent, int agentPlayer) {
+    std::vector<int8_t> greedy = greedyPolicy(entries);
+    std::vector<OutcomeRates> memo(kNumPositions);
+    std::vector<bool> done(kNumPositions, false);
+    solveOutcomes(0, agentPlayer, greedy, opponent, memo, done);
+    return memo[0];
+}
@@ -0,0 +1,66 @@
+#ifndef POLICY_ANALYSIS_H
+#define POLICY_ANALYSIS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "qlearning.h"
+#include "opponents.h"
+
+// how a Q policy's greedy moves compare with minimax, as printed by
+// analyze_policy
+struct PolicyAgreement {
+    size_t loadedStates = 0;   // rows in the table, playable or not
+    int totalStates = 0;       // non-terminal reachable states analysed
+    int matchCount = 0;        // greedy move is in minimax's equivalence class
+    int mismatchCount = 0;
+    double sumDiff = 0.0;      // sum of (Q payoff - minimax payoff) over mismatches
+    double sumAbsDiff = 0.0;
+
+    double agreement() const {
+        return totalStates ? double(matchCount) / double(totalStates) : 0.0;
+    }
+};
+
+// Minimax::scorePosition for every (position index, player) pair,
+// computed once from the position table on first use
+double minimaxScore(int index, int player);
+
+// bit a set if action a is one of minimax's best moves at a playable position
+uint16_t optimalMoves(int index);
+
+// reads a .dat file (as loadPolicy would, later rows replacing earlier
+// ones) without printing anything; false if it could not be opened
+bool readPolicyEntries(const std::string& filename, std::vector<PolicyEntry>& entries);
+
+// readPolicyEntries for files that may be replaced while running: false,
+// with the reason in error, unless the file is complete and every row is
+// a well-formed board with finite values
+bool readCompletePolicy(const std::string& filename, std::vector<PolicyEntry>& entries,
+                        std::string& error);
+
+PolicyAgreement analyzePolicyEntries(const std::vector<PolicyEntry>& entries);
+
+// reads and analyses a .dat file; false if it could not be opened
+bool analyzePolicyFile(const std::string& filename, PolicyAgreement& result);
+
+// the analyze_policy report for one table
+void printPolicyAgreement(const std::string& filename, const PolicyAgreement& result);
+
+// the greedy (epsilon 0) action for every position index, -1 where there
+// is no legal move; a compact read-only copy of the policy's behaviour
+std::vector<int8_t> greedyPolicy(const std::vector<PolicyEntry>& entries);
+
+// chances of each result when the policy plays greedily (epsilon 0) as
+// agentPlayer against an opponent table, summed exactly over every
+// response the opponent could pick rather than sampled
+struct OutcomeRates {
+    double win = 0.0;
+    double draw = 0.0;
+    double loss = 0.0;
+};
+
+OutcomeRates exactOutcomes(const std::vector<PolicyEntry>& entries,
+                           const OpponentTable& opponent, int agentPlayer);
+
+#endif
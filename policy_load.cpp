@@ -0,0 +1,206 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "position_table.h"
+#include "rng.h"
+#include "policy_protocol.h"
+#include "latency_histogram.h"
+
+// load generator for policy_server: each connection keeps --depth
+// requests in flight and sends a new one as soon as a reply comes back,
+// for --seconds. boards are drawn uniformly from the playable positions
+//
+//   policy_load [--connect address] [--connections N] [--depth N]
+//               [--seconds S] [--policies N] [--seed N]
+//
+// latency is the round trip seen by the client, send to reply
+
+#ifdef _WIN32
+
+int main() {
+    std::cerr << "policy_load needs a POSIX system\n";
+    return 1;
+}
+
+#else
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+
+struct ClientResult {
+    LatencyHistogram latency;
+    long long replies = 0;
+    long long errors = 0;
+    bool failed = false;
+};
+
+static bool sendAll(int fd, const void* p, size_t n) {
+    const char* data = static_cast<const char*>(p);
+    while (n > 0) {
+        ssize_t sent = send(fd, data, n, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += sent;
+        n -= size_t(sent);
+    }
+    return true;
+}
+
+static void runClient(const std::string& address, int depth, int policies, double seconds,
+                      const std::vector<std::string>& boards, Rng rng, ClientResult& result) {
+    using namespace std::chrono;
+    int fd = connectTo(address);
+    if (fd < 0) {
+        result.failed = true;
+        return;
+    }
+
+    // tags are consecutive and replies come back in order, so the
+    // requests in flight always occupy distinct slots of tag % depth
+    std::vector<steady_clock::time_point> sentAt(depth);
+    uint32_t nextTag = 0;
+    std::vector<MoveRequest> outgoing;
+    auto queueRequest = [&]() {
+        MoveRequest req;
+        req.tag = nextTag++;
+        req.policy = uint16_t(rng.uniformInt(policies));
+        std::memcpy(req.board, boards[rng.uniformInt(int(boards.size()))].data(), 9);
+        req.reserved = 0;
+        outgoing.push_back(req);
+    };
+
+    auto deadline = steady_clock::now() + duration_cast<steady_clock::duration>(duration<double>(seconds));
+    for (int i = 0; i < depth; ++i) {
+        queueRequest();
+    }
+    auto now = steady_clock::now();
+    for (const MoveRequest& req : outgoing) {
+        sentAt[req.tag % depth] = now;
+    }
+    if (!sendAll(fd, outgoing.data(), outgoing.size() * sizeof(MoveRequest))) {
+        result.failed = true;
+        close(fd);
+        return;
+    }
+
+    long long inFlight = depth;
+    std::vector<char> in;
+    char buf[16 * 1024];
+    while (inFlight > 0) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            result.failed = true;
+            break;
+        }
+        now = steady_clock::now();
+        bool sending = now < deadline;
+        in.insert(in.end(), buf, buf + n);
+        size_t whole = in.size() / sizeof(MoveReply) * sizeof(MoveReply);
+        outgoing.clear();
+        for (size_t pos = 0; pos < whole; pos += sizeof(MoveReply)) {
+            MoveReply reply;
+            std::memcpy(&reply, in.data() + pos, sizeof(reply));
+            result.latency.record(uint64_t(duration_cast<nanoseconds>(now - sentAt[reply.tag % depth]).count()));
+            result.replies++;
+            result.errors += (reply.status != kMoveOk);
+            inFlight--;
+            if (sending) {
+                queueRequest();
+            }
+        }
+        in.erase(in.begin(), in.begin() + whole);
+        if (!outgoing.empty()) {
+            now = steady_clock::now();
+            for (const MoveRequest& req : outgoing) {
+                sentAt[req.tag % depth] = now;
+            }
+            if (!sendAll(fd, outgoing.data(), outgoing.size() * sizeof(MoveRequest))) {
+                result.failed = true;
+                break;
+            }
+            inFlight += (long long)outgoing.size();
+        }
+    }
+    close(fd);
+}
+
+int main(int argc, char** argv) {
+    uint64_t seed = seedFromArgs(argc, argv);
+    std::string address = kDefaultPolicyAddress;
+    int connections = 4;
+    int depth = 16;
+    double seconds = 5.0;
+    int policies = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--connect")          address = argv[i + 1];
+        else if (arg == "--connections") connections = std::atoi(argv[i + 1]);
+        else if (arg == "--depth")       depth = std::atoi(argv[i + 1]);
+        else if (arg == "--seconds")     seconds = std::atof(argv[i + 1]);
+        else if (arg == "--policies")    policies = std::atoi(argv[i + 1]);
+        else if (arg == "--seed")        continue;
+        else {
+            std::cerr << "unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+    if (connections <= 0 || depth <= 0 || policies <= 0 || seconds <= 0) {
+        std::cerr << "--connections, --depth, --policies and --seconds must be positive\n";
+        return 1;
+    }
+
+    std::vector<std::string> boards;
+    for (int index = 0; index < kNumPositions; ++index) {
+        if (isPlayablePosition(index)) {
+            boards.push_back(positionString(index));
+        }
+    }
+
+    std::cout << "Seed: " << seed << "\n"
+              << connections << " connections to " << address << ", " << depth
+              << " requests in flight each, " << policies << " policies, " << seconds << "s\n";
+
+    Rng rng = makeStream(nextStreamId());
+    std::vector<ClientResult> results(connections);
+    std::vector<std::thread> clients;
+    auto start = std::chrono::steady_clock::now();
+    for (int c = 0; c < connections; ++c) {
+        clients.emplace_back(runClient, address, depth, policies, seconds,
+                             std::cref(boards), rng.split(), std::ref(results[c]));
+    }
+    for (std::thread& t : clients) {
+        t.join();
+    }
+    double elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(
+        std::chrono::steady_clock::now() - start).count();
+
+    ClientResult total;
+    int failed = 0;
+    for (const ClientResult& r : results) {
+        total.latency.merge(r.latency);
+        total.replies += r.replies;
+        total.errors += r.errors;
+        failed += r.failed;
+    }
+    std::printf("%lld replies in %.2fs (%.0f/s), %lld error replies, %d connections failed\n"
+                "Round trip us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+                total.replies, elapsed, elapsed > 0 ? double(total.replies) / elapsed : 0.0,
+                total.errors, failed,
+                total.latency.percentile(0.50) / 1e3, total.latency.percentile(0.90) / 1e3,
+                total.latency.percentile(0.99) / 1e3, total.latency.percentile(0.999) / 1e3,
+                total.latency.max() / 1e3);
+    return failed ? 1 : 0;
+}
+
+#endif
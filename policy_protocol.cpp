@@ -0,0 +1,131 @@
+#include "policy_protocol.h"
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+int listenOn(const std::string& address) {
+    std::cerr << "cannot listen on " << address << ": the policy server needs Linux\n";
+    return -1;
+}
+
+void closeListener(int, const std::string&) {
+}
+
+int connectTo(const std::string& address) {
+    std::cerr << "cannot connect to " << address << ": the policy server needs Linux\n";
+    return -1;
+}
+
+#else
+
+static bool isTcpAddress(const std::string& address) {
+    if (address.empty() || address.find('/') != std::string::npos ||
+        address.compare(0, 5, "unix:") == 0) {
+        return false;
+    }
+    std::string port = address.substr(address.rfind(':') + 1);
+    return !port.empty() && port.find_first_not_of("0123456789") == std::string::npos;
+}
+
+static std::string unixPath(const std::string& address) {
+    return address.compare(0, 5, "unix:") == 0 ? address.substr(5) : address;
+}
+
+// fills addr from address, returns its length, 0 if it is unusable
+static socklen_t makeAddress(const std::string& address, sockaddr_storage& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    if (isTcpAddress(address)) {
+        size_t colon = address.rfind(':');
+        std::string host = colon == std::string::npos ? "127.0.0.1" : address.substr(0, colon);
+        int port = std::atoi(address.c_str() + (colon == std::string::npos ? 0 : colon + 1));
+        sockaddr_in& in = reinterpret_cast<sockaddr_in&>(addr);
+        in.sin_family = AF_INET;
+        in.sin_port = htons(uint16_t(port));
+        if (host == "localhost") host = "127.0.0.1";
+        if (inet_pton(AF_INET, host.c_str(), &in.sin_addr) != 1) {
+            return 0;
+        }
+        return sizeof(sockaddr_in);
+    }
+    std::string path = unixPath(address);
+    sockaddr_un& un = reinterpret_cast<sockaddr_un&>(addr);
+    if (path.empty() || path.size() >= sizeof(un.sun_path)) {
+        return 0;
+    }
+    un.sun_family = AF_UNIX;
+    std::memcpy(un.sun_path, path.c_str(), path.size() + 1);
+    return sizeof(sockaddr_un);
+}
+
+int listenOn(const std::string& address) {
+    sockaddr_storage addr;
+    socklen_t len = makeAddress(address, addr);
+    if (len == 0) {
+        std::cerr << "bad address " << address << "\n";
+        return -1;
+    }
+    int fd = socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::cerr << "socket: " << std::strerror(errno) << "\n";
+        return -1;
+    }
+    if (addr.ss_family == AF_UNIX) {
+        // a socket file left behind by a previous server
+        unlink(unixPath(address).c_str());
+    } else {
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), len) < 0 || listen(fd, 1024) < 0) {
+        std::cerr << "cannot listen on " << address << ": " << std::strerror(errno) << "\n";
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void closeListener(int fd, const std::string& address) {
+    close(fd);
+    if (!isTcpAddress(address)) {
+        unlink(unixPath(address).c_str());
+    }
+}
+
+int connectTo(const std::string& address) {
+    sockaddr_storage addr;
+    socklen_t len = makeAddress(address, addr);
+    if (len == 0) {
+        std::cerr << "bad address " << address << "\n";
+        return -1;
+    }
+    int fd = socket(addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::cerr << "socket: " << std::strerror(errno) << "\n";
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), len) < 0) {
+        std::cerr << "cannot connect to " << address << ": " << std::strerror(errno) << "\n";
+        close(fd);
+        return -1;
+    }
+    if (addr.ss_family == AF_INET) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    return fd;
+}
+
+#endif
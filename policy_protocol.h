@@ -0,0 +1,49 @@
+#ifndef POLICY_PROTOCOL_H
+#define POLICY_PROTOCOL_H
+
+#include <cstdint>
+#include <string>
+
+// wire format between policy_server and its clients: fixed-size binary
+// messages, host byte order (both ends run on the same machine)
+//
+// a client may send any number of requests without waiting; replies come
+// back on the same connection in request order, tag copied from the request
+
+struct MoveRequest {
+    uint32_t tag;          // chosen by the client, echoed in the reply
+    uint16_t policy;       // index of the policy, in server command line order
+    char board[9];         // QLearningAgent::encodeBoard string, no terminator
+    uint8_t reserved;
+};
+
+// MoveReply::status
+constexpr uint8_t kMoveOk = 0;
+constexpr uint8_t kMoveUnknownPolicy = 1;
+constexpr uint8_t kMoveBadBoard = 2;       // malformed, unreachable or finished game
+constexpr uint8_t kMoveNone = 3;           // the policy had no move
+
+struct MoveReply {
+    uint32_t tag;
+    int8_t action;         // y*3 + x, -1 unless status is kMoveOk
+    uint8_t status;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(MoveRequest) == 16, "MoveRequest is 16 bytes on the wire");
+static_assert(sizeof(MoveReply) == 8, "MoveReply is 8 bytes on the wire");
+
+// where the server listens: a path (or "unix:path") for a Unix domain
+// socket, or "port" / "host:port" for TCP
+const char* const kDefaultPolicyAddress = "ttt_policy.sock";
+
+// non-blocking listening socket for address, -1 (with a message) on failure
+int listenOn(const std::string& address);
+
+// closes a socket from listenOn and removes its socket file, if any
+void closeListener(int fd, const std::string& address);
+
+// blocking connected socket with Nagle off, -1 (with a message) on failure
+int connectTo(const std::string& address);
+
+#endif
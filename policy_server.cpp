@@ -0,0 +1,400 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "tic_tac_toe.h"
+#include "position_table.h"
+#include "player.h"
+#include "policy_store.h"
+#include "rng.h"
+#include "policy_protocol.h"
+#include "latency_histogram.h"
+
+// long-running move server: loads the policies once, then answers
+// MoveRequests (policy_protocol.h) from any number of clients
+//
+//   policy_server [--listen address] [--stats seconds] [--reload ms]
+//                 [--seed N] player ...
+//
+// players are given as for matchup --tournament: minimax, random, buggy,
+// buggy2, .dat files or directories of them. policy ids are their
+// positions in the list printed at startup
+//
+// one thread runs an epoll loop. everything that arrived during one
+// wakeup is answered as a batch, and each connection gets all its
+// replies in one send, so the syscall cost is shared by the batch
+//
+// .dat files are checked every --reload ms (default 500, 0 = never) and
+// a new version is swapped in without stopping the loop; see PolicyStore.
+// each batch is answered from the versions current when it started
+//
+// latency is measured from the read that brought a request in to the
+// send that carried the last byte of its reply, however long the reply
+// waited for room in the socket; replies to a connection that closes
+// first are not counted. stats go to the console every --stats seconds
+// and once more on Ctrl-C
+
+#ifndef __linux__
+
+int main() {
+    std::cerr << "policy_server needs Linux (epoll)\n";
+    return 1;
+}
+
+#else
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+
+static volatile std::sig_atomic_t g_stop = 0;
+
+static void onSignal(int) {
+    g_stop = 1;
+}
+
+struct Connection {
+    int fd = -1;
+    std::vector<char> in;          // bytes of a request not yet complete
+    std::vector<MoveReply> out;    // replies not yet sent
+    std::vector<std::chrono::steady_clock::time_point> outReadTimes;   // of each reply's request
+    size_t outSentBytes = 0;       // of out[0..]
+    size_t outTimed = 0;           // replies of out already in the latency histogram
+    bool writing = false;          // registered for EPOLLOUT
+    bool closed = false;
+};
+
+struct Pending {
+    Connection* conn;
+    MoveRequest request;
+    std::chrono::steady_clock::time_point readTime;   // of the recv that completed it
+};
+
+struct ServerStats {
+    LatencyHistogram latency;
+    long long requests = 0;
+    long long batches = 0;
+    long long largestBatch = 0;
+
+    void addBatch(long long n) {
+        requests += n;
+        batches++;
+        largestBatch = std::max(largestBatch, n);
+    }
+
+    void merge(const ServerStats& other) {
+        latency.merge(other.latency);
+        requests += other.requests;
+        batches += other.batches;
+        largestBatch = std::max(largestBatch, other.largestBatch);
+    }
+
+    void print(const char* label, double seconds, size_t connections) const {
+        std::printf("%s: %lld requests in %.1fs (%.0f/s), %zu connections, "
+                    "mean batch %.1f, largest %lld\n"
+                    "  latency us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+                    label, requests, seconds, seconds > 0 ? double(requests) / seconds : 0.0,
+                    connections, batches ? double(requests) / double(batches) : 0.0,
+                    largestBatch,
+                    latency.percentile(0.50) / 1e3, latency.percentile(0.90) / 1e3,
+                    latency.percentile(0.99) / 1e3, latency.percentile(0.999) / 1e3,
+                    latency.max() / 1e3);
+        std::fflush(stdout);
+    }
+
+    void clear() { *this = ServerStats(); }
+};
+
+// replies[i] answers batch[i]. requests are checked one by one, then the
+// boards asking each policy go to its Player::moves in one call
+static void answerBatch(const std::vector<Pending>& batch,
+                        const std::vector<std::shared_ptr<const Player>>& players, Rng& rng,
+                        std::vector<MoveReply>& replies) {
+    // kept between batches, the loop is single-threaded
+    static std::vector<std::vector<uint32_t>> byPolicy;
+    static std::vector<uint16_t> positions;
+    static std::vector<int8_t> actions;
+    static std::vector<uint16_t> requestIndex;
+    byPolicy.resize(players.size());
+    for (auto& list : byPolicy) list.clear();
+
+    replies.resize(batch.size());
+    requestIndex.resize(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const MoveRequest& req = batch[i].request;
+        MoveReply& reply = replies[i];
+        reply.tag = req.tag;
+        reply.action = -1;
+        reply.reserved = 0;
+        if (req.policy >= players.size()) {
+            reply.status = kMoveUnknownPolicy;
+            continue;
+        }
+        int index = positionIndexFromString(std::string(req.board, 9));
+        if (index < 0 || !isPlayablePosition(index)) {
+            reply.status = kMoveBadBoard;
+            continue;
+        }
+        requestIndex[i] = uint16_t(index);
+        byPolicy[req.policy].push_back(uint32_t(i));
+    }
+
+    for (size_t p = 0; p < players.size(); ++p) {
+        const std::vector<uint32_t>& list = byPolicy[p];
+        if (list.empty()) continue;
+        positions.resize(list.size());
+        actions.resize(list.size());
+        for (size_t k = 0; k < list.size(); ++k) {
+            positions[k] = requestIndex[list[k]];
+        }
+        players[p]->moves(positions.data(), int(list.size()), actions.data(), rng);
+        for (size_t k = 0; k < list.size(); ++k) {
+            MoveReply& r = replies[list[k]];
+            r.action = actions[k];
+            r.status = actions[k] < 0 ? kMoveNone : kMoveOk;
+        }
+    }
+}
+
+// sends as much of conn.out as the socket takes; false if the peer is
+// gone. a reply's latency is recorded once the send carrying its last
+// byte has gone through
+static bool flushReplies(Connection& conn, LatencyHistogram& latency) {
+    const char* data = reinterpret_cast<const char*>(conn.out.data());
+    size_t total = conn.out.size() * sizeof(MoveReply);
+    while (conn.outSentBytes < total) {
+        ssize_t n = send(conn.fd, data + conn.outSentBytes, total - conn.outSentBytes, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        conn.outSentBytes += size_t(n);
+        auto sent = std::chrono::steady_clock::now();
+        for (size_t whole = conn.outSentBytes / sizeof(MoveReply); conn.outTimed < whole; ++conn.outTimed) {
+            latency.record(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                sent - conn.outReadTimes[conn.outTimed]).count()));
+        }
+    }
+    conn.out.clear();
+    conn.outReadTimes.clear();
+    conn.outSentBytes = 0;
+    conn.outTimed = 0;
+    return true;
+}
+
+// reads everything available; complete requests go to batch. false if
+// the peer closed or the socket failed
+static bool readRequests(Connection& conn, std::vector<Pending>& batch) {
+    char buf[64 * 1024];
+    for (;;) {
+        ssize_t n = recv(conn.fd, buf, sizeof(buf), 0);
+        if (n == 0) {
+            return false;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        auto readTime = std::chrono::steady_clock::now();
+        conn.in.insert(conn.in.end(), buf, buf + n);
+        size_t whole = conn.in.size() / sizeof(MoveRequest) * sizeof(MoveRequest);
+        for (size_t pos = 0; pos < whole; pos += sizeof(MoveRequest)) {
+            Pending p;
+            p.conn = &conn;
+            p.readTime = readTime;
+            std::memcpy(&p.request, conn.in.data() + pos, sizeof(MoveRequest));
+            batch.push_back(p);
+        }
+        conn.in.erase(conn.in.begin(), conn.in.begin() + whole);
+        if (size_t(n) < sizeof(buf)) {
+            return true;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    uint64_t seed = seedFromArgs(argc, argv);
+    std::string address = kDefaultPolicyAddress;
+    double statsEvery = 10.0;
+    int reloadMs = 500;
+    std::vector<std::string> specs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "--listen" || arg == "--stats" || arg == "--reload" || arg == "--seed") &&
+            i + 1 < argc) {
+            if (arg == "--listen") address = argv[i + 1];
+            if (arg == "--stats")  statsEvery = std::atof(argv[i + 1]);
+            if (arg == "--reload") reloadMs = std::atoi(argv[i + 1]);
+            ++i;
+        } else {
+            specs.push_back(arg);
+        }
+    }
+
+    PolicyStore store;
+    for (const std::string& spec : specs) {
+        if (!store.add(spec)) {
+            return 1;
+        }
+    }
+    if (store.size() == 0) {
+        std::cerr << "usage: policy_server [--listen address] [--stats seconds] [--reload ms] "
+                     "[--seed N] player ...\n"
+                  << "  players: minimax, random, buggy, buggy2, a .dat file or a directory of them\n"
+                  << "  address: a socket path (default " << kDefaultPolicyAddress
+                  << ") or [host:]port for TCP\n";
+        return 1;
+    }
+    Rng rng = makeStream(nextStreamId());
+
+    int listenFd = listenOn(address);
+    if (listenFd < 0) {
+        return 1;
+    }
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;    // the listening socket
+    epoll_ctl(ep, EPOLL_CTL_ADD, listenFd, &ev);
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    std::cout << "===== Tic-Tac-Toe Policy Server =====\n"
+              << "Seed: " << seed << "\n"
+              << "Listening on " << address << "\n"
+              << "Policies:\n";
+    for (size_t i = 0; i < store.size(); ++i) {
+        std::cout << "  " << i << "  " << store.name(i) << "\n";
+    }
+    std::cout.flush();
+    if (reloadMs > 0) {
+        store.watch(std::chrono::milliseconds(reloadMs));
+    }
+
+    using namespace std::chrono;
+    std::vector<std::unique_ptr<Connection>> connections;
+    std::vector<Pending> batch;
+    std::vector<MoveReply> replies;
+    std::vector<Connection*> touched;
+    std::vector<std::shared_ptr<const Player>> players(store.size());
+    ServerStats interval, overall;
+    auto start = steady_clock::now();
+    auto intervalStart = start;
+    epoll_event events[256];
+
+    while (!g_stop) {
+        int timeoutMs = statsEvery > 0 ? 100 : -1;
+        int n = epoll_wait(ep, events, 256, timeoutMs);
+        if (n < 0 && errno != EINTR) {
+            std::cerr << "epoll_wait: " << std::strerror(errno) << "\n";
+            break;
+        }
+        batch.clear();
+        touched.clear();
+        for (int e = 0; e < n; ++e) {
+            Connection* conn = static_cast<Connection*>(events[e].data.ptr);
+            if (!conn) {
+                for (;;) {
+                    int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if (fd < 0) break;
+                    connections.emplace_back(new Connection());
+                    connections.back()->fd = fd;
+                    epoll_event cev;
+                    cev.events = EPOLLIN;
+                    cev.data.ptr = connections.back().get();
+                    epoll_ctl(ep, EPOLL_CTL_ADD, fd, &cev);
+                }
+                continue;
+            }
+            if (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                if (!readRequests(*conn, batch)) {
+                    conn->closed = true;
+                }
+            }
+            if ((events[e].events & EPOLLOUT) && !conn->closed) {
+                touched.push_back(conn);
+            }
+        }
+        if (!batch.empty()) {
+            for (size_t i = 0; i < players.size(); ++i) {
+                players[i] = store.get(i);
+            }
+        }
+        answerBatch(batch, players, rng, replies);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            Connection* conn = batch[i].conn;
+            if (conn->out.empty()) {
+                touched.push_back(conn);
+            }
+            conn->out.push_back(replies[i]);
+            conn->outReadTimes.push_back(batch[i].readTime);
+        }
+        for (Connection* conn : touched) {
+            if (conn->closed) continue;
+            if (!flushReplies(*conn, interval.latency)) {
+                conn->closed = true;
+                continue;
+            }
+            // wait for room in the socket only while replies are queued
+            bool waiting = !conn->out.empty();
+            if (waiting != conn->writing) {
+                epoll_event cev;
+                cev.events = waiting ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+                cev.data.ptr = conn;
+                epoll_ctl(ep, EPOLL_CTL_MOD, conn->fd, &cev);
+                conn->writing = waiting;
+            }
+        }
+
+        if (!batch.empty()) {
+            interval.addBatch((long long)batch.size());
+        }
+
+        for (size_t i = 0; i < connections.size();) {
+            if (connections[i]->closed) {
+                close(connections[i]->fd);
+                connections[i] = std::move(connections.back());
+                connections.pop_back();
+            } else {
+                ++i;
+            }
+        }
+
+        auto now = steady_clock::now();
+        double elapsed = duration_cast<duration<double>>(now - intervalStart).count();
+        if (statsEvery > 0 && elapsed >= statsEvery) {
+            if (interval.requests) {
+                interval.print("Last interval", elapsed, connections.size());
+            }
+            overall.merge(interval);
+            interval.clear();
+            intervalStart = now;
+        }
+    }
+
+    overall.merge(interval);
+    store.stopWatching();
+    std::cout << "\n";
+    if (store.reloads()) {
+        std::cout << store.reloads() << " policy reloads\n";
+    }
+    overall.print("Total", duration_cast<duration<double>>(steady_clock::now() - start).count(),
+                  connections.size());
+
+    for (auto& conn : connections) {
+        close(conn->fd);
+    }
+    closeListener(listenFd, address);
+    close(ep);
+    return 0;
+}
+
+#endif
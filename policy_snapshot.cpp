@@ -0,0 +1,106 @@
+#include "policy_snapshot.h"
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include "profiler.h"
+
+bool replaceFile(const std::string& tmp, const std::string& filename) {
+#ifdef _WIN32
+    // rename() will not overwrite on windows
+    std::remove(filename.c_str());
+#endif
+    if (std::rename(tmp.c_str(), filename.c_str()) != 0) {
+        std::cerr << "could not move " << tmp << " to " << filename << "\n";
+        return false;
+    }
+    return true;
+}
+
+static bool writeWhole(const std::string& filename, const std::string& contents) {
+    std::string tmp = filename + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::out | std::ios::binary);
+        if (!out) {
+            std::cerr << "could not open " << tmp << " to write\n";
+            return false;
+        }
+        out.write(contents.data(), contents.size());
+        if (!out) {
+            std::cerr << "could not write " << tmp << "\n";
+            return false;
+        }
+    }
+    return replaceFile(tmp, filename);
+}
+
+bool writePolicyFile(const std::vector<PolicyEntry>& entries, const std::string& filename) {
+    PROFILE_SCOPE("writePolicyFile");
+    return writeWhole(filename, serializePolicy(entries));
+}
+
+PolicySnapshotter::PolicySnapshotter()
+    : worker(&PolicySnapshotter::run, this)
+{
+}
+
+PolicySnapshotter::~PolicySnapshotter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void PolicySnapshotter::snapshot(const QLearningAgent& agent, const std::string& filename,
+                                 const std::string& sidecarFile, const std::string& sidecar) {
+    Job job;
+    agent.copyTable(job.entries);
+    job.filename = filename;
+    job.sidecarFile = sidecarFile;
+    job.sidecar = sidecar;
+    if (agent.getModel()) {
+        job.model = agent.getModel()->serialize();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    wake.notify_one();
+}
+
+void PolicySnapshotter::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return jobs.empty() && !busy; });
+}
+
+void PolicySnapshotter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (jobs.empty()) {
+            // only reached when stopping with nothing left to write
+            break;
+        }
+        Job job = std::move(jobs.front());
+        jobs.pop_front();
+        busy = true;
+        lock.unlock();
+
+        // policy first: a sidecar never describes a file that isn't there yet
+        if (writePolicyFile(job.entries, job.filename)) {
+            if (!job.model.empty()) {
+                writeWhole(qModelFile(job.filename), job.model);
+            }
+            if (!job.sidecarFile.empty()) {
+                writeWhole(job.sidecarFile, job.sidecar);
+            }
+        }
+
+        lock.lock();
+        busy = false;
+        if (jobs.empty()) {
+            idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef POLICY_SNAPSHOT_H
+#define POLICY_SNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "qlearning.h"
+
+// writes a .dat file (same format as savePolicy) in one write call,
+// via filename.tmp and a rename so readers never see a partial file
+bool writePolicyFile(const std::vector<PolicyEntry>& entries, const std::string& filename);
+
+// renames tmp over filename, replacing it if it exists
+bool replaceFile(const std::string& tmp, const std::string& filename);
+
+// saves policies in the background while training continues
+//
+// snapshot() copies the Q-table into a flat array on the calling thread,
+// which is a plain copy of a few hundred KB at most, and hands it to a
+// worker thread that serialises and writes it
+class PolicySnapshotter {
+public:
+    PolicySnapshotter();
+
+    // finishes any queued writes
+    ~PolicySnapshotter();
+
+    // queue agent's current table for writing to filename; if sidecar is
+    // not empty it is written to sidecarFile once the policy is in place.
+    // an agent with a model also gets its weights in qModelFile(filename)
+    void snapshot(const QLearningAgent& agent, const std::string& filename,
+                  const std::string& sidecarFile = "", const std::string& sidecar = "");
+
+    // blocks until everything queued so far is on disk
+    void wait();
+
+private:
+    struct Job {
+        std::vector<PolicyEntry> entries;
+        std::string filename;
+        std::string sidecarFile;
+        std::string sidecar;
+        std::string model;         // QModel::serialize, empty for a table
+    };
+
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::deque<Job> jobs;
+    bool busy = false;
+    bool stopping = false;
+    std::thread worker;
+};
+
+#endif
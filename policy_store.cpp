@@ -0,0 +1,107 @@
+#include "policy_store.h"
+#include <iostream>
+#include <sstream>
+#include <filesystem>
+#include "policy_analysis.h"
+
+bool PolicyStore::add(const std::string& spec) {
+    std::vector<std::unique_ptr<Player>> players;
+    if (!makePlayers(spec, players)) {
+        return false;
+    }
+    for (auto& p : players) {
+        std::unique_ptr<Slot> slot(new Slot());
+        slot->name = p->name();
+        if (dynamic_cast<PolicyPlayer*>(p.get())) {
+            slot->file = p->name();
+            stampOf(slot->file, slot->loaded);
+            slot->seen = slot->loaded;
+        }
+        slot->current = std::shared_ptr<const Player>(std::move(p));
+        slots.push_back(std::move(slot));
+    }
+    return true;
+}
+
+bool PolicyStore::stampOf(const std::string& file, FileStamp& stamp) {
+    std::error_code ec;
+    auto time = std::filesystem::last_write_time(file, ec);
+    if (ec) return false;
+    auto size = std::filesystem::file_size(file, ec);
+    if (ec) return false;
+    stamp.time = int64_t(time.time_since_epoch().count());
+    stamp.size = uint64_t(size);
+    return true;
+}
+
+void PolicyStore::watch(std::chrono::milliseconds interval) {
+    stopWatching();
+    stopping = false;
+    watcher = std::thread(&PolicyStore::run, this, interval);
+}
+
+void PolicyStore::stopWatching() {
+    if (!watcher.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    watcher.join();
+}
+
+void PolicyStore::run(std::chrono::milliseconds interval) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!wake.wait_for(lock, interval, [this] { return stopping; })) {
+        lock.unlock();
+        for (auto& slot : slots) {
+            // a reader still holding the old version frees it itself,
+            // otherwise it goes here, off the serving thread
+            slot->retired.reset();
+            if (!slot->file.empty()) {
+                poll(*slot);
+            }
+        }
+        lock.lock();
+    }
+}
+
+void PolicyStore::poll(Slot& slot) {
+    FileStamp stamp;
+    if (!stampOf(slot.file, stamp)) {
+        // mid-rename or deleted: keep serving what we have
+        return;
+    }
+    bool settled = (stamp == slot.seen);
+    slot.seen = stamp;
+    if (!settled || stamp == slot.loaded || stamp == slot.rejected) {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<PolicyEntry> entries;
+    std::string error;
+    if (!readCompletePolicy(slot.file, entries, error)) {
+        slot.rejected = stamp;
+        std::ostringstream msg;
+        msg << "Not reloading " << slot.file << ": " << error
+            << ", still serving version " << slot.version << "\n";
+        std::cout << msg.str() << std::flush;
+        return;
+    }
+    std::shared_ptr<PolicyPlayer> next = std::make_shared<PolicyPlayer>(slot.name);
+    next->assign(entries);
+
+    slot.retired = std::atomic_exchange(&slot.current, std::shared_ptr<const Player>(next));
+    slot.loaded = stamp;
+    slot.version++;
+    reloadCount++;
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::ostringstream msg;
+    msg << "Reloaded " << slot.file << ": version " << slot.version << ", "
+        << next->states() << " states, " << ms << " ms\n";
+    std::cout << msg.str() << std::flush;
+}
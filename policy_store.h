@@ -0,0 +1,80 @@
+#ifndef POLICY_STORE_H
+#define POLICY_STORE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "player.h"
+
+// the players a long-running process serves, with .dat-backed ones
+// reloaded in the background whenever their file changes
+//
+// readers take the current version with get() and keep the shared_ptr
+// for as long as they use it; a reload builds and checks the new
+// version on the watcher thread, then publishes it with one atomic
+// pointer store. a version is freed when the last reader lets go of it,
+// so requests in flight finish on the table they started with
+class PolicyStore {
+public:
+    PolicyStore() = default;
+    ~PolicyStore() { stopWatching(); }
+
+    PolicyStore(const PolicyStore&) = delete;
+    PolicyStore& operator=(const PolicyStore&) = delete;
+
+    // as makePlayers; call before watch()
+    bool add(const std::string& spec);
+
+    size_t size() const { return slots.size(); }
+    const std::string& name(size_t id) const { return slots[id]->name; }
+
+    std::shared_ptr<const Player> get(size_t id) const {
+        return std::atomic_load(&slots[id]->current);
+    }
+
+    // polls every .dat file each interval. a changed file is loaded once
+    // its size and time stamp have held still for one interval, and only
+    // replaces the old version if it is complete and valid
+    void watch(std::chrono::milliseconds interval);
+    void stopWatching();
+
+    long long reloads() const { return reloadCount.load(); }
+
+private:
+    struct FileStamp {
+        int64_t time = 0;
+        uint64_t size = 0;
+        bool operator==(const FileStamp& o) const { return time == o.time && size == o.size; }
+        bool operator!=(const FileStamp& o) const { return !(*this == o); }
+    };
+
+    struct Slot {
+        std::string name;
+        std::string file;                       // empty for built-in players
+        std::shared_ptr<const Player> current;
+        std::shared_ptr<const Player> retired;  // previous version, dropped next poll
+        FileStamp loaded;                       // stamp of the file behind current
+        FileStamp seen;                         // stamp at the last poll
+        FileStamp rejected;                     // last stamp that failed to load
+        int version = 1;
+    };
+
+    static bool stampOf(const std::string& file, FileStamp& stamp);
+    void run(std::chrono::milliseconds interval);
+    void poll(Slot& slot);
+
+    std::vector<std::unique_ptr<Slot>> slots;
+    std::atomic<long long> reloadCount{0};
+    std::thread watcher;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,210 @@
+#include "position_table.h"
+
+namespace {
+
+constexpr int kLines[8][3] = {
+    // rows, cols, then diagonals - same order as TicTacToe::checkWin
+    { 0, 1, 2 }, { 3, 4, 5 }, { 6, 7, 8 },
+    { 0, 3, 6 }, { 1, 4, 7 }, { 2, 5, 8 },
+    { 0, 4, 8 }, { 6, 4, 2 }
+};
+
+constexpr int symmetryCell(int t, int c) {
+    int x = c % 3;
+    int y = c / 3;
+    int nx = x, ny = y;
+    switch (t) {
+        case 1: nx = y;     ny = 2 - x; break; // rotate 90
+        case 2: nx = 2 - x; ny = 2 - y; break; // rotate 180
+        case 3: nx = 2 - y; ny = x;     break; // rotate 270
+        case 4: nx = 2 - x; ny = y;     break; // mirror left-right
+        case 5: nx = x;     ny = 2 - y; break; // mirror top-bottom
+        case 6: nx = y;     ny = x;     break; // main diagonal
+        case 7: nx = 2 - y; ny = 2 - x; break; // anti diagonal
+        default: break;
+    }
+    return ny * 3 + nx;
+}
+
+constexpr std::array<std::array<int, 9>, 8> buildSymmetryTable() {
+    std::array<std::array<int, 9>, 8> table{};
+    for (int t = 0; t < 8; ++t) {
+        for (int c = 0; c < 9; ++c) {
+            table[t][c] = symmetryCell(t, c);
+        }
+    }
+    return table;
+}
+
+constexpr std::array<std::array<int, 9>, 8> kSymmetryLocal = buildSymmetryTable();
+
+// scratch state for the generator, one slot per index
+struct Scratch {
+    uint8_t  count[3][kNumPositions];  // pieces of each player
+    uint8_t  lines[3][kNumPositions];  // bit l set if player owns line l
+    uint16_t empty[kNumPositions];     // bit c set if cell c is empty
+    uint16_t image[8][kNumPositions];  // index after symmetry t
+};
+
+// every index i > 0 is its top non-zero digit plus a smaller index whose
+// entry is already filled in, so each attribute is updated from that
+// entry rather than recomputed from nine cells - this keeps the build
+// inside the compiler's default constexpr step budget
+constexpr std::array<PositionInfo, kNumPositions> buildPositionTable() {
+    std::array<PositionInfo, kNumPositions> table{};
+    Scratch s{};
+
+    int weight[8][9] = {};
+    for (int t = 0; t < 8; ++t) {
+        for (int c = 0; c < 9; ++c) {
+            weight[t][c] = kPow3[kSymmetryLocal[t][c]];
+        }
+    }
+
+    int top = 0;
+    for (int i = 0; i < kNumPositions; ++i) {
+        if (top < 8 && i >= kPow3[top + 1]) ++top;
+        int digit = i / kPow3[top];
+        int rest = i - digit * kPow3[top];
+
+        int count1 = 0, count2 = 0, lines1 = 0, lines2 = 0, empty = 0x1FF;
+        uint16_t canonical = uint16_t(i);
+        uint8_t symmetry = 0;
+        if (i > 0) {
+            count1 = s.count[1][rest] + (digit == 1);
+            count2 = s.count[2][rest] + (digit == 2);
+            lines1 = s.lines[1][rest];
+            lines2 = s.lines[2][rest];
+            empty = s.empty[rest] & ~(1 << top);
+
+            // only lines through the new cell can have been completed
+            for (int l = 0; l < 8; ++l) {
+                const int* line = kLines[l];
+                if (line[0] != top && line[1] != top && line[2] != top) continue;
+                bool owned = true;
+                for (int k = 0; k < 3 && owned; ++k) {
+                    owned = (i / kPow3[line[k]]) % 3 == digit;
+                }
+                if (owned) {
+                    if (digit == 1) lines1 |= 1 << l;
+                    else            lines2 |= 1 << l;
+                }
+            }
+
+            for (int t = 0; t < 8; ++t) {
+                uint16_t img = uint16_t(s.image[t][rest] + digit * weight[t][top]);
+                s.image[t][i] = img;
+                if (img < canonical) {
+                    canonical = img;
+                    symmetry = uint8_t(t);
+                }
+            }
+        }
+        s.count[1][i] = uint8_t(count1);
+        s.count[2][i] = uint8_t(count2);
+        s.lines[1][i] = uint8_t(lines1);
+        s.lines[2][i] = uint8_t(lines2);
+        s.empty[i] = uint16_t(empty);
+
+        PositionInfo& info = table[i];
+        int anyLine = lines1 | lines2;
+        if (anyLine != 0) {
+            // lowest line in checkWin order decides the winner
+            int first = anyLine & -anyLine;
+            info.winner = (lines1 & first) ? 1 : 2;
+        }
+
+        bool full = (count1 + count2 == 9);
+        bool terminal = (info.winner != 0) || full;
+
+        bool legal = (count1 == count2 || count1 == count2 + 1);
+        if (lines1 && lines2) legal = false;
+        if (lines1 && count1 != count2 + 1) legal = false;
+        if (lines2 && count1 != count2) legal = false;
+
+        info.flags = uint8_t((legal ? kPosLegal : 0) |
+                             (terminal ? kPosTerminal : 0) |
+                             (full ? kPosFull : 0));
+        info.toMove = (count1 == count2) ? 1 : 2;
+        info.canonical = canonical;
+        info.symmetry = symmetry;
+
+        info.legalMoves = terminal ? 0 : uint16_t(empty);
+    }
+    return table;
+}
+
+} // namespace
+
+extern constexpr std::array<PositionInfo, kNumPositions> kPositionTable = buildPositionTable();
+
+extern constexpr std::array<std::array<int, 9>, 8> kSymmetryCell = kSymmetryLocal;
+
+// a few spot checks so a broken generator fails the build, not a training run
+static_assert(kPositionTable[0].legalMoves == 0x1FF, "empty board has 9 moves");
+static_assert(kPositionTable[0].toMove == 1, "player1 moves first");
+static_assert(kPositionTable[1 + 3 + 9].winner == 1, "bottom row for player1");
+static_assert(kPositionTable[1 + 3 + 9].flags == kPosTerminal,
+              "illegal count: 3 vs 0 is still terminal but not legal");
+static_assert(kPositionTable[kPow3[2]].canonical == kPositionTable[kPow3[0]].canonical,
+              "corners are symmetric");
+
+int positionIndex(const Board& board) {
+    int index = 0;
+    for (int y = 0; y < 3; ++y) {
+        for (int x = 0; x < 3; ++x) {
+            index += board[y][x] * kPow3[y * 3 + x];
+        }
+    }
+    return index;
+}
+
+int positionIndexFromString(const std::string& stateStr) {
+    if (stateStr.size() != 9) {
+        return -1;
+    }
+    // encodeBoard writes the top row (y = 2) first
+    int index = 0;
+    for (int i = 0; i < 9; ++i) {
+        int v = stateStr[i] - '0';
+        if (v < 0 || v > 2) {
+            return -1;
+        }
+        int x = i % 3;
+        int y = 2 - i / 3;
+        index += v * kPow3[y * 3 + x];
+    }
+    return index;
+}
+
+std::string positionString(int index) {
+    // cell c = y*3 + x is digit c; the string is rows top (y = 2) first
+    std::string result(9, '0');
+    for (int c = 0; c < 9; ++c) {
+        result[(2 - c / 3) * 3 + c % 3] = char('0' + index % 3);
+        index /= 3;
+    }
+    return result;
+}
+
+int completedLines(int index) {
+    int lines = 0;
+    for (int l = 0; l < 8; ++l) {
+        int a = (index / kPow3[kLines[l][0]]) % 3;
+        int b = (index / kPow3[kLines[l][1]]) % 3;
+        int c = (index / kPow3[kLines[l][2]]) % 3;
+        if (a != 0 && a == b && b == c) {
+            lines |= 1 << l;
+        }
+    }
+    return lines;
+}
+
+int fromCanonicalAction(int action, int symmetry) {
+    for (int c = 0; c < 9; ++c) {
+        if (kSymmetryCell[symmetry][c] == action) {
+            return c;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,83 @@
+#ifndef POSITION_TABLE_H
+#define POSITION_TABLE_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include "tic_tac_toe.h"
+
+// every 3x3 board is a base-3 number: cell (x, y) is digit y*3 + x,
+// so digit order matches the q-learning action index
+//   0 = empty, 1 = player1, 2 = player2
+constexpr int kNumPositions = 19683; // 3^9
+
+constexpr int kPow3[9] = { 1, 3, 9, 27, 81, 243, 729, 2187, 6561 };
+
+// PositionInfo::flags
+constexpr uint8_t kPosLegal    = 1; // piece counts and winner are reachable in play
+constexpr uint8_t kPosTerminal = 2; // someone has won or board is full
+constexpr uint8_t kPosFull     = 4; // no empty cells
+
+struct PositionInfo {
+    uint16_t legalMoves; // bit a set if action a is playable, 0 when terminal
+    uint16_t canonical;  // smallest index among the 8 symmetric boards
+    uint8_t  flags;
+    uint8_t  winner;     // 0, 1 or 2, same order of checks as TicTacToe::checkWin
+    uint8_t  toMove;     // 1 if piece counts are equal, else 2
+    uint8_t  symmetry;   // transform taking this board onto its canonical board
+};
+
+// built at compile time in position_table.cpp
+extern const std::array<PositionInfo, kNumPositions> kPositionTable;
+
+// symmetry t sends cell c to cell kSymmetryCell[t][c] (t = 0 is identity)
+extern const std::array<std::array<int, 9>, 8> kSymmetryCell;
+
+inline const PositionInfo& positionInfo(int index) {
+    return kPositionTable[index];
+}
+
+inline bool isTerminalPosition(int index) {
+    return (kPositionTable[index].flags & kPosTerminal) != 0;
+}
+
+// legal and not yet decided, i.e. a state where someone still has to move
+inline bool isPlayablePosition(int index) {
+    return (kPositionTable[index].flags & (kPosLegal | kPosTerminal)) == kPosLegal;
+}
+
+// number of set bits in a legalMoves mask
+inline int moveCount(unsigned mask) {
+    return __builtin_popcount(mask);
+}
+
+// the n-th (from 0) action set in a legalMoves mask, -1 if there is none
+inline int nthMove(unsigned mask, int n) {
+    for (int action = 0; action < 9; ++action) {
+        if ((mask >> action) & 1) {
+            if (n-- == 0) return action;
+        }
+    }
+    return -1;
+}
+
+// index of a Board
+int positionIndex(const Board& board);
+
+// index of a string produced by QLearningAgent::encodeBoard, -1 if malformed
+int positionIndexFromString(const std::string& stateStr);
+
+// inverse of positionIndexFromString
+std::string positionString(int index);
+
+// bit l set if line l is filled by one player: rows y = 0..2 (bits 0-2),
+// columns x = 0..2 (bits 3-5), then diagonals (0,0)-(2,2) and (0,2)-(2,0)
+int completedLines(int index);
+
+// maps an action on a board to the same cell on its canonical board, and back
+inline int toCanonicalAction(int action, int symmetry) {
+    return kSymmetryCell[symmetry][action];
+}
+int fromCanonicalAction(int action, int symmetry);
+
+#endif
@@ -0,0 +1,199 @@
+#include "profiler.h"
+#include <iostream>
+
+#ifndef TTT_PROFILE
+
+void profileDump(const std::string&) {
+}
+
+#else
+
+#include <fstream>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <cstdio>
+
+struct ProfileEvent {
+    int site;
+    uint64_t start;
+    uint64_t duration;
+};
+
+struct SiteTotals {
+    long long calls = 0;
+    uint64_t totalNs = 0;
+    uint64_t maxNs = 0;
+    long long count = 0;      // PROFILE_COUNT sum
+};
+
+// everything one thread has recorded; only that thread writes to it
+struct ThreadProfile {
+    int tid = 0;
+    std::vector<ProfileEvent> ring;
+    uint64_t written = 0;     // events ever recorded, ring keeps the last ones
+    std::vector<SiteTotals> totals;
+
+    SiteTotals& site(int id) {
+        if (id >= int(totals.size())) {
+            totals.resize(id + 1);
+        }
+        return totals[id];
+    }
+};
+
+// sites and threads are registered once each, under the lock; thread
+// profiles live until exit so a dump can still read finished threads
+struct ProfileRegistry {
+    std::mutex mutex;
+    std::vector<const char*> siteNames;
+    std::vector<std::unique_ptr<ThreadProfile>> threads;
+};
+
+static ProfileRegistry& registry() {
+    static ProfileRegistry r;
+    return r;
+}
+
+static thread_local ThreadProfile* t_profile = nullptr;
+
+static ThreadProfile& threadProfile() {
+    if (!t_profile) {
+        ProfileRegistry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.threads.emplace_back(new ThreadProfile());
+        t_profile = r.threads.back().get();
+        t_profile->tid = int(r.threads.size());
+        t_profile->ring.resize(TTT_PROFILE_EVENTS);
+    }
+    return *t_profile;
+}
+
+static const std::chrono::steady_clock::time_point g_profileStart = std::chrono::steady_clock::now();
+
+ProfileSite::ProfileSite(const char* n) : name(n) {
+    ProfileRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    id = int(r.siteNames.size());
+    r.siteNames.push_back(n);
+}
+
+uint64_t profileNowNs() {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - g_profileStart).count());
+}
+
+void profileRecordScope(const ProfileSite& site, uint64_t startNs, uint64_t endNs) {
+    ThreadProfile& t = threadProfile();
+    uint64_t duration = endNs - startNs;
+    t.ring[t.written % t.ring.size()] = { site.id, startNs, duration };
+    t.written++;
+
+    SiteTotals& totals = t.site(site.id);
+    totals.calls++;
+    totals.totalNs += duration;
+    totals.maxNs = std::max(totals.maxNs, duration);
+}
+
+void profileRecordCount(const ProfileSite& site, long long n) {
+    threadProfile().site(site.id).count += n;
+}
+
+static std::string jsonEscape(const char* s) {
+    std::string out;
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') out.push_back('\\');
+        out.push_back(*s);
+    }
+    return out;
+}
+
+static void writeChromeTrace(const std::string& filename, ProfileRegistry& r) {
+    std::ofstream out(filename);
+    if (!out) {
+        std::cerr << "could not open " << filename << " to write\n";
+        return;
+    }
+    out << "{\"traceEvents\": [\n";
+    bool first = true;
+    char buf[128];
+    for (const auto& t : r.threads) {
+        out << (first ? "" : ",\n")
+            << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << t->tid
+            << ", \"args\": {\"name\": \"thread " << t->tid << "\"}}";
+        first = false;
+
+        // oldest surviving event first
+        uint64_t n = std::min<uint64_t>(t->written, t->ring.size());
+        uint64_t begin = t->written - n;
+        for (uint64_t i = begin; i < t->written; ++i) {
+            const ProfileEvent& e = t->ring[i % t->ring.size()];
+            std::snprintf(buf, sizeof(buf), "\"ts\": %.3f, \"dur\": %.3f",
+                          double(e.start) / 1000.0, double(e.duration) / 1000.0);
+            out << ",\n{\"name\": \"" << jsonEscape(r.siteNames[e.site])
+                << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << t->tid << ", " << buf << "}";
+        }
+    }
+    out << "\n]}\n";
+}
+
+static void writeFlatProfile(const std::string& filename, ProfileRegistry& r) {
+    std::ofstream out(filename);
+    if (!out) {
+        std::cerr << "could not open " << filename << " to write\n";
+        return;
+    }
+    std::vector<SiteTotals> sum(r.siteNames.size());
+    for (const auto& t : r.threads) {
+        for (size_t id = 0; id < t->totals.size(); ++id) {
+            const SiteTotals& s = t->totals[id];
+            sum[id].calls += s.calls;
+            sum[id].totalNs += s.totalNs;
+            sum[id].maxNs = std::max(sum[id].maxNs, s.maxNs);
+            sum[id].count += s.count;
+        }
+    }
+
+    std::vector<int> order;
+    for (size_t id = 0; id < sum.size(); ++id) {
+        order.push_back(int(id));
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        return sum[a].totalNs > sum[b].totalNs;
+    });
+
+    // probes nest, so totals overlap rather than add up
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-32s %12s %12s %12s %12s\n",
+                  "scope", "calls", "total ms", "mean ns", "max ns");
+    out << line;
+    for (int id : order) {
+        const SiteTotals& s = sum[id];
+        if (s.calls == 0) continue;
+        std::snprintf(line, sizeof(line), "%-32s %12lld %12.2f %12.1f %12llu\n",
+                      r.siteNames[id], s.calls, double(s.totalNs) / 1e6,
+                      double(s.totalNs) / double(s.calls), (unsigned long long)s.maxNs);
+        out << line;
+    }
+
+    out << "\n";
+    std::snprintf(line, sizeof(line), "%-32s %12s\n", "counter", "total");
+    out << line;
+    for (size_t id = 0; id < sum.size(); ++id) {
+        if (sum[id].calls != 0 || sum[id].count == 0) continue;
+        std::snprintf(line, sizeof(line), "%-32s %12lld\n", r.siteNames[id], sum[id].count);
+        out << line;
+    }
+}
+
+void profileDump(const std::string& stem) {
+    ProfileRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    writeChromeTrace(stem + "_trace.json", r);
+    writeFlatProfile(stem + "_profile.txt", r);
+    std::cout << "profile written to " << stem << "_trace.json and "
+              << stem << "_profile.txt\n";
+}
+
+#endif
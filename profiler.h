@@ -0,0 +1,76 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+
+// scoped timers and counters for finding where training time goes
+//
+//   PROFILE_SCOPE("chooseAction");     // times the rest of the block
+//   PROFILE_COUNT("minimax/nodes", 1); // adds to a counter
+//
+// build with -DTTT_PROFILE to turn them on; without it the macros expand
+// to nothing and profileDump() does nothing, so probes can stay in the
+// code. when on, each thread records into its own ring buffer (the last
+// TTT_PROFILE_EVENTS scopes) and its own flat totals, with no locking on
+// the recording path. a scope costs a couple of clock reads, so probes
+// around very small functions inflate them - compare like with like
+
+// writes <stem>_trace.json (chrome://tracing or ui.perfetto.dev) and
+// <stem>_profile.txt (calls, total and mean time per probe, counters);
+// call once the threads being profiled have finished
+void profileDump(const std::string& stem);
+
+#ifdef TTT_PROFILE
+
+#include <cstdint>
+#include <chrono>
+
+#ifndef TTT_PROFILE_EVENTS
+#define TTT_PROFILE_EVENTS (1 << 18)
+#endif
+
+// one per probe site, registered the first time it is reached
+struct ProfileSite {
+    explicit ProfileSite(const char* name);
+    const char* name;
+    int id;
+};
+
+uint64_t profileNowNs();
+void profileRecordScope(const ProfileSite& site, uint64_t startNs, uint64_t endNs);
+void profileRecordCount(const ProfileSite& site, long long n);
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const ProfileSite& s) : site(s), start(profileNowNs()) {}
+    ~ProfileScope() { profileRecordScope(site, start, profileNowNs()); }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const ProfileSite& site;
+    uint64_t start;
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+
+#define PROFILE_SCOPE(name) \
+    static const ProfileSite PROFILE_CONCAT(profileSite_, __LINE__)(name); \
+    ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(PROFILE_CONCAT(profileSite_, __LINE__))
+
+#define PROFILE_COUNT(name, n) \
+    do { \
+        static const ProfileSite profileCountSite(name); \
+        profileRecordCount(profileCountSite, (n)); \
+    } while (0)
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_COUNT(name, n) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,243 @@
+#include "q_model.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include "position_table.h"
+#include "simd_kernels.h"
+#include "rng.h"
+#include "profiler.h"
+
+static const char kMagic[4] = { 'T', 'T', 'Q', 'N' };
+static const uint16_t kVersion = 1;
+static const size_t kHeaderSize = 16;
+static const int kMaxHidden = 256;
+
+// cells of the 8 lines: rows, columns, diagonals
+static const int kLineCells[8][3] = {
+    { 0, 1, 2 }, { 3, 4, 5 }, { 6, 7, 8 },
+    { 0, 3, 6 }, { 1, 4, 7 }, { 2, 5, 8 },
+    { 0, 4, 8 }, { 2, 4, 6 }
+};
+
+static int roundHidden(int hidden) {
+    return (std::max(4, std::min(kMaxHidden, hidden)) + 3) & ~3;
+}
+
+bool qModelConfigFromArgs(int argc, char** argv, QModelConfig& cfg) {
+    bool model = false;
+    for (int i = 1; i + 1 < argc; ++i) {
+        std::string arg = argv[i];
+        std::string value = argv[i + 1];
+        if (arg == "--q-backend") {
+            model = (value == "linear" || value == "mlp");
+            cfg.kind = (value == "mlp") ? QModelKind::Mlp : QModelKind::Linear;
+            if (!model && value != "table") {
+                std::cerr << "unknown --q-backend " << value << " (table, linear or mlp), using the table\n";
+            }
+        }
+        else if (arg == "--q-hidden") cfg.hidden = roundHidden(std::atoi(value.c_str()));
+        else if (arg == "--q-batch")  cfg.batch = std::max(1, std::atoi(value.c_str()));
+        else if (arg == "--q-lr")     cfg.learningRate = std::atof(value.c_str());
+    }
+    return model;
+}
+
+std::string qModelFile(const std::string& policyFile) {
+    return policyFile + ".qnet";
+}
+
+void qFeatures(int index, int player, float* out) {
+    std::fill(out, out + kQFeatures, 0.0f);
+    int owner[9];   // 0 empty, 1 mine, 2 theirs
+    for (int c = 0; c < 9; ++c) {
+        int d = (index / kPow3[c]) % 3;
+        owner[c] = (d == 0) ? 0 : (d == player) ? 1 : 2;
+    }
+    out[0] = 1.0f;
+    for (int c = 0; c < 9; ++c) {
+        out[1 + c * 3 + owner[c]] = 1.0f;
+    }
+    for (int l = 0; l < 8; ++l) {
+        int count[3] = { 0, 0, 0 };
+        for (int c : kLineCells[l]) count[owner[c]]++;
+        float* f = out + 28 + l * 5;
+        if (count[1] && count[2]) f[4] = 1.0f;
+        else if (count[1])        f[std::min(count[1], 2) - 1] = 1.0f;
+        else if (count[2])        f[2 + std::min(count[2], 2) - 1] = 1.0f;
+    }
+}
+
+QModel::QModel(const QModelConfig& config)
+    : cfg(config), hiddenUnits(roundHidden(config.hidden))
+{
+    cfg.hidden = hiddenUnits;
+    cfg.batch = std::max(1, cfg.batch);
+    initWeights();
+}
+
+// linear weights start at 0, as new table rows do; the MLP's first layer
+// is random (uniform, scaled by fan-in) so its units differ
+void QModel::initWeights() {
+    const int F = kQFeatures;
+    const int H = hiddenUnits;
+    size_t n = (cfg.kind == QModelKind::Linear) ? size_t(9 * F) : size_t(H * F + H + 9 * H + 9);
+    params.assign(n, 0.0f);
+    grads.assign(n, 0.0f);
+    batchX.assign(size_t(cfg.batch) * F, 0.0f);
+    batchAction.assign(cfg.batch, 0);
+    batchTarget.assign(cfg.batch, 0.0f);
+    queued = 0;
+    if (cfg.kind == QModelKind::Mlp) {
+        Rng rng = makeStream(nextStreamId());
+        float scale1 = float(std::sqrt(6.0 / F));
+        for (int i = 0; i < H * F; ++i) {
+            params[i] = scale1 * float(2.0 * rng.uniformReal() - 1.0);
+        }
+        float scale2 = float(0.1 * std::sqrt(6.0 / H));
+        float* w2 = params.data() + H * F + H;
+        for (int i = 0; i < 9 * H; ++i) {
+            w2[i] = scale2 * float(2.0 * rng.uniformReal() - 1.0);
+        }
+    }
+}
+
+void QModel::forward(const float* x, float* hidden, float* q) const {
+    const int F = kQFeatures;
+    const float* w = params.data();
+    if (cfg.kind == QModelKind::Linear) {
+        for (int a = 0; a < 9; ++a) {
+            q[a] = dotF(w + a * F, x, F);
+        }
+        return;
+    }
+    const int H = hiddenUnits;
+    const float* b1 = w + H * F;
+    const float* w2 = b1 + H;
+    const float* b2 = w2 + 9 * H;
+    for (int j = 0; j < H; ++j) {
+        hidden[j] = b1[j] + dotF(w + j * F, x, F);
+    }
+    reluF(hidden, H);
+    for (int a = 0; a < 9; ++a) {
+        q[a] = b2[a] + dotF(w2 + a * H, hidden, H);
+    }
+}
+
+void QModel::predict(const float* x, float* q) const {
+    float hidden[kMaxHidden];
+    forward(x, hidden, q);
+}
+
+void QModel::predictBatch(const float* x, int count, float* q) const {
+    PROFILE_SCOPE("QModel::predictBatch");
+    float hidden[kMaxHidden];
+    for (int i = 0; i < count; ++i) {
+        forward(x + size_t(i) * kQFeatures, hidden, q + size_t(i) * 9);
+    }
+}
+
+// adds the gradient of (Q(x, action) - target)^2 / 2 to grads
+void QModel::accumulate(const float* x, int action, float target) {
+    const int F = kQFeatures;
+    const int H = hiddenUnits;
+    float hidden[kMaxHidden];
+    float q[9];
+    forward(x, hidden, q);
+    float g = q[action] - target;
+    if (cfg.kind == QModelKind::Linear) {
+        axpyF(g, x, grads.data() + action * F, F);
+        return;
+    }
+    const float* w2 = params.data() + H * F + H;
+    float* gw1 = grads.data();
+    float* gb1 = gw1 + H * F;
+    float* gw2 = gb1 + H;
+    float* gb2 = gw2 + 9 * H;
+
+    // back through the output row of action, then the ReLU
+    float dh[kMaxHidden];
+    std::fill(dh, dh + H, 0.0f);
+    axpyF(g, w2 + action * H, dh, H);
+    axpyF(g, hidden, gw2 + action * H, H);
+    gb2[action] += g;
+    for (int j = 0; j < H; ++j) {
+        if (hidden[j] <= 0.0f) continue;
+        axpyF(dh[j], x, gw1 + j * F, F);
+        gb1[j] += dh[j];
+    }
+}
+
+void QModel::train(const float* x, int action, float target) {
+    std::copy(x, x + kQFeatures, batchX.data() + size_t(queued) * kQFeatures);
+    batchAction[queued] = action;
+    batchTarget[queued] = target;
+    if (++queued == cfg.batch) {
+        flush();
+    }
+}
+
+void QModel::flush() {
+    if (queued == 0) {
+        return;
+    }
+    PROFILE_SCOPE("QModel::sgdStep");
+    for (int i = 0; i < queued; ++i) {
+        accumulate(batchX.data() + size_t(i) * kQFeatures, batchAction[i], batchTarget[i]);
+    }
+    int n = int(params.size());
+    axpyF(-float(cfg.learningRate) / float(queued), grads.data(), params.data(), n);
+    std::fill(grads.begin(), grads.end(), 0.0f);
+    queued = 0;
+}
+
+size_t QModel::bytes() const {
+    return (params.capacity() + grads.capacity() + batchX.capacity() + batchTarget.capacity()) * sizeof(float)
+         + batchAction.capacity() * sizeof(int);
+}
+
+std::string QModel::serialize() const {
+    std::string out(kHeaderSize, '\0');
+    uint8_t kind = (cfg.kind == QModelKind::Mlp) ? 2 : 1;
+    uint32_t features = kQFeatures;
+    uint32_t hidden = uint32_t(hiddenUnits);
+    std::memcpy(&out[0], kMagic, 4);
+    std::memcpy(&out[4], &kVersion, 2);
+    out[6] = char(kind);
+    std::memcpy(&out[8], &features, 4);
+    std::memcpy(&out[12], &hidden, 4);
+    out.append(reinterpret_cast<const char*>(params.data()), params.size() * sizeof(float));
+    return out;
+}
+
+bool QModel::deserialize(const std::string& bytes, std::string& error) {
+    uint16_t version = 0;
+    uint32_t features = 0;
+    uint32_t hidden = 0;
+    if (bytes.size() < kHeaderSize || std::memcmp(bytes.data(), kMagic, 4) != 0) {
+        error = "not a Q model";
+        return false;
+    }
+    std::memcpy(&version, &bytes[4], 2);
+    std::memcpy(&features, &bytes[8], 4);
+    std::memcpy(&hidden, &bytes[12], 4);
+    uint8_t kind = uint8_t(bytes[6]);
+    if (version != kVersion || features != uint32_t(kQFeatures) || (kind != 1 && kind != 2)
+        || int(hidden) != roundHidden(int(hidden))) {
+        error = "unsupported Q model version or shape";
+        return false;
+    }
+    QModelConfig next = cfg;
+    next.kind = (kind == 2) ? QModelKind::Mlp : QModelKind::Linear;
+    next.hidden = int(hidden);
+    QModel shaped(next);
+    if (bytes.size() != kHeaderSize + shaped.params.size() * sizeof(float)) {
+        error = "Q model is truncated";
+        return false;
+    }
+    std::memcpy(shaped.params.data(), bytes.data() + kHeaderSize, shaped.params.size() * sizeof(float));
+    *this = std::move(shaped);
+    return true;
+}
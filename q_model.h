@@ -0,0 +1,90 @@
+#ifndef Q_MODEL_H
+#define Q_MODEL_H
+
+#include <string>
+#include <vector>
+
+// Q(s, .) computed from board features instead of looked up, for
+// QLearningAgent::setModel: a linear model or a one-hidden-layer MLP.
+// memory is the weights, whatever the number of states seen
+//
+// features are from the point of view of one player ("mine"):
+//   1         bias
+//   27        each cell empty / mine / theirs
+//   8 x 5     each line: 1 or 2 of mine only, 1 or 2 of theirs only, both
+constexpr int kQFeatures = 68;
+
+enum class QModelKind {
+    Linear,
+    Mlp
+};
+
+struct QModelConfig {
+    QModelKind kind = QModelKind::Linear;
+    int hidden = 32;               // MLP hidden units, rounded up to a multiple of 4
+    int batch = 32;                // targets per SGD step
+    double learningRate = 0.01;
+};
+
+// reads --q-backend table|linear|mlp, --q-hidden N, --q-batch N and
+// --q-lr X from argv; false if the backend is the table (the default)
+bool qModelConfigFromArgs(int argc, char** argv, QModelConfig& cfg);
+
+// weights file kept next to a policy: q_policy.dat => q_policy.dat.qnet
+std::string qModelFile(const std::string& policyFile);
+
+// features of a 3x3 position index for player
+void qFeatures(int index, int player, float* out);
+
+class QModel {
+public:
+    explicit QModel(const QModelConfig& config);
+
+    const QModelConfig& config() const { return cfg; }
+
+    // q[0..9) for one feature vector
+    void predict(const float* x, float* q) const;
+
+    // count feature vectors of kQFeatures, q gets 9 values for each
+    void predictBatch(const float* x, int count, float* q) const;
+
+    // queues Q(x, action) -> target; every config().batch targets the
+    // weights take one step down the mean squared error
+    void train(const float* x, int action, float target);
+
+    // takes a step on whatever is queued
+    void flush();
+
+    size_t parameterCount() const { return params.size(); }
+
+    // heap bytes held: weights, gradients and the queued batch
+    size_t bytes() const;
+
+    // "TTQN", u16 version, u8 kind, u8 reserved, u32 features, u32 hidden,
+    // then every weight as a float
+    std::string serialize() const;
+
+    // replaces the config's shape and the weights; false, with the reason
+    // in error, if bytes is not a model this build can read
+    bool deserialize(const std::string& bytes, std::string& error);
+
+private:
+    void initWeights();
+    void forward(const float* x, float* hidden, float* q) const;
+    void accumulate(const float* x, int action, float target);
+
+    QModelConfig cfg;
+    int hiddenUnits;
+
+    // linear: W[9][F]
+    // mlp:    W1[H][F], b1[H], W2[9][H], b2[9]
+    std::vector<float> params;
+    std::vector<float> grads;
+
+    std::vector<float> batchX;
+    std::vector<int> batchAction;
+    std::vector<float> batchTarget;
+    int queued = 0;
+};
+
+#endif
@@ -1,18 +1,65 @@
 #include "qlearning.h"
 #include <iostream>
 #include <fstream>
-#include <cstdlib> 
 #include <cstdint>   
-#include <ctime>
 #include <algorithm>
 #include <limits>
+#include <cmath>
+#include <iterator>
 #include "minimax.h" 
+#include "position_table.h"
+#include "profiler.h"
+#include "simd_kernels.h"
+
+const char* updateModeName(UpdateMode mode) {
+    switch (mode) {
+    case UpdateMode::QLambda:    return "qlambda";
+    case UpdateMode::MonteCarlo: return "mc";
+    default:                     return "one-step";
+    }
+}
+
+bool parseUpdateMode(const std::string& name, UpdateMode& mode) {
+    if (name == "one-step")     mode = UpdateMode::OneStep;
+    else if (name == "qlambda") mode = UpdateMode::QLambda;
+    else if (name == "mc")      mode = UpdateMode::MonteCarlo;
+    else return false;
+    return true;
+}
 
 QLearningAgent::QLearningAgent(double alpha_, double gamma_, double epsilon_)
-    : alpha(alpha_), gamma(gamma_), epsilon(epsilon_)
+    : rowAt(kNumPositions, nullptr),
+      alpha(alpha_), gamma(gamma_), epsilon(epsilon_),
+      rng(makeStream(nextStreamId()))
 {
+}
+
+std::array<double, 9>& QLearningAgent::tableRow(const std::string& stateStr) {
+    auto it = Q.find(stateStr);
+    if (it == Q.end()) {
+        it = Q.emplace(stateStr, std::array<double, 9>{}).first;
+        int index = positionIndexFromString(stateStr);
+        if (index >= 0) {
+            rowAt[index] = &it->second;
+        }
+    }
+    return it->second;
+}
+
+std::array<double, 9>& QLearningAgent::tableRow(int index) {
+    if (!rowAt[index]) {
+        rowAt[index] = &Q.emplace(positionString(index), std::array<double, 9>{}).first->second;
+    }
+    return *rowAt[index];
+}
+
+void QLearningAgent::setRow(const std::string& stateStr, const std::array<double, 9>& qvals) {
+    tableRow(stateStr) = qvals;
+}
 
-    std::srand(static_cast<unsigned>(std::time(nullptr)));
+void QLearningAgent::clearTable() {
+    Q.clear();
+    std::fill(rowAt.begin(), rowAt.end(), nullptr);
 }
 
 
@@ -26,6 +73,7 @@ void QLearningAgent::fromActionIndex(int action, int &x, int &y) {
 }
 
 std::string QLearningAgent::encodeBoard(const Board& board) const {
+    PROFILE_SCOPE("QLearningAgent::encodeBoard");
     std::string result;
     result.reserve(9);
     for (int y = 2; y >= 0; --y) {
@@ -37,35 +85,33 @@ std::string QLearningAgent::encodeBoard(const Board& board) const {
 }
 
 int QLearningAgent::chooseAction(const TicTacToe& game) {
-    std::string stateStr = encodeBoard(game.getBoard());
-    auto it = Q.find(stateStr);
-    if (it == Q.end()) {
-        Q[stateStr] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
-        it = Q.find(stateStr);
+    PROFILE_SCOPE("QLearningAgent::chooseAction");
+    if (model) {
+        return chooseModelAction(game.positionIndex());
     }
-    std::array<double, 9>& qvals = it->second;
+    int index = game.positionIndex();
+    std::array<double, 9>& qvals = tableRow(index);
 
-    std::vector<int> validMoves;
-    for (int action = 0; action < 9; ++action) {
-        int x, y;
-        fromActionIndex(action, x, y);
-        if (game.isValidMove(x, y)) {
-            validMoves.push_back(action);
-        }
-    }
-    if (validMoves.empty()) {
+    // bit a set if action a is playable
+    unsigned legal = positionInfo(index).legalMoves;
+    if (legal == 0) {
         return -1;
     }
 
-    double r = double(std::rand()) / RAND_MAX;
+    double r = rng.uniformReal();
     if (r < epsilon) {
-        int idx = std::rand() % validMoves.size();
-        return validMoves[idx];
+        // Watkins: what follows an exploratory move says nothing about
+        // the greedy policy before it
+        if (updateMode == UpdateMode::QLambda) {
+            traces.clear();
+        }
+        int idx = rng.uniformInt(moveCount(legal));
+        return nthMove(legal, idx);
     } else {
         double bestVal = -std::numeric_limits<double>::infinity();
-        int bestAction = validMoves[0];
-        for (int a : validMoves) {
-            if (qvals[a] > bestVal) {
+        int bestAction = -1;
+        for (int a = 0; a < 9; ++a) {
+            if (((legal >> a) & 1) && (bestAction < 0 || qvals[a] > bestVal)) {
                 bestVal = qvals[a];
                 bestAction = a;
             }
@@ -74,24 +120,102 @@ int QLearningAgent::chooseAction(const TicTacToe& game) {
     }
 }
 
-void QLearningAgent::updateQ(const std::string& stateStr, int action,
+void QLearningAgent::chooseActions(const uint16_t* positions, int count, int8_t* actions) {
+    PROFILE_SCOPE("QLearningAgent::chooseActions");
+    std::vector<const double*> rows(model ? 0 : count);
+    std::vector<int> greedy;
+    greedy.reserve(count);
+
+    // exploration draws in board order, as chooseAction makes them
+    for (int i = 0; i < count; ++i) {
+        int index = positions[i];
+        if (!model) {
+            // chooseAction adds the row whatever happens next
+            rows[i] = tableRow(index).data();
+        }
+        unsigned legal = positionInfo(index).legalMoves;
+        if (legal == 0) {
+            actions[i] = -1;
+        } else if (rng.uniformReal() < epsilon) {
+            actions[i] = int8_t(nthMove(legal, rng.uniformInt(moveCount(legal))));
+        } else {
+            greedy.push_back(i);
+        }
+    }
+
+    if (!model) {
+        int n = int(greedy.size());
+        for (int k = 0; k < n; ++k) {
+            if (k + kPrefetchAhead < n) {
+                prefetchRead(rows[greedy[k + kPrefetchAhead]]);
+            }
+            int i = greedy[k];
+            actions[i] = int8_t(argmaxLegal(rows[i], positionInfo(positions[i]).legalMoves));
+        }
+        return;
+    }
+
+    // every greedy board through the model in one batch
+    std::vector<float> x(greedy.size() * kQFeatures);
+    std::vector<float> q(greedy.size() * 9);
+    for (size_t k = 0; k < greedy.size(); ++k) {
+        int index = positions[greedy[k]];
+        qFeatures(index, positionInfo(index).toMove, x.data() + k * kQFeatures);
+    }
+    model->predictBatch(x.data(), int(greedy.size()), q.data());
+    for (size_t k = 0; k < greedy.size(); ++k) {
+        double row[9];
+        std::copy(q.begin() + k * 9, q.begin() + k * 9 + 9, row);
+        actions[greedy[k]] = int8_t(argmaxLegal(row, positionInfo(positions[greedy[k]]).legalMoves));
+    }
+}
+
+void QLearningAgent::qValues(const uint16_t* positions, int count, double* values) const {
+    PROFILE_SCOPE("QLearningAgent::qValues");
+    if (model) {
+        std::vector<float> x(size_t(count) * kQFeatures);
+        std::vector<float> q(size_t(count) * 9);
+        for (int i = 0; i < count; ++i) {
+            qFeatures(positions[i], positionInfo(positions[i]).toMove, x.data() + size_t(i) * kQFeatures);
+        }
+        model->predictBatch(x.data(), count, q.data());
+        std::copy(q.begin(), q.end(), values);
+        return;
+    }
+    for (int i = 0; i < count; ++i) {
+        if (i + kPrefetchAhead < count && rowAt[positions[i + kPrefetchAhead]]) {
+            prefetchRead(rowAt[positions[i + kPrefetchAhead]]->data());
+        }
+        const std::array<double, 9>* row = rowAt[positions[i]];
+        double* out = values + size_t(i) * 9;
+        if (row) {
+            std::copy(row->begin(), row->end(), out);
+        } else {
+            std::fill(out, out + 9, 0.0);
+        }
+    }
+}
+
+double QLearningAgent::updateQ(const std::string& stateStr, int action,
                              const std::string& nextStateStr,
                              double reward, bool terminal)
 {
-    if (Q.find(stateStr) == Q.end()) {
-        Q[stateStr] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    PROFILE_SCOPE("QLearningAgent::updateQ");
+    if (model && updateMode != UpdateMode::MonteCarlo) {
+        return updateModel(stateStr, action, nextStateStr, reward, terminal);
     }
-    double currentQ = Q[stateStr][action];
+    if (updateMode != UpdateMode::OneStep) {
+        return updateTraced(stateStr, action, nextStateStr, reward, terminal);
+    }
+    std::array<double, 9>& row = tableRow(stateStr);
+    double currentQ = row[action];
 
     double tdTarget;
     if (terminal) {
         tdTarget = reward;
     } else {
-        if (Q.find(nextStateStr) == Q.end()) {
-            Q[nextStateStr] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
-        }
         double bestNext = -std::numeric_limits<double>::infinity();
-        for (double qv : Q[nextStateStr]) {
+        for (double qv : tableRow(nextStateStr)) {
             if (qv > bestNext) {
                 bestNext = qv;
             }
@@ -99,43 +223,324 @@ void QLearningAgent::updateQ(const std::string& stateStr, int action,
         tdTarget = reward + gamma * bestNext;
     }
     double tdError = tdTarget - currentQ;
-    Q[stateStr][action] += alpha * tdError;
+    row[action] += alpha * tdError;
+    if (deltaLog) {
+        int index = positionIndexFromString(stateStr);
+        if (index >= 0) {
+            deltaLog->push_back({ uint16_t(index), uint8_t(action), 0, float(alpha * tdError) });
+        }
+    }
+
+    updateStats.updates++;
+    updateStats.absTdError += std::fabs(tdError);
+    return tdError;
 }
 
-void QLearningAgent::savePolicy(const std::string& filename) const {
-    std::ofstream out(filename, std::ios::out | std::ios::binary);
-    if (!out) {
-        std::cerr << "could not open " << filename << " to write\n";
-        return;
+double QLearningAgent::updateTraced(const std::string& stateStr, int action,
+                                    const std::string& nextStateStr,
+                                    double reward, bool terminal) {
+    std::array<double, 9>* row = model ? nullptr : &tableRow(stateStr);
+    // older state-actions fade before this one joins at full eligibility
+    if (updateMode == UpdateMode::QLambda) {
+        for (Trace& t : traces) {
+            t.eligibility *= gamma * lambda;
+        }
+    }
+    traces.push_back({ row, positionIndexFromString(stateStr), action, 1.0, reward });
+    if (updateMode == UpdateMode::MonteCarlo) {
+        return terminal ? monteCarloBackup() : 0.0;
     }
 
-    uint64_t size = Q.size();
-    out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    // QLambda: the one-step TD error, spread over the traces
+    double tdTarget = reward;
+    if (!terminal) {
+        double bestNext = -std::numeric_limits<double>::infinity();
+        for (double qv : tableRow(nextStateStr)) {
+            bestNext = std::max(bestNext, qv);
+        }
+        tdTarget += gamma * bestNext;
+    }
+    double tdError = tdTarget - (*row)[action];
+    applyTraces(tdError);
+    if (terminal) {
+        traces.clear();
+    }
+    return tdError;
+}
 
-    for (auto const &kv : Q) {
-        const std::string& state = kv.first;
-        const std::array<double, 9>& qvals = kv.second;
+// Q += alpha * tdError * eligibility for every trace
+void QLearningAgent::applyTraces(double tdError) {
+    for (Trace& t : traces) {
+        double dq = alpha * tdError * t.eligibility;
+        (*t.row)[t.action] += dq;
+        if (deltaLog && t.state >= 0) {
+            deltaLog->push_back({ uint16_t(t.state), uint8_t(t.action), 0, float(dq) });
+        }
+    }
+    updateStats.updates++;
+    updateStats.absTdError += std::fabs(tdError);
+}
+
+// every kept state-action moves towards its discounted return, last
+// first; returns the error of the terminal one
+double QLearningAgent::monteCarloBackup() {
+    double ret = 0.0;
+    double lastError = 0.0;
+    for (size_t i = traces.size(); i-- > 0;) {
+        const Trace& t = traces[i];
+        ret = t.reward + gamma * ret;
+        double error;
+        if (model) {
+            if (t.state < 0) {
+                continue;
+            }
+            float x[kQFeatures];
+            float q[9];
+            qFeatures(t.state, positionInfo(t.state).toMove, x);
+            model->predict(x, q);
+            error = ret - double(q[t.action]);
+            model->train(x, t.action, float(ret));
+        } else {
+            error = ret - (*t.row)[t.action];
+            (*t.row)[t.action] += alpha * error;
+            if (deltaLog && t.state >= 0) {
+                deltaLog->push_back({ uint16_t(t.state), uint8_t(t.action), 0, float(alpha * error) });
+            }
+        }
+        if (i + 1 == traces.size()) {
+            lastError = error;
+        }
+        updateStats.updates++;
+        updateStats.absTdError += std::fabs(error);
+    }
+    traces.clear();
+    return lastError;
+}
+
+void QLearningAgent::setUpdateMode(UpdateMode mode, double lambda_) {
+    if (mode == UpdateMode::QLambda && model && updateMode != mode) {
+        std::cerr << "qlambda is not traced through a model, backing up one step\n";
+    }
+    updateMode = mode;
+    lambda = lambda_;
+    traces.clear();
+}
+
+void QLearningAgent::setModel(const QModelConfig& cfg) {
+    traces.clear();
+    clearTable();
+    model.reset(new QModel(cfg));
+}
+
+void QLearningAgent::flushUpdates() {
+    if (model) {
+        model->flush();
+    }
+}
+
+int QLearningAgent::chooseModelAction(int index) {
+    const PositionInfo& info = positionInfo(index);
+    unsigned legal = info.legalMoves;
+    if (legal == 0) {
+        return -1;
+    }
+    if (rng.uniformReal() < epsilon) {
+        return nthMove(legal, rng.uniformInt(moveCount(legal)));
+    }
+    float x[kQFeatures];
+    float q[9];
+    qFeatures(index, info.toMove, x);
+    model->predict(x, q);
+    int bestAction = -1;
+    for (int a = 0; a < 9; ++a) {
+        if (((legal >> a) & 1) && (bestAction < 0 || q[a] > q[bestAction])) {
+            bestAction = a;
+        }
+    }
+    return bestAction;
+}
+
+double QLearningAgent::updateModel(const std::string& stateStr, int action,
+                                   const std::string& nextStateStr,
+                                   double reward, bool terminal) {
+    int index = positionIndexFromString(stateStr);
+    if (index < 0) {
+        return 0.0;
+    }
+    int player = positionInfo(index).toMove;
+    float x[kQFeatures];
+    float q[9];
+    qFeatures(index, player, x);
+    model->predict(x, q);
+
+    double tdTarget = reward;
+    int next = terminal ? -1 : positionIndexFromString(nextStateStr);
+    if (next >= 0 && positionInfo(next).legalMoves != 0) {
+        // the next state is valued from the same player's side, as a table row would be
+        float nx[kQFeatures];
+        float nq[9];
+        qFeatures(next, player, nx);
+        model->predict(nx, nq);
+        unsigned legal = positionInfo(next).legalMoves;
+        double bestNext = -std::numeric_limits<double>::infinity();
+        for (int a = 0; a < 9; ++a) {
+            if ((legal >> a) & 1) bestNext = std::max(bestNext, double(nq[a]));
+        }
+        tdTarget = reward + gamma * bestNext;
+    }
+    double tdError = tdTarget - double(q[action]);
+    model->train(x, action, float(tdTarget));
+
+    updateStats.updates++;
+    updateStats.absTdError += std::fabs(tdError);
+    return tdError;
+}
+
+QUpdateStats QLearningAgent::takeUpdateStats() {
+    QUpdateStats taken = updateStats;
+    updateStats = QUpdateStats();
+    return taken;
+}
+
+QTableStats QLearningAgent::tableStats() const {
+    QTableStats stats;
+    if (model) {
+        stats.bytes = model->bytes();
+        return stats;
+    }
+    stats.states = Q.size();
+    stats.buckets = Q.bucket_count();
+    stats.loadFactor = Q.load_factor();
+    // a node holds the key/value pair, a next pointer and the cached hash;
+    // 9-char keys fit std::string's inline buffer, so no extra allocation
+    size_t node = sizeof(std::pair<const std::string, std::array<double, 9>>)
+                + 2 * sizeof(void*);
+    stats.bytes = stats.states * node + stats.buckets * sizeof(void*);
+    return stats;
+}
+
+std::string serializePolicy(const std::vector<PolicyEntry>& entries) {
+    // u64 count, then per row: u64 length, state chars, 9 doubles
+    const size_t rowBytes = sizeof(uint64_t) + 9 + 9 * sizeof(double);
+    std::string buffer;
+    buffer.reserve(sizeof(uint64_t) + entries.size() * rowBytes);
+
+    uint64_t size = entries.size();
+    buffer.append(reinterpret_cast<const char*>(&size), sizeof(size));
 
-        uint64_t len = state.size();
-        out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+    for (const PolicyEntry& e : entries) {
+        uint64_t len = 9;
+        buffer.append(reinterpret_cast<const char*>(&len), sizeof(len));
+        buffer.append(e.state, 9);
+        buffer.append(reinterpret_cast<const char*>(e.qvals.data()), 9 * sizeof(double));
+    }
+    return buffer;
+}
 
-        out.write(state.data(), len);
+void QLearningAgent::copyTable(std::vector<PolicyEntry>& out) const {
+    PROFILE_SCOPE("QLearningAgent::copyTable");
+    out.clear();
+    if (model) {
+        // every playable position through the model, a block at a time
+        const int kBlock = 256;
+        std::vector<int> indices;
+        for (int index = 0; index < kNumPositions; ++index) {
+            if (isPlayablePosition(index)) indices.push_back(index);
+        }
+        std::vector<float> x(size_t(kBlock) * kQFeatures);
+        std::vector<float> q(size_t(kBlock) * 9);
+        out.reserve(indices.size());
+        for (size_t begin = 0; begin < indices.size(); begin += kBlock) {
+            int count = int(std::min(indices.size() - begin, size_t(kBlock)));
+            for (int i = 0; i < count; ++i) {
+                int index = indices[begin + i];
+                qFeatures(index, positionInfo(index).toMove, x.data() + size_t(i) * kQFeatures);
+            }
+            model->predictBatch(x.data(), count, q.data());
+            for (int i = 0; i < count; ++i) {
+                int index = indices[begin + i];
+                unsigned legal = positionInfo(index).legalMoves;
+                PolicyEntry e;
+                positionString(index).copy(e.state, 9);
+                for (int a = 0; a < 9; ++a) {
+                    e.qvals[a] = ((legal >> a) & 1) ? double(q[size_t(i) * 9 + a]) : 0.0;
+                }
+                out.push_back(e);
+            }
+        }
+        return;
+    }
+    out.reserve(Q.size());
+    for (auto const &kv : Q) {
+        if (kv.first.size() != 9) {
+            continue;
+        }
+        PolicyEntry e;
+        kv.first.copy(e.state, 9);
+        e.qvals = kv.second;
+        out.push_back(e);
+    }
+}
+
+void QLearningAgent::mergeRows(const std::vector<PolicyEntry>& rows) {
+    for (const PolicyEntry& e : rows) {
+        setRow(std::string(e.state, 9), e.qvals);
+    }
+}
 
-        out.write(reinterpret_cast<const char*>(qvals.data()), 9 * sizeof(double));
+void QLearningAgent::savePolicy(const std::string& filename) const {
+    PROFILE_SCOPE("QLearningAgent::savePolicy");
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    if (!out) {
+        std::cerr << "could not open " << filename << " to write\n";
+        return;
     }
 
+    std::vector<PolicyEntry> entries;
+    copyTable(entries);
+    std::string buffer = serializePolicy(entries);
+    out.write(buffer.data(), buffer.size());
+
     out.close();
     std::cout << "saved q-policy to " << filename << std::endl;
+
+    if (model) {
+        std::string weights = qModelFile(filename);
+        std::ofstream weightsOut(weights, std::ios::out | std::ios::binary);
+        std::string bytes = model->serialize();
+        if (!weightsOut.write(bytes.data(), bytes.size())) {
+            std::cerr << "could not write " << weights << "\n";
+        }
+    }
 }
 
-void QLearningAgent::loadPolicy(const std::string& filename) {
+bool QLearningAgent::loadPolicy(const std::string& filename) {
+    PROFILE_SCOPE("QLearningAgent::loadPolicy");
+    if (model) {
+        // the weights, not the exported table
+        std::string weights = qModelFile(filename);
+        std::ifstream in(weights, std::ios::in | std::ios::binary);
+        if (!in) {
+            std::cerr << "could not open " << weights << " for reading\n";
+            return false;
+        }
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::string error;
+        if (!model->deserialize(bytes, error)) {
+            std::cerr << weights << ": " << error << "\n";
+            return false;
+        }
+        std::cout << "loaded q-model: " << weights << std::endl;
+        return true;
+    }
     std::ifstream in(filename, std::ios::in | std::ios::binary);
     if (!in) {
         std::cerr << "could not open " << filename << " for reading\n";
-        return;
+        return false;
     }
 
-    Q.clear();
+    traces.clear();
+    clearTable();
 
     uint64_t size = 0;
     in.read(reinterpret_cast<char*>(&size), sizeof(size));
@@ -150,13 +555,18 @@ void QLearningAgent::loadPolicy(const std::string& filename) {
         std::array<double, 9> qvals;
         in.read(reinterpret_cast<char*>(qvals.data()), 9 * sizeof(double));
 
-        Q[state] = qvals;
+        setRow(state, qvals);
     }
 
     in.close();
     std::cout << "loaded q-policy: " << filename << std::endl;
+    return true;
 }
 
 void QLearningAgent::clearPolicy() {
-    Q.clear();
+    traces.clear();
+    clearTable();
+    if (model) {
+        model.reset(new QModel(model->config()));
+    }
 }
@@ -2,11 +2,69 @@
 #define QLEARNING_H
 
 #include <string>
+#include <cstdint>
 #include <unordered_map>
 #include <array>
+#include <vector>
+#include <memory>
 #include "tic_tac_toe.h"
+#include "rng.h"
+#include "q_model.h"
+
+// one Q-table row in flat form, cheap to copy in bulk
+struct PolicyEntry {
+    char state[9];                 // encodeBoard string, no terminator
+    std::array<double, 9> qvals;
+};
+
+// .dat file contents for a list of rows, built in memory so the
+// file can be written with a single call
+std::string serializePolicy(const std::vector<PolicyEntry>& entries);
+
+// one table update as applied, Q(state, action) += dq; state is the
+// position index. for shipping updates to a parameter server
+struct QDelta {
+    uint16_t state;
+    uint8_t action;
+    uint8_t reserved;
+    float dq;
+};
+
+// counters for telemetry, kept by the agent so the training loop
+// only has to read them now and then
+struct QUpdateStats {
+    long long updates = 0;
+    double absTdError = 0.0;   // sum of |TD error| over those updates
+};
+
+// how updateQ turns the transitions of an episode into changes to Q
+enum class UpdateMode {
+    OneStep,      // Q-learning, each transition backs up one step (the default)
+    QLambda,      // Watkins Q(lambda): each TD error also reaches the earlier
+                  // state-actions of the episode, scaled by (gamma lambda)^k;
+                  // the traces are cut after an exploratory move
+    MonteCarlo    // transitions are kept until the terminal one, then every
+                  // state-action of the episode moves towards its return
+};
+
+// "one-step", "qlambda", "mc"
+const char* updateModeName(UpdateMode mode);
+bool parseUpdateMode(const std::string& name, UpdateMode& mode);
+
+// size of the Q-table and the hash map behind it
+struct QTableStats {
+    size_t states = 0;
+    size_t buckets = 0;
+    double loadFactor = 0.0;
+    size_t bytes = 0;          // estimate: nodes, keys and bucket array
+};
 
 // each board state stored as string, along with 9 q-values for 9 possible moves
+//
+// with setModel, Q comes from a QModel over board features instead and
+// there is no table; copyTable and savePolicy then write the model's
+// values for every playable position, so the .dat still works wherever
+// a table is read, and savePolicy keeps the weights in <file>.qnet
 class QLearningAgent {
 public:
     QLearningAgent(double alpha=0.1, double gamma=1.0, double epsilon=0.2);
@@ -14,33 +72,134 @@ public:
     // epsilon-greedy, returns action or -1
     int chooseAction(const TicTacToe& game);
 
-    // q-learning update
+    // chooseAction for many boards at once, given as position indices:
+    // actions[i] is what chooseAction would return for positions[i], with
+    // the same exploration draws in the same order. rows are found by
+    // position index, without building a string, and the greedy moves are
+    // taken after every row has been found, prefetching rows a few boards
+    // ahead; with a model they are one predictBatch
+    void chooseActions(const uint16_t* positions, int count, int8_t* actions);
+
+    // Q(s, .) for many boards: 9 values per board into values. rows the
+    // table has not seen read as 0 and are not added
+    void qValues(const uint16_t* positions, int count, double* values) const;
+
+    // q-learning update, returns the TD error
     //   Q(s,a) <- Q(s,a) + alpha [ r + gamma * max_a'( Q(s', a') ) - Q(s,a) ]
-    void updateQ(const std::string& stateStr, int action,
+    // in the other update modes the transitions of one episode are
+    // expected in order, ending with the terminal one
+    double updateQ(const std::string& stateStr, int action,
                  const std::string& nextStateStr,
                  double reward, bool terminal);
 
+    // lambda is only used by QLambda. with a model QLambda backs up one
+    // step, MonteCarlo trains the model on the returns
+    void setUpdateMode(UpdateMode mode, double lambda = 0.8);
+    UpdateMode getUpdateMode() const { return updateMode; }
+    double getLambda() const { return lambda; }
+
+    // drops the traces (or the kept transitions) of an episode that
+    // ended without a terminal update
+    void endEpisode() { traces.clear(); }
+
     // convert (x, y) to [0...8] or vice-versa
     static int toActionIndex(int x, int y);
     static void fromActionIndex(int action, int &x, int &y);
 
     void savePolicy(const std::string& filename) const;
 
-    void loadPolicy(const std::string& filename);
+    // returns false if the file could not be opened
+    bool loadPolicy(const std::string& filename);
 
     void clearPolicy();
 
+    // switches to a function approximation backend, with fresh weights
+    void setModel(const QModelConfig& cfg);
+    const QModel* getModel() const { return model.get(); }
+
+    // applies any targets the model still has queued
+    void flushUpdates();
+
+    // update counters since the last call, then resets them
+    QUpdateStats takeUpdateStats();
+
+    QTableStats tableStats() const;
+
+    // copies every row of the table into out (replacing its contents)
+    void copyTable(std::vector<PolicyEntry>& out) const;
+
+    // replaces (or adds) these rows of the table
+    void mergeRows(const std::vector<PolicyEntry>& rows);
+
+    // every table update from updateQ is also appended to log, until
+    // called again with nullptr
+    void setDeltaLog(std::vector<QDelta>* log) { deltaLog = log; }
+
     void setEpsilon(double e) { epsilon = e; }
+    void setAlpha(double a) { alpha = a; }
+    void setGamma(double g) { gamma = g; }
+
+    double getEpsilon() const { return epsilon; }
+    double getAlpha() const { return alpha; }
+    double getGamma() const { return gamma; }
+
+    // exploration draws come from this stream, see rng.h
+    Rng& getRng() { return rng; }
+    const Rng& getRng() const { return rng; }
+    void setRng(const Rng& r) { rng = r; }
 
     std::string encodeBoard(const Board& board) const;
 
 private:
     std::unordered_map<std::string, std::array<double, 9>> Q;
+    // Q's row for each position index, nullptr if the table has none.
+    // rows keep their address when the map rehashes
+    std::vector<std::array<double, 9>*> rowAt;
+
+    // the row for a state, added (as zeros) if the table has none
+    std::array<double, 9>& tableRow(const std::string& stateStr);
+    std::array<double, 9>& tableRow(int index);
+    // Q[stateStr] = qvals, keeping rowAt up to date
+    void setRow(const std::string& stateStr, const std::array<double, 9>& qvals);
+    void clearTable();
+    std::unique_ptr<QModel> model;
+
+    // chooseAction and updateQ with a model; values are from the point
+    // of view of the player to move in the state acted on
+    int chooseModelAction(int index);
+    double updateModel(const std::string& stateStr, int action,
+                       const std::string& nextStateStr, double reward, bool terminal);
+
+    // updateQ in the QLambda and MonteCarlo modes
+    double updateTraced(const std::string& stateStr, int action,
+                        const std::string& nextStateStr, double reward, bool terminal);
+    double monteCarloBackup();
+    void applyTraces(double tdError);
 
     // hyperparameters
     double alpha;  
     double gamma;  
     double epsilon; 
+
+    Rng rng;
+
+    UpdateMode updateMode = UpdateMode::OneStep;
+    double lambda = 0.8;
+
+    // a state-action of the current episode: its row (nullptr with a
+    // model; rows keep their address when the map rehashes), its
+    // eligibility for QLambda and its reward for MonteCarlo
+    struct Trace {
+        std::array<double, 9>* row;
+        int state;
+        int action;
+        double eligibility;
+        double reward;
+    };
+    std::vector<Trace> traces;   // at most 5, the moves of one side
+
+    QUpdateStats updateStats;
+    std::vector<QDelta>* deltaLog = nullptr;
 };
 
 #endif
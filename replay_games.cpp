@@ -0,0 +1,154 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "tic_tac_toe.h"
+#include "position_table.h"
+#include "game_record.h"
+#include "outcome_stats.h"
+
+// reads a game log written by matchup or a trainer (--record), filters
+// it and summarises it
+//
+//   replay_games file.tttg [--winner 0|1|2] [--opening cell] [--length n]
+//                          [--show n] [--top n]
+//
+// cell and action numbers are y*3 + x, as in the Q-table
+//
+// reported: results, game lengths, results by opening move, and the
+// positions most often left to the winner just before the winning move
+
+struct GameFilter {
+    int winner = -1;
+    int opening = -1;
+    int length = -1;
+
+    bool matches(const GameRecord& g) const {
+        if (winner >= 0 && g.winner != winner) return false;
+        if (length >= 0 && g.count != length) return false;
+        if (opening >= 0 && (g.count == 0 || g.moves[0] != opening)) return false;
+        return true;
+    }
+};
+
+static void printGame(const GameRecord& g) {
+    int position = 0;
+    int player = 1;
+    std::cout << "  moves:";
+    for (int i = 0; i < g.count; ++i) {
+        std::cout << " (" << g.moves[i] % 3 << "," << g.moves[i] / 3 << ")";
+        position += player * kPow3[g.moves[i]];
+        player = 3 - player;
+    }
+    std::cout << (g.winner ? "  player " + std::to_string(g.winner) + " wins" : "  draw") << "\n";
+    TicTacToe::fromPositionIndex(position).printBoard();
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: replay_games file.tttg [--winner 0|1|2] [--opening cell] "
+                     "[--length n] [--show n] [--top n]\n";
+        return 1;
+    }
+    std::string filename = argv[1];
+    GameFilter filter;
+    int show = 0;
+    int top = 10;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        int value = std::atoi(argv[i + 1]);
+        if (arg == "--winner")       filter.winner = value;
+        else if (arg == "--opening") filter.opening = value;
+        else if (arg == "--length")  filter.length = value;
+        else if (arg == "--show")    show = value;
+        else if (arg == "--top")     top = value;
+        else {
+            std::cerr << "unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+
+    GameRecordFile file;
+    if (!file.open(filename)) {
+        return 1;
+    }
+
+    long long matched = 0;
+    OutcomeStats stats;
+    std::vector<long long> lossPositions(kNumPositions, 0);
+    int shown = 0;
+    long long seen = 0;
+
+    using namespace std::chrono;
+    auto start = steady_clock::now();
+    long long total = file.forEach([&](const GameRecord& g) {
+        seen++;
+        if (!filter.matches(g)) {
+            return;
+        }
+        matched++;
+        // replay up to the position before the last move, then the last move
+        int position = 0;
+        for (int i = 0; i + 1 < g.count; ++i) {
+            position += (i % 2 + 1) * kPow3[g.moves[i]];
+        }
+        if (g.winner != 0) {
+            lossPositions[position]++;
+        }
+        if (g.count > 0) {
+            position += ((g.count - 1) % 2 + 1) * kPow3[g.moves[g.count - 1]];
+        }
+        stats.add(position, g.count, g.count ? g.moves[0] : -1);
+        if (shown < show) {
+            std::cout << "Game " << matched << ":\n";
+            printGame(g);
+            shown++;
+        }
+    });
+    double seconds = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+    if (total < 0) {
+        std::cerr << filename << " has a truncated or corrupt game after game " << seen
+                  << "; results cover the games before it\n";
+    }
+
+    std::cout << filename << ": " << file.header().player1 << " vs " << file.header().player2
+              << ", seed " << file.header().seed << "\n";
+    std::printf("Scanned %zu bytes in %.4fs (%.1f MB/s)\n", file.sizeBytes(), seconds,
+                seconds > 0 ? double(file.sizeBytes()) / seconds / 1e6 : 0.0);
+    std::cout << "Games: " << seen << ", matching filter: " << matched << "\n";
+    if (matched == 0) {
+        return 0;
+    }
+
+    std::cout << "\nResults:\n"
+              << "  Player1 wins: " << stats.wins(1) << "\n"
+              << "  Draws:        " << stats.draws() << "\n"
+              << "  Player2 wins: " << stats.wins(2) << "\n"
+              << "  Unique ending board states: " << stats.uniqueEndings() << "\n";
+    stats.print(std::cout);
+
+    std::vector<int> order;
+    for (int p = 0; p < kNumPositions; ++p) {
+        if (lossPositions[p]) order.push_back(p);
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        return lossPositions[a] > lossPositions[b];
+    });
+    if (order.size() > size_t(std::max(top, 0))) {
+        order.resize(size_t(std::max(top, 0)));
+    }
+    if (!order.empty()) {
+        std::cout << "\nMost common positions just before the winning move:\n";
+        for (int p : order) {
+            std::cout << "  " << lossPositions[p] << " games, player "
+                      << int(positionInfo(p).toMove) << " to move:";
+            TicTacToe::fromPositionIndex(p).printBoard();
+        }
+    }
+    return 0;
+}
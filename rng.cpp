@@ -0,0 +1,133 @@
+#include "rng.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+static uint64_t splitmix64(uint64_t& x) {
+    uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+Rng::Rng(uint64_t seed) {
+    for (int i = 0; i < 4; ++i) {
+        s[i] = splitmix64(seed);
+    }
+}
+
+uint64_t Rng::next() {
+    const uint64_t result = rotl(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return result;
+}
+
+int Rng::uniformInt(int n) {
+    // Lemire's multiply-and-shift, rejecting the few values that would bias it
+    uint32_t range = uint32_t(n);
+    uint64_t m = (next() >> 32) * range;
+    uint32_t low = uint32_t(m);
+    if (low < range) {
+        uint32_t threshold = uint32_t(-range) % range;
+        while (low < threshold) {
+            m = (next() >> 32) * range;
+            low = uint32_t(m);
+        }
+    }
+    return int(m >> 32);
+}
+
+double Rng::uniformReal() {
+    // top 53 bits fill a double's mantissa
+    return double(next() >> 11) * 0x1.0p-53;
+}
+
+void Rng::jump() {
+    static const uint64_t JUMP[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                     0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+    uint64_t t[4] = { 0, 0, 0, 0 };
+    for (uint64_t word : JUMP) {
+        for (int b = 0; b < 64; ++b) {
+            if (word & (uint64_t(1) << b)) {
+                for (int i = 0; i < 4; ++i) t[i] ^= s[i];
+            }
+            next();
+        }
+    }
+    std::memcpy(s, t, sizeof(s));
+}
+
+Rng Rng::split() {
+    Rng child = *this;
+    jump();
+    return child;
+}
+
+std::string Rng::saveState() const {
+    char buf[4 * 17];
+    std::snprintf(buf, sizeof(buf), "%016llx:%016llx:%016llx:%016llx",
+                  (unsigned long long)s[0], (unsigned long long)s[1],
+                  (unsigned long long)s[2], (unsigned long long)s[3]);
+    return buf;
+}
+
+bool Rng::loadState(const std::string& state) {
+    unsigned long long v[4];
+    if (std::sscanf(state.c_str(), "%llx:%llx:%llx:%llx", &v[0], &v[1], &v[2], &v[3]) != 4) {
+        return false;
+    }
+    if ((v[0] | v[1] | v[2] | v[3]) == 0) {
+        return false; // all-zero state only ever produces zeros
+    }
+    for (int i = 0; i < 4; ++i) s[i] = v[i];
+    return true;
+}
+
+static std::atomic<uint64_t> g_rootSeed{ 0x5EED5EED5EED5EEDULL };
+static std::atomic<uint64_t> g_nextStream{ 0 };
+
+void setRootSeed(uint64_t seed) {
+    g_rootSeed = seed;
+}
+
+uint64_t rootSeed() {
+    return g_rootSeed;
+}
+
+Rng makeStream(uint64_t id) {
+    // hash (root, id) into a seed; splitmix64 spreads neighbouring ids apart
+    uint64_t x = g_rootSeed.load();
+    uint64_t a = splitmix64(x);
+    uint64_t y = id ^ a;
+    return Rng(splitmix64(y));
+}
+
+uint64_t nextStreamId() {
+    return g_nextStream++;
+}
+
+uint64_t seedFromArgs(int argc, char** argv) {
+    uint64_t seed = uint64_t(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], "--seed") == 0) {
+            seed = std::strtoull(argv[i + 1], nullptr, 10);
+        }
+    }
+    setRootSeed(seed);
+    return seed;
+}
@@ -0,0 +1,54 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+#include <string>
+
+// xoshiro256** - small, fast, and good in every bit (unlike rand() % n)
+//
+// each agent, minimax player and opponent owns one of these, so nothing
+// shares hidden global state and a run is reproducible from its root seed
+class Rng {
+public:
+    // state is filled from seed with splitmix64
+    explicit Rng(uint64_t seed = 0);
+
+    uint64_t next();
+
+    // uniform in [0, n), n > 0
+    int uniformInt(int n);
+
+    // uniform in [0, 1)
+    double uniformReal();
+
+    // advances 2^128 steps, so a stream and its jumped copy never overlap
+    void jump();
+
+    // returns a stream starting at the current state and jumps this one
+    // past it - repeated splits give non-overlapping streams
+    Rng split();
+
+    // "s0:s1:s2:s3" in hex, for checkpoint sidecars
+    std::string saveState() const;
+    bool loadState(const std::string& state);
+
+private:
+    uint64_t s[4];
+};
+
+// every default stream is derived from one root seed; set it before any
+// agent, minimax player or training run is constructed
+void setRootSeed(uint64_t seed);
+uint64_t rootSeed();
+
+// stream number id under the root seed: same seed and id, same numbers
+Rng makeStream(uint64_t id);
+
+// next unused stream number, handed out in construction order
+uint64_t nextStreamId();
+
+// looks for "--seed N" in argv and sets the root seed from it, otherwise
+// from the clock; returns the seed so it can be printed and reused
+uint64_t seedFromArgs(int argc, char** argv);
+
+#endif
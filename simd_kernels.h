@@ -0,0 +1,103 @@
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+// float kernels for the Q models, four lanes at a time with SSE2 where
+// the compiler has it (every x86-64 target) and plain loops elsewhere.
+// n need not be a multiple of 4; the tail is done one at a time. also
+// the argmax over a Q row and a prefetch hint, for the batch lookups
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TTT_SSE2 1
+#endif
+
+// rows a batch lookup asks for ahead of the one it is reading
+constexpr int kPrefetchAhead = 8;
+
+// hint that p will be read soon; does nothing where there is no hint
+inline void prefetchRead(const void* p) {
+#if defined(__GNUC__)
+    __builtin_prefetch(p, 0, 3);
+#elif defined(TTT_SSE2)
+    _mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#else
+    (void)p;
+#endif
+}
+
+// sum of a[i] * b[i]
+inline float dotF(const float* a, const float* b, int n) {
+    int i = 0;
+    float sum = 0.0f;
+#ifdef TTT_SSE2
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    for (; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// y[i] += alpha * x[i]
+inline void axpyF(float alpha, const float* x, float* y, int n) {
+    int i = 0;
+#ifdef TTT_SSE2
+    __m128 a = _mm_set1_ps(alpha);
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(a, _mm_loadu_ps(x + i))));
+    }
+#endif
+    for (; i < n; ++i) {
+        y[i] += alpha * x[i];
+    }
+}
+
+// the first action a with bit a of legal set and the highest q[a], -1
+// if legal is 0: the move chooseAction makes with epsilon 0. nine
+// lanes are too few for SSE2 to pay; selects instead of branches keep
+// random rows from mispredicting
+inline int argmaxLegal(const double* q, unsigned legal) {
+    legal &= 0x1ff;
+    if (legal == 0) {
+        return -1;
+    }
+    int bestAction = 0;
+    while (!((legal >> bestAction) & 1)) {
+        ++bestAction;
+    }
+    double bestVal = q[bestAction];
+    for (int a = bestAction + 1; a < 9; ++a) {
+        double v = q[a];
+        bool take = ((legal >> a) & 1) & (v > bestVal);
+        bestVal = take ? v : bestVal;
+        bestAction = take ? a : bestAction;
+    }
+    return bestAction;
+}
+
+// x[i] = max(x[i], 0)
+inline void reluF(float* x, int n) {
+    int i = 0;
+#ifdef TTT_SSE2
+    __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(x + i, _mm_max_ps(_mm_loadu_ps(x + i), zero));
+    }
+#endif
+    for (; i < n; ++i) {
+        x[i] = x[i] > 0.0f ? x[i] : 0.0f;
+    }
+}
+
+#endif
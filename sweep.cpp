@@ -0,0 +1,406 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+
+#include "tic_tac_toe.h"
+#include "qlearning.h"
+#include "opponents.h"
+#include "training.h"
+#include "policy_analysis.h"
+#include "policy_snapshot.h"
+#include "thread_pool.h"
+#include "rng.h"
+
+// hyperparameter sweep: trains one agent per configuration, all at once
+// on a thread pool, and ranks them
+//
+//   sweep [--random N] [--alpha 0.05,0.1,0.2] [--alpha-end ...]
+//         [--gamma 0.9,1.0] [--epsilon 0.1,0.2,0.3] [--epsilon-end ...]
+//         [--decay none,linear,exp] [--episodes 20000,50000]
+//         [--opponent random|minimax|buggy|buggy2] [--repeats N]
+//         [--threads N] [--rank agreement|minimax|random]
+//         [--update one-step|qlambda|mc] [--lambda L]
+//         [--out sweep_results.csv] [--save-best file] [--seed N]
+//
+// by default every combination of the listed values is tried (a grid).
+// --random N draws N configurations instead: alpha, gamma, epsilon and
+// their end values uniformly between the smallest and largest value
+// listed, decay and episodes from their lists. an end list left out
+// means no decay; decay none ignores the end values
+//
+// each configuration is trained --repeats times (default 1) against the
+// opponent's response table, which every thread reads. repeat r uses the
+// same seed in every configuration, so configurations are compared on the
+// same random numbers. a policy is scored as analyze_policy scores it
+// (agreement of its greedy moves with minimax) and by its exact
+// win/draw/loss chances against minimax and a random player, as in
+// convergence; results are averaged over repeats, ranked by --rank
+// (default agreement) and written to --out best first. --update and
+// --lambda apply to every configuration
+
+struct SweepPoint {
+    HyperParams params;
+    long long episodes = 0;
+};
+
+struct SweepResult {
+    SweepPoint point;
+    std::vector<uint64_t> seeds;
+    double agreement = 0.0;
+    double states = 0.0;
+    OutcomeRates vsMinimax;
+    OutcomeRates vsRandom;
+    double seconds = 0.0;          // training time summed over repeats
+};
+
+struct SweepConfig {
+    std::vector<double> alpha = { 0.05, 0.1, 0.2, 0.4 };
+    std::vector<double> alphaEnd;
+    std::vector<double> gamma = { 0.9, 1.0 };
+    std::vector<double> epsilon = { 0.1, 0.2, 0.3 };
+    std::vector<double> epsilonEnd;
+    std::vector<Decay> decay = { Decay::None };
+    std::vector<long long> episodes = { 20000 };
+    int randomCount = 0;           // 0 => grid
+    std::string opponent = "random";
+    int repeats = 1;
+    int threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    std::string rank = "agreement";
+    std::string out = "sweep_results.csv";
+    std::string saveBest;
+    UpdateMode update = UpdateMode::OneStep;
+    double lambda = 0.8;
+};
+
+static std::vector<double> parseList(const std::string& text) {
+    std::vector<double> values;
+    std::stringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        values.push_back(std::atof(item.c_str()));
+    }
+    return values;
+}
+
+static const OpponentTable* opponentTable(const std::string& name) {
+    if (name == "random")  return &randomTable();
+    if (name == "minimax") return &minimaxTable();
+    if (name == "buggy")   return &buggyMinimaxTable();
+    if (name == "buggy2")  return &buggyMinimax2Table();
+    return nullptr;
+}
+
+static Schedule makeSchedule(double start, double end, Decay decay) {
+    Schedule s;
+    s.start = start;
+    s.end = (decay == Decay::None) ? start : end;
+    s.decay = (s.end == s.start) ? Decay::None : decay;
+    return s;
+}
+
+static std::vector<SweepPoint> gridPoints(const SweepConfig& cfg) {
+    // an empty end list means "same as the start"
+    std::vector<double> noEnd = { -1.0 };
+    const std::vector<double>& alphaEnds = cfg.alphaEnd.empty() ? noEnd : cfg.alphaEnd;
+    const std::vector<double>& epsilonEnds = cfg.epsilonEnd.empty() ? noEnd : cfg.epsilonEnd;
+    std::vector<SweepPoint> points;
+    for (long long episodes : cfg.episodes)
+    for (Decay decay : cfg.decay)
+    for (double a : cfg.alpha)
+    for (double aEnd : alphaEnds)
+    for (double g : cfg.gamma)
+    for (double e : cfg.epsilon)
+    for (double eEnd : epsilonEnds) {
+        SweepPoint p;
+        p.episodes = episodes;
+        p.params.alpha = makeSchedule(a, aEnd < 0 ? a : aEnd, decay);
+        p.params.gamma = g;
+        p.params.epsilon = makeSchedule(e, eEnd < 0 ? e : eEnd, decay);
+        bool duplicate = false;
+        for (const SweepPoint& q : points) {
+            duplicate |= q.episodes == p.episodes && q.params.gamma == p.params.gamma
+                && q.params.alpha.start == p.params.alpha.start && q.params.alpha.end == p.params.alpha.end
+                && q.params.epsilon.start == p.params.epsilon.start && q.params.epsilon.end == p.params.epsilon.end
+                && q.params.alpha.decay == p.params.alpha.decay && q.params.epsilon.decay == p.params.epsilon.decay;
+        }
+        // decay none makes the end lists collapse onto one point
+        if (!duplicate) points.push_back(p);
+    }
+    return points;
+}
+
+static double drawBetween(const std::vector<double>& values, Rng& rng) {
+    double lo = *std::min_element(values.begin(), values.end());
+    double hi = *std::max_element(values.begin(), values.end());
+    return lo + (hi - lo) * rng.uniformReal();
+}
+
+static std::vector<SweepPoint> randomPoints(const SweepConfig& cfg, Rng& rng) {
+    std::vector<SweepPoint> points;
+    for (int i = 0; i < cfg.randomCount; ++i) {
+        SweepPoint p;
+        p.episodes = cfg.episodes[rng.uniformInt(int(cfg.episodes.size()))];
+        Decay decay = cfg.decay[rng.uniformInt(int(cfg.decay.size()))];
+        double a = drawBetween(cfg.alpha, rng);
+        double aEnd = cfg.alphaEnd.empty() ? a : drawBetween(cfg.alphaEnd, rng);
+        double e = drawBetween(cfg.epsilon, rng);
+        double eEnd = cfg.epsilonEnd.empty() ? e : drawBetween(cfg.epsilonEnd, rng);
+        p.params.alpha = makeSchedule(a, aEnd, decay);
+        p.params.gamma = drawBetween(cfg.gamma, rng);
+        p.params.epsilon = makeSchedule(e, eEnd, decay);
+        points.push_back(p);
+    }
+    return points;
+}
+
+// one training run of a configuration, the episode code of tic_tac_toe.exe
+static std::vector<PolicyEntry> train(const SweepPoint& point, const OpponentTable& opponent,
+                                      uint64_t seed, double& seconds) {
+    Rng streams(seed);
+    QLearningAgent agent(point.params.alpha.start, point.params.gamma, point.params.epsilon.start);
+    agent.setRng(streams.split());
+    agent.setUpdateMode(point.params.update, point.params.lambda);
+    Rng opponentRng = streams.split();
+    OpponentMoveFn move = [&](TicTacToe& env, int) { return opponent.sample(env, opponentRng); };
+
+    auto start = std::chrono::steady_clock::now();
+    bool scheduled = point.params.decays();
+    for (long long i = 0; i < point.episodes; ++i) {
+        if (scheduled) {
+            applyHyperParams(agent, point.params, double(i) / double(point.episodes));
+        }
+        playTrainingEpisode(agent, move);
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<PolicyEntry> entries;
+    agent.copyTable(entries);
+    return entries;
+}
+
+static std::string scheduleText(const Schedule& s) {
+    char text[64];
+    if (s.decay == Decay::None) {
+        std::snprintf(text, sizeof(text), "%.4g", s.start);
+    } else {
+        std::snprintf(text, sizeof(text), "%.4g>%.4g", s.start, s.end);
+    }
+    return text;
+}
+
+static Decay decayOf(const HyperParams& p) {
+    return p.alpha.decay != Decay::None ? p.alpha.decay : p.epsilon.decay;
+}
+
+// higher is better
+static double rankScore(const SweepResult& r, const std::string& rank) {
+    if (rank == "minimax") return -r.vsMinimax.loss;
+    if (rank == "random")  return r.vsRandom.win;
+    return r.agreement;
+}
+
+static void printTable(const std::vector<SweepResult>& results) {
+    std::printf("%4s %-15s %6s %-15s %-6s %10s %8s %7s %8s %8s %8s %8s\n",
+                "rank", "alpha", "gamma", "epsilon", "decay", "episodes", "agree", "states",
+                "mm draw", "mm loss", "rnd win", "train s");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const SweepResult& r = results[i];
+        std::printf("%4zu %-15s %6.3g %-15s %-6s %10lld %8.4f %7.0f %8.4f %8.4f %8.4f %8.2f\n",
+                    i + 1, scheduleText(r.point.params.alpha).c_str(), r.point.params.gamma,
+                    scheduleText(r.point.params.epsilon).c_str(), decayName(decayOf(r.point.params)),
+                    r.point.episodes, r.agreement, r.states, r.vsMinimax.draw, r.vsMinimax.loss,
+                    r.vsRandom.win, r.seconds);
+    }
+}
+
+static bool writeCsv(const std::string& filename, const std::vector<SweepResult>& results,
+                     const std::string& opponent) {
+    std::ofstream out(filename);
+    if (!out) {
+        return false;
+    }
+    out << "rank,opponent,episodes,alpha,alpha_end,gamma,epsilon,epsilon_end,decay,seeds,"
+           "agreement,states,mm_win,mm_draw,mm_loss,rnd_win,rnd_draw,rnd_loss,train_s\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const SweepResult& r = results[i];
+        const HyperParams& p = r.point.params;
+        out << i + 1 << ',' << opponent << ',' << r.point.episodes << ','
+            << p.alpha.start << ',' << p.alpha.end << ',' << p.gamma << ','
+            << p.epsilon.start << ',' << p.epsilon.end << ',' << decayName(decayOf(p)) << ',';
+        for (size_t s = 0; s < r.seeds.size(); ++s) {
+            out << (s ? ";" : "") << r.seeds[s];
+        }
+        out << ',' << r.agreement << ',' << r.states << ','
+            << r.vsMinimax.win << ',' << r.vsMinimax.draw << ',' << r.vsMinimax.loss << ','
+            << r.vsRandom.win << ',' << r.vsRandom.draw << ',' << r.vsRandom.loss << ','
+            << r.seconds << "\n";
+    }
+    return bool(out);
+}
+
+int main(int argc, char** argv) {
+    uint64_t seed = seedFromArgs(argc, argv);
+    SweepConfig cfg;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        std::string value = argv[i + 1];
+        if (arg == "--alpha")            cfg.alpha = parseList(value);
+        else if (arg == "--alpha-end")   cfg.alphaEnd = parseList(value);
+        else if (arg == "--gamma")       cfg.gamma = parseList(value);
+        else if (arg == "--epsilon")     cfg.epsilon = parseList(value);
+        else if (arg == "--epsilon-end") cfg.epsilonEnd = parseList(value);
+        else if (arg == "--random")      cfg.randomCount = std::max(0, std::atoi(value.c_str()));
+        else if (arg == "--opponent")    cfg.opponent = value;
+        else if (arg == "--repeats")     cfg.repeats = std::max(1, std::atoi(value.c_str()));
+        else if (arg == "--threads")     cfg.threads = std::max(1, std::atoi(value.c_str()));
+        else if (arg == "--rank")        cfg.rank = value;
+        else if (arg == "--out")         cfg.out = value;
+        else if (arg == "--save-best")   cfg.saveBest = value;
+        else if (arg == "--lambda")      cfg.lambda = std::atof(value.c_str());
+        else if (arg == "--update") {
+            if (!parseUpdateMode(value, cfg.update)) {
+                std::cerr << "unknown --update " << value << " (one-step, qlambda or mc)\n";
+                return 1;
+            }
+        }
+        else if (arg == "--episodes") {
+            cfg.episodes.clear();
+            for (double e : parseList(value)) cfg.episodes.push_back(std::max(1LL, (long long)e));
+        }
+        else if (arg == "--decay") {
+            cfg.decay.clear();
+            std::stringstream in(value);
+            std::string name;
+            while (std::getline(in, name, ',')) {
+                Decay d;
+                if (!parseDecay(name, d)) {
+                    std::cerr << "unknown decay " << name << " (none, linear or exp)\n";
+                    return 1;
+                }
+                cfg.decay.push_back(d);
+            }
+        }
+        else if (arg != "--seed") {
+            std::cerr << "unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+    const OpponentTable* opponent = opponentTable(cfg.opponent);
+    if (!opponent) {
+        std::cerr << "unknown opponent " << cfg.opponent << " (random, minimax, buggy or buggy2)\n";
+        return 1;
+    }
+    if (cfg.alpha.empty() || cfg.gamma.empty() || cfg.epsilon.empty() || cfg.decay.empty()
+        || cfg.episodes.empty()) {
+        std::cerr << "every list needs at least one value\n";
+        return 1;
+    }
+    if (cfg.rank != "agreement" && cfg.rank != "minimax" && cfg.rank != "random") {
+        std::cerr << "unknown --rank " << cfg.rank << " (agreement, minimax or random)\n";
+        return 1;
+    }
+
+    Rng drawRng = makeStream(nextStreamId());
+    std::vector<SweepPoint> points = cfg.randomCount > 0 ? randomPoints(cfg, drawRng) : gridPoints(cfg);
+    for (SweepPoint& p : points) {
+        p.params.update = cfg.update;
+        p.params.lambda = cfg.lambda;
+    }
+    std::vector<uint64_t> repeatSeeds;
+    for (int r = 0; r < cfg.repeats; ++r) {
+        repeatSeeds.push_back(makeStream(nextStreamId()).next());
+    }
+
+    // built before the pool starts, then only read
+    minimaxTable();
+    randomTable();
+    minimaxScore(0, 1);
+
+    int runs = int(points.size()) * cfg.repeats;
+    std::cout << "Sweep: " << points.size() << " configurations ("
+              << (cfg.randomCount > 0 ? "random" : "grid") << ") x " << cfg.repeats
+              << " repeat(s) vs " << cfg.opponent << " on " << cfg.threads << " threads, seed "
+              << seed << "\n";
+
+    std::vector<SweepResult> results(points.size());
+    std::vector<std::vector<PolicyEntry>> bestEntries(points.size());
+    std::vector<double> bestAgreement(points.size(), -1.0);
+    for (size_t i = 0; i < points.size(); ++i) {
+        results[i].point = points[i];
+        results[i].seeds = repeatSeeds;
+    }
+    std::mutex mutex;
+    int finished = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    ThreadPool pool(cfg.threads);
+    pool.parallelFor(runs, [&](int job) {
+        int c = job / cfg.repeats;
+        int r = job % cfg.repeats;
+        double seconds = 0.0;
+        std::vector<PolicyEntry> entries = train(points[c], *opponent, repeatSeeds[r], seconds);
+        PolicyAgreement agreement = analyzePolicyEntries(entries);
+        OutcomeRates vsMinimax = exactOutcomes(entries, minimaxTable(), 1);
+        OutcomeRates vsRandom = exactOutcomes(entries, randomTable(), 1);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        double share = 1.0 / double(cfg.repeats);
+        SweepResult& res = results[c];
+        res.agreement += agreement.agreement() * share;
+        res.states += double(agreement.totalStates) * share;
+        res.vsMinimax.win += vsMinimax.win * share;
+        res.vsMinimax.draw += vsMinimax.draw * share;
+        res.vsMinimax.loss += vsMinimax.loss * share;
+        res.vsRandom.win += vsRandom.win * share;
+        res.vsRandom.draw += vsRandom.draw * share;
+        res.vsRandom.loss += vsRandom.loss * share;
+        res.seconds += seconds;
+        if (!cfg.saveBest.empty() && agreement.agreement() > bestAgreement[c]) {
+            bestAgreement[c] = agreement.agreement();
+            bestEntries[c] = std::move(entries);
+        }
+        finished++;
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::printf("[%d/%d] alpha %s gamma %g epsilon %s, %lld episodes, seed %llu: "
+                    "agreement %.4f, mm loss %.4f (%.1fs elapsed)\n",
+                    finished, runs, scheduleText(points[c].params.alpha).c_str(),
+                    points[c].params.gamma, scheduleText(points[c].params.epsilon).c_str(),
+                    points[c].episodes, (unsigned long long)repeatSeeds[r],
+                    agreement.agreement(), vsMinimax.loss, elapsed);
+        std::fflush(stdout);
+    });
+
+    std::vector<int> order(points.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = int(i);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return rankScore(results[a], cfg.rank) > rankScore(results[b], cfg.rank);
+    });
+    std::vector<SweepResult> ranked;
+    for (int i : order) ranked.push_back(results[i]);
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("\n%d runs in %.1fs, ranked by %s (mean over repeats)\n", runs, elapsed, cfg.rank.c_str());
+    printTable(ranked);
+
+    if (!writeCsv(cfg.out, ranked, cfg.opponent)) {
+        std::cerr << "Could not write " << cfg.out << "\n";
+        return 1;
+    }
+    std::cout << "Wrote " << cfg.out << "\n";
+    if (!cfg.saveBest.empty()) {
+        if (!writePolicyFile(bestEntries[order[0]], cfg.saveBest)) {
+            std::cerr << "Could not write " << cfg.saveBest << "\n";
+            return 1;
+        }
+        std::cout << "Best configuration's policy -> " << cfg.saveBest << "\n";
+    }
+    return 0;
+}
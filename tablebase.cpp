@@ -0,0 +1,292 @@
+#include "tablebase.h"
+#include "simd_kernels.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const char kMagic[4] = { 'T', 'T', 'T', 'B' };
+static const uint16_t kVersion = 1;
+static const size_t kHeaderSize = 16;
+
+// positions per parallel task; a multiple of 32, so no two tasks write
+// the same word
+static const uint64_t kBlock = 1 << 15;
+
+static const uint64_t* pow3Table() {
+    static const std::vector<uint64_t> table = [] {
+        std::vector<uint64_t> t(41, 1);
+        for (int i = 1; i < 41; ++i) t[i] = t[i - 1] * 3;
+        return t;
+    }();
+    return table.data();
+}
+
+uint64_t gridIndex(const GridGame& game) {
+    static const uint64_t* pow3 = pow3Table();
+    uint64_t index = 0;
+    for (int player = 1; player <= 2; ++player) {
+        uint64_t mask = game.piecesOf(player);
+        while (mask) {
+            index += uint64_t(player) * pow3[__builtin_ctzll(mask)];
+            mask &= mask - 1;
+        }
+    }
+    return index;
+}
+
+std::string tablebaseFileName(int size, int inRow) {
+    return "tablebase_" + std::to_string(size) + "x" + std::to_string(size)
+         + "_k" + std::to_string(inRow) + ".ttb";
+}
+
+static bool hasLine(const GridGeometry& geo, uint64_t pieces) {
+    for (uint64_t line : geo.lines) {
+        if ((pieces & line) == line) return true;
+    }
+    return false;
+}
+
+std::vector<uint64_t> solveTablebase(int size, int inRow, ThreadPool& pool,
+                                     std::vector<long long>* layerCounts) {
+    const GridGeometry& geo = gridGeometry(size, inRow);
+    const uint64_t* pow3 = pow3Table();
+    int cells = geo.cells;
+    uint64_t positions = pow3[cells];
+    std::vector<uint64_t> words((positions + 31) / 32, 0);
+
+    // pieces on the board for every index, so each layer is one scan
+    std::vector<uint8_t> filled(positions);
+    filled[0] = 0;
+    for (uint64_t i = 1; i < positions; ++i) {
+        filled[i] = uint8_t(filled[i / 3] + (i % 3 != 0));
+    }
+
+    auto valueOf = [&](uint64_t index) {
+        return int((words[index >> 5] >> ((index & 31) * 2)) & 3);
+    };
+
+    int blocks = int((positions + kBlock - 1) / kBlock);
+    std::vector<long long> solved(blocks);
+    if (layerCounts) layerCounts->assign(cells + 1, 0);
+
+    // a layer's values go to layerWords: a child read from words
+    // can share its word with positions of the layer being solved, so
+    // words is only read while the blocks run and the layer is merged
+    // in once they are done. a block covers whole words of both
+    std::vector<uint64_t> layerWords(words.size(), 0);
+    static_assert(kBlock % 32 == 0, "a block must cover whole words");
+    auto mergeLayer = [&](int b) {
+        uint64_t begin = uint64_t(b) * (kBlock / 32);
+        uint64_t end = std::min<uint64_t>(words.size(), begin + kBlock / 32);
+        for (uint64_t w = begin; w < end; ++w) {
+            words[w] |= layerWords[w];
+            layerWords[w] = 0;
+        }
+    };
+
+    // every child of a layer n position is in layer n + 1, finished
+    // before layer n starts
+    for (int layer = cells; layer >= 0; --layer) {
+        std::fill(solved.begin(), solved.end(), 0);
+        pool.parallelFor(blocks, [&](int b) {
+            uint64_t begin = uint64_t(b) * kBlock;
+            uint64_t end = std::min(positions, begin + kBlock);
+            for (uint64_t index = begin; index < end; ++index) {
+                if (filled[index] != layer) continue;
+
+                uint64_t pieces[2] = { 0, 0 };
+                uint64_t rest = index;
+                for (int c = 0; c < cells; ++c) {
+                    int d = int(rest % 3);
+                    rest /= 3;
+                    if (d) pieces[d - 1] |= uint64_t(1) << c;
+                }
+                int first = __builtin_popcountll(pieces[0]);
+                int second = __builtin_popcountll(pieces[1]);
+                if (first != second && first != second + 1) continue;
+
+                bool firstWon = hasLine(geo, pieces[0]);
+                bool secondWon = hasLine(geo, pieces[1]);
+                int v = kTbInvalid;
+                if (firstWon || secondWon) {
+                    // only the player who just moved can have a line
+                    if (firstWon && !secondWon && first == second + 1) v = kTbFirst;
+                    if (secondWon && !firstWon && first == second) v = kTbSecond;
+                } else if (layer == cells) {
+                    v = kTbDraw;
+                } else {
+                    int mover = (first == second) ? 1 : 2;
+                    bool draw = false;
+                    v = 3 - mover;
+                    for (int c = 0; c < cells; ++c) {
+                        if (((pieces[0] | pieces[1]) >> c) & 1) continue;
+                        int child = valueOf(index + uint64_t(mover) * pow3[c]);
+                        if (child == mover) {
+                            v = mover;
+                            break;
+                        }
+                        draw |= (child == kTbDraw);
+                    }
+                    if (v != mover && draw) v = kTbDraw;
+                }
+                if (v != kTbInvalid) {
+                    layerWords[index >> 5] |= uint64_t(v) << ((index & 31) * 2);
+                    solved[b]++;
+                }
+            }
+        });
+        pool.parallelFor(blocks, mergeLayer);
+        if (layerCounts) {
+            for (long long n : solved) (*layerCounts)[layer] += n;
+        }
+    }
+    return words;
+}
+
+bool writeTablebase(const std::string& filename, int size, int inRow,
+                    const std::vector<uint64_t>& words) {
+    FILE* file = std::fopen(filename.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    uint8_t header[kHeaderSize] = {};
+    uint64_t positions = pow3Table()[size * size];
+    std::memcpy(header, kMagic, 4);
+    std::memcpy(header + 4, &kVersion, 2);
+    header[6] = uint8_t(size);
+    header[7] = uint8_t(inRow);
+    std::memcpy(header + 8, &positions, 8);
+    bool ok = std::fwrite(header, 1, kHeaderSize, file) == kHeaderSize
+           && std::fwrite(words.data(), 8, words.size(), file) == words.size();
+    ok = (std::fclose(file) == 0) && ok;
+    return ok;
+}
+
+bool Tablebase::open(const std::string& filename, std::string& error) {
+    close();
+    FILE* file = std::fopen(filename.c_str(), "rb");
+    if (!file) {
+        error = "could not open " + filename;
+        return false;
+    }
+    uint8_t header[kHeaderSize];
+    uint16_t version = 0;
+    bool ok = std::fread(header, 1, kHeaderSize, file) == kHeaderSize;
+    std::fseek(file, 0, SEEK_END);
+    long fileSize = std::ftell(file);
+    std::fclose(file);
+    if (ok) {
+        std::memcpy(&version, header + 4, 2);
+        std::memcpy(&count, header + 8, 8);
+    }
+    int size = ok ? header[6] : 0;
+    int inRow = ok ? header[7] : 0;
+    if (!ok || std::memcmp(header, kMagic, 4) != 0 || version != kVersion) {
+        error = filename + " is not a tablebase";
+        return false;
+    }
+    if (size < 1 || size > kTablebaseMaxSize || inRow < 1 || inRow > size
+        || count != pow3Table()[size * size]
+        || fileSize != long(kHeaderSize + (count + 31) / 32 * 8)) {
+        error = filename + " is truncated or has a bad header";
+        count = 0;
+        return false;
+    }
+    boardSize = size;
+    boardInRow = inRow;
+    size_t words = size_t((count + 31) / 32);
+
+#ifndef _WIN32
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        void* p = ::mmap(nullptr, size_t(fileSize), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p != MAP_FAILED) {
+            mapping = p;
+            mappingSize = size_t(fileSize);
+            data = reinterpret_cast<const uint64_t*>(static_cast<const uint8_t*>(p) + kHeaderSize);
+            return true;
+        }
+    }
+#endif
+    // no mmap: read the words in
+    file = std::fopen(filename.c_str(), "rb");
+    loaded.resize(words);
+    ok = file && std::fseek(file, long(kHeaderSize), SEEK_SET) == 0
+         && std::fread(loaded.data(), 8, words, file) == words;
+    if (file) std::fclose(file);
+    if (!ok) {
+        error = "could not read " + filename;
+        close();
+        return false;
+    }
+    data = loaded.data();
+    return true;
+}
+
+void Tablebase::close() {
+#ifndef _WIN32
+    if (mapping) {
+        ::munmap(mapping, mappingSize);
+    }
+#endif
+    mapping = nullptr;
+    mappingSize = 0;
+    data = nullptr;
+    count = 0;
+    boardSize = 0;
+    boardInRow = 0;
+    loaded.clear();
+    loaded.shrink_to_fit();
+}
+
+void Tablebase::values(const uint64_t* indices, int count, uint8_t* out) const {
+    for (int i = 0; i < count && i < kPrefetchAhead; ++i) {
+        prefetchRead(data + (indices[i] >> 5));
+    }
+    for (int i = 0; i < count; ++i) {
+        if (i + kPrefetchAhead < count) {
+            prefetchRead(data + (indices[i + kPrefetchAhead] >> 5));
+        }
+        out[i] = uint8_t(value(indices[i]));
+    }
+}
+
+uint64_t Tablebase::bestCells(const GridGame& game) const {
+    if (game.isGameOver()) {
+        return 0;
+    }
+    static const uint64_t* pow3 = pow3Table();
+    uint64_t index = gridIndex(game);
+    int mover = game.toMove();
+
+    // the children are spread over the file, so they are probed together
+    uint64_t children[GridGame::kMaxSize * GridGame::kMaxSize + 1];
+    int cells[GridGame::kMaxSize * GridGame::kMaxSize];
+    int n = 0;
+    children[n] = index;
+    uint64_t empty = game.emptyCells();
+    while (empty) {
+        int c = __builtin_ctzll(empty);
+        empty &= empty - 1;
+        cells[n++] = c;
+        children[n] = index + uint64_t(mover) * pow3[c];
+    }
+    uint8_t v[GridGame::kMaxSize * GridGame::kMaxSize + 1];
+    values(children, n + 1, v);
+
+    uint64_t best = 0;
+    for (int i = 0; i < n; ++i) {
+        if (v[i + 1] == v[0]) {
+            best |= uint64_t(1) << cells[i];
+        }
+    }
+    return best;
+}
@@ -0,0 +1,92 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "grid_game.h"
+#include "thread_pool.h"
+
+// game-theoretic result of every position of an N x N board (N <= 4),
+// solved backwards from full boards and read back through mmap
+//
+// file:  "TTTB", u16 version, u8 size, u8 inRow, u64 positions,
+//        then 2 bits per position, 32 to a little-endian u64 word
+//
+// a position's index is its base-3 rank, cell c counting 3^c times its
+// owner (0 empty, 1, 2) - the same encoding as the 3x3 position table.
+// no symmetry reduction: 4x4 is 3^16 positions, 10.3 MB
+
+// 2-bit values
+static const int kTbInvalid = 0;    // piece counts or lines that no game reaches
+static const int kTbFirst = 1;      // player 1 wins with best play
+static const int kTbSecond = 2;     // player 2 wins with best play
+static const int kTbDraw = 3;
+
+// largest board the tablebase tool solves
+static const int kTablebaseMaxSize = 4;
+
+// base-3 rank of the position
+uint64_t gridIndex(const GridGame& game);
+
+// "tablebase_4x4_k4.ttb"
+std::string tablebaseFileName(int size, int inRow);
+
+// solves every position of a size x size, inRow board, one piece count
+// at a time from the full boards down, blocks of each layer spread over
+// pool; layerCounts (if given) gets the positions solved per piece count
+std::vector<uint64_t> solveTablebase(int size, int inRow, ThreadPool& pool,
+                                     std::vector<long long>* layerCounts = nullptr);
+
+// creates (or truncates) filename; false if it could not be written
+bool writeTablebase(const std::string& filename, int size, int inRow,
+                    const std::vector<uint64_t>& words);
+
+// a solved file, mapped read-only; probes are one load and a shift
+class Tablebase {
+public:
+    Tablebase() = default;
+    ~Tablebase() { close(); }
+
+    Tablebase(const Tablebase&) = delete;
+    Tablebase& operator=(const Tablebase&) = delete;
+
+    // false, with the reason in error, unless filename is a whole tablebase
+    bool open(const std::string& filename, std::string& error);
+    void close();
+
+    bool isOpen() const { return data != nullptr; }
+    int size() const { return boardSize; }
+    int inRow() const { return boardInRow; }
+    uint64_t positions() const { return count; }
+
+    // true if game is the board shape this file solves
+    bool covers(const GridGame& game) const {
+        return data && game.size() == boardSize && game.inRow() == boardInRow;
+    }
+
+    int value(uint64_t index) const {
+        return int((data[index >> 5] >> ((index & 31) * 2)) & 3);
+    }
+    int value(const GridGame& game) const { return value(gridIndex(game)); }
+
+    // value for many indices: out[i] = value(indices[i]), each word
+    // prefetched a few indices before it is read (the file is mapped, so
+    // a probe into a large table is usually a cache miss)
+    void values(const uint64_t* indices, int count, uint8_t* out) const;
+
+    // cells (as a mask) whose move keeps the result of the position for
+    // the player to move; 0 once the game is over
+    uint64_t bestCells(const GridGame& game) const;
+
+private:
+    const uint64_t* data = nullptr;
+    uint64_t count = 0;
+    int boardSize = 0;
+    int boardInRow = 0;
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    std::vector<uint64_t> loaded;      // where there is no mmap
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+
+#include "tablebase.h"
+#include "policy_analysis.h"
+#include "position_table.h"
+
+// solves every position of a small board and writes the tablebase that
+// IterativeMinimax (--id-tablebase) and grid_match probe
+//
+//   tablebase_solve [--size N] [--k K] [--threads N] [--out file]
+//   tablebase_solve --check file        checks a 3x3 file against minimax
+//   tablebase_solve --probe file board  result and best cells for a board,
+//                                       given as one of . x o per cell
+//
+// defaults: 4x4, 4 in a row, every core, tablebase_<N>x<N>_k<K>.ttb
+
+static const char* resultName(int v) {
+    switch (v) {
+    case kTbFirst:  return "player 1 wins";
+    case kTbSecond: return "player 2 wins";
+    case kTbDraw:   return "draw";
+    default:        return "unreachable";
+    }
+}
+
+// every playable 3x3 position: the same result as the minimax score, and
+// the same best cells as minimax's equivalence set
+static int checkAgainstMinimax(const Tablebase& tb) {
+    if (tb.size() != 3 || tb.inRow() != 3) {
+        std::cerr << "--check needs a 3x3, 3 in a row tablebase\n";
+        return 1;
+    }
+    int checked = 0;
+    int wrongValue = 0;
+    int wrongMoves = 0;
+    for (int index = 0; index < kNumPositions; ++index) {
+        if (!isPlayablePosition(index)) continue;
+        const PositionInfo& info = positionInfo(index);
+        double score = minimaxScore(index, info.toMove);
+        int expected = score > 0.75 ? info.toMove : score < 0.25 ? 3 - info.toMove : kTbDraw;
+        GridGame game(3, 3);
+        for (int c = 0; c < 9; ++c) {
+            int owner = (index / kPow3[c]) % 3;
+            if (owner) game.makeMove(c, owner);
+        }
+        checked++;
+        wrongValue += (tb.value(uint64_t(index)) != expected);
+        wrongMoves += (tb.bestCells(game) != optimalMoves(index));
+    }
+    std::cout << checked << " playable positions: " << wrongValue << " results and "
+              << wrongMoves << " best move sets differ from minimax\n";
+    return (wrongValue || wrongMoves) ? 1 : 0;
+}
+
+static int probe(const Tablebase& tb, const std::string& board) {
+    GridGame game(tb.size(), tb.inRow());
+    if (int(board.size()) != game.cells()) {
+        std::cerr << "board needs " << game.cells() << " cells\n";
+        return 1;
+    }
+    uint64_t index = 0;
+    for (int c = game.cells() - 1; c >= 0; --c) {
+        char ch = char(std::tolower(board[c]));
+        if (ch != 'x' && ch != 'o' && ch != '.') {
+            std::cerr << "unexpected '" << board[c] << "' in board\n";
+            return 1;
+        }
+        index = index * 3 + (ch == 'x' ? 1 : ch == 'o' ? 2 : 0);
+    }
+    int v = tb.value(index);
+    std::cout << resultName(v);
+    if (v != kTbInvalid) {
+        for (int c = 0; c < game.cells(); ++c) {
+            char ch = char(std::tolower(board[c]));
+            if (ch != '.') game.makeMove(c, ch == 'x' ? 1 : 2);
+        }
+        uint64_t best = tb.bestCells(game);
+        if (best) {
+            std::cout << ", best cells:";
+            for (int c = 0; c < game.cells(); ++c) {
+                if ((best >> c) & 1) std::cout << " (" << c % game.size() << "," << c / game.size() << ")";
+            }
+        }
+    }
+    std::cout << "\n";
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int size = 4;
+    int inRow = 4;
+    int threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    std::string out;
+    std::string checkFile;
+    std::string probeFile;
+    std::string probeBoard;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : "";
+        if (arg == "--size")          size = std::atoi(value);
+        else if (arg == "--k")        inRow = std::atoi(value);
+        else if (arg == "--threads")  threads = std::max(1, std::atoi(value));
+        else if (arg == "--out")      out = value;
+        else if (arg == "--check")    checkFile = value;
+        else if (arg == "--probe" && i + 2 < argc) {
+            probeFile = value;
+            probeBoard = argv[i + 2];
+            ++i;
+        } else {
+            std::cerr << "unknown option " << arg << "\n";
+            return 1;
+        }
+        ++i;
+    }
+
+    if (!checkFile.empty() || !probeFile.empty()) {
+        Tablebase tb;
+        std::string error;
+        if (!tb.open(checkFile.empty() ? probeFile : checkFile, error)) {
+            std::cerr << error << "\n";
+            return 1;
+        }
+        return checkFile.empty() ? probe(tb, probeBoard) : checkAgainstMinimax(tb);
+    }
+
+    if (size < 1 || size > kTablebaseMaxSize || inRow < 1 || inRow > size) {
+        std::cerr << "need 1 <= k <= size <= " << kTablebaseMaxSize << "\n";
+        return 1;
+    }
+    if (out.empty()) {
+        out = tablebaseFileName(size, inRow);
+    }
+
+    std::cout << "Solving " << size << "x" << size << ", " << inRow << " in a row on "
+              << threads << " threads...\n";
+    auto start = std::chrono::steady_clock::now();
+    ThreadPool pool(threads);
+    std::vector<long long> layers;
+    std::vector<uint64_t> words = solveTablebase(size, inRow, pool, &layers);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    long long total = 0;
+    for (size_t n = 0; n < layers.size(); ++n) {
+        std::printf("  %2zu pieces: %10lld positions\n", n, layers[n]);
+        total += layers[n];
+    }
+    int root = int(words[0] & 3);
+    std::printf("%lld positions solved in %.2f s; empty board: %s\n",
+                total, seconds, resultName(root));
+
+    if (!writeTablebase(out, size, inRow, words)) {
+        std::cerr << "Could not write " << out << "\n";
+        return 1;
+    }
+    std::printf("Wrote %s (%.1f MB)\n", out.c_str(), double(words.size()) * 8.0 / (1024.0 * 1024.0));
+    return 0;
+}
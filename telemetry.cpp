@@ -0,0 +1,126 @@
+#include "telemetry.h"
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
+#ifdef _WIN32
+// version 2 maps GetProcessMemoryInfo to kernel32, so no -lpsapi
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+size_t residentMemoryBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return size_t(pmc.WorkingSetSize);
+    }
+    return 0;
+#else
+    // second field of statm is resident pages
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (!(statm >> pages >> resident)) {
+        return 0;
+    }
+    return resident * size_t(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+static bool endsWith(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() &&
+           s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool TrainingTelemetry::open(const std::string& filename, long long startEpisodes, int window) {
+    csv = endsWith(filename, ".csv");
+    // a resumed run appends to the file it was already writing
+    std::ifstream existing(filename);
+    bool fresh = !existing || existing.peek() == std::ifstream::traits_type::eof();
+    existing.close();
+
+    out.open(filename, std::ios::out | std::ios::app);
+    if (!out) {
+        std::cerr << "could not open " << filename << " to write\n";
+        return false;
+    }
+    if (csv && fresh) {
+        out << "episodes,elapsed_s,episodes_per_s,steps_per_s,states,table_bytes,"
+               "load_factor,mean_abs_td,win,draw,loss,window,epsilon,rss_bytes\n";
+    }
+
+    start = last = Clock::now();
+    lastEpisodes = startEpisodes;
+    steps = 0;
+    windowSize = size_t(window > 0 ? window : 1);
+    recent.clear();
+    recent.reserve(windowSize);
+    next = 0;
+    windowCounts[0] = windowCounts[1] = windowCounts[2] = 0;
+    return true;
+}
+
+void TrainingTelemetry::sample(long long episodes, QLearningAgent& agent, QLearningAgent* agent2) {
+    if (!out.is_open()) {
+        return;
+    }
+    Clock::time_point now = Clock::now();
+    double elapsed = std::chrono::duration<double>(now - start).count();
+    double interval = std::chrono::duration<double>(now - last).count();
+    double episodesPerSec = interval > 0 ? double(episodes - lastEpisodes) / interval : 0.0;
+    double stepsPerSec = interval > 0 ? double(steps) / interval : 0.0;
+
+    // self-play: both tables count towards size and error
+    QTableStats table = agent.tableStats();
+    QUpdateStats updates = agent.takeUpdateStats();
+    if (agent2) {
+        QTableStats table2 = agent2->tableStats();
+        QUpdateStats updates2 = agent2->takeUpdateStats();
+        table.states += table2.states;
+        table.buckets += table2.buckets;
+        table.bytes += table2.bytes;
+        table.loadFactor = table.buckets ? double(table.states) / double(table.buckets) : 0.0;
+        updates.updates += updates2.updates;
+        updates.absTdError += updates2.absTdError;
+    }
+    double meanTd = updates.updates ? updates.absTdError / double(updates.updates) : 0.0;
+
+    double inWindow = double(recent.size());
+    double win  = inWindow > 0 ? double(windowCounts[0]) / inWindow : 0.0;
+    double draw = inWindow > 0 ? double(windowCounts[1]) / inWindow : 0.0;
+    double loss = inWindow > 0 ? double(windowCounts[2]) / inWindow : 0.0;
+    size_t rss = residentMemoryBytes();
+
+    std::ostringstream line;
+    line << std::setprecision(6);
+    if (csv) {
+        line << episodes << ',' << elapsed << ',' << episodesPerSec << ',' << stepsPerSec << ','
+             << table.states << ',' << table.bytes << ',' << table.loadFactor << ','
+             << meanTd << ',' << win << ',' << draw << ',' << loss << ',' << recent.size() << ','
+             << agent.getEpsilon() << ',' << rss << "\n";
+    } else {
+        line << "{\"episodes\": " << episodes
+             << ", \"elapsed_s\": " << elapsed
+             << ", \"episodes_per_s\": " << episodesPerSec
+             << ", \"steps_per_s\": " << stepsPerSec
+             << ", \"states\": " << table.states
+             << ", \"table_bytes\": " << table.bytes
+             << ", \"load_factor\": " << table.loadFactor
+             << ", \"mean_abs_td\": " << meanTd
+             << ", \"win\": " << win
+             << ", \"draw\": " << draw
+             << ", \"loss\": " << loss
+             << ", \"window\": " << recent.size()
+             << ", \"epsilon\": " << agent.getEpsilon()
+             << ", \"rss_bytes\": " << rss << "}\n";
+    }
+    out << line.str();
+    out.flush();
+
+    last = now;
+    lastEpisodes = episodes;
+    steps = 0;
+}
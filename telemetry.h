@@ -0,0 +1,63 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <cstdint>
+#include "qlearning.h"
+
+// resident set size of this process in bytes, 0 if unknown
+size_t residentMemoryBytes();
+
+// structured progress records for long training runs, one every N
+// episodes: throughput, table growth, mean |TD error|, recent results
+// and memory, as JSON lines or (for a .csv filename) CSV rows
+//
+// each training loop owns its own TrainingTelemetry, so record() is a
+// couple of plain increments on the thread that plays the episodes;
+// everything else happens in sample(), once per interval
+class TrainingTelemetry {
+public:
+    // startEpisodes: episode count the run starts (or resumes) from;
+    // window: how many recent episodes the win/draw/loss rates cover
+    bool open(const std::string& filename, long long startEpisodes, int window = 1000);
+    bool isOpen() const { return out.is_open(); }
+
+    // result of one episode, winner from player 1's point of view
+    void record(int winner, int moves) {
+        if (windowSize == 0) {
+            return; // not open
+        }
+        steps += moves;
+        int outcome = (winner == 1) ? 0 : (winner == 0) ? 1 : 2;
+        if (recent.size() < windowSize) {
+            recent.push_back(uint8_t(outcome));
+        } else {
+            windowCounts[recent[next]]--;
+            recent[next] = uint8_t(outcome);
+            next = (next + 1) % recent.size();
+        }
+        windowCounts[outcome]++;
+    }
+
+    // writes one record; agent2 is the second learner in self-play
+    void sample(long long episodes, QLearningAgent& agent, QLearningAgent* agent2);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    std::ofstream out;
+    bool csv = false;
+    Clock::time_point start, last;
+    long long lastEpisodes = 0;
+    long long steps = 0;          // moves played since the last sample
+
+    std::vector<uint8_t> recent;   // ring of outcomes: 0 win, 1 draw, 2 loss
+    size_t windowSize = 0;
+    size_t next = 0;              // oldest entry once the ring is full
+    long long windowCounts[3] = { 0, 0, 0 };
+};
+
+#endif
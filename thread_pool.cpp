@@ -0,0 +1,66 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threads) {
+    for (int t = 1; t < std::max(1, threads); ++t) {
+        workers.emplace_back(&ThreadPool::run, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& t : workers) {
+        t.join();
+    }
+}
+
+// takes indices of the current job until there are none left
+void ThreadPool::drain() {
+    for (;;) {
+        int i = nextIndex.fetch_add(1);
+        if (i >= jobSize) break;
+        (*job)(i);
+    }
+}
+
+void ThreadPool::parallelFor(int n, const std::function<void(int)>& fn) {
+    if (workers.empty() || n <= 1) {
+        for (int i = 0; i < n; ++i) fn(i);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        jobSize = n;
+        nextIndex.store(0);
+        busy = int(workers.size());
+        generation++;
+    }
+    wake.notify_all();
+    drain();
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return busy == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::run() {
+    long long seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping) {
+            return;
+        }
+        seen = generation;
+        lock.unlock();
+        drain();
+        lock.lock();
+        if (--busy == 0) {
+            done.notify_one();
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+// fixed set of worker threads for fork-join loops: parallelFor hands
+// out indices one at a time and returns when all are done. the calling
+// thread works too, so a pool of n threads runs n - 1 workers
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int threads() const { return int(workers.size()) + 1; }
+
+    // fn(i) for every i in [0, n); one loop at a time per pool
+    void parallelFor(int n, const std::function<void(int)>& fn);
+
+private:
+    void run();
+    void drain();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int)>* job = nullptr;
+    int jobSize = 0;
+    std::atomic<int> nextIndex{0};
+    int busy = 0;
+    long long generation = 0;
+    bool stopping = false;
+};
+
+#endif
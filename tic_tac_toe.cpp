@@ -1,12 +1,25 @@
 #include "tic_tac_toe.h"
+#include "position_table.h"
+#include "profiler.h"
 #include <iostream>
 
 TicTacToe::TicTacToe()
-    : board(3, std::vector<int>(3, 0))
+    : board(3, std::vector<int>(3, 0)), position(0)
 {
     // initialize 3x3 grid of 0
 }
 
+TicTacToe TicTacToe::fromPositionIndex(int index) {
+    TicTacToe game;
+    for (int c = 0; c < 9; ++c) {
+        int v = (index / kPow3[c]) % 3;
+        if (v != 0) {
+            game.makeMove(c % 3, c / 3, v);
+        }
+    }
+    return game;
+}
+
 void TicTacToe::printBoard() const {
     std::cout << "\n";
     for (int y = 2; y >= 0; --y) {
@@ -27,16 +40,19 @@ void TicTacToe::printBoard() const {
 }
 
 bool TicTacToe::makeMove(int x, int y, int player) {
+    PROFILE_SCOPE("TicTacToe::makeMove");
     // validate co-ords
     if (x < 0 || x > 2 || y < 0 || y > 2) return false;
     if (board[y][x] != 0) return false;
 
     // enter value
     board[y][x] = player;
+    position += player * kPow3[y * 3 + x];
     return true;
 }
 
 void TicTacToe::undoMove(int x, int y) {
+    position -= board[y][x] * kPow3[y * 3 + x];
     board[y][x] = 0;
 }
 
@@ -46,55 +62,15 @@ bool TicTacToe::isValidMove(int x, int y) const {
 }
 
 int TicTacToe::checkWin() const {
-    // check rows
-    for (int y = 0; y < 3; ++y) {
-        if (board[y][0] != 0 &&
-            board[y][0] == board[y][1] &&
-            board[y][1] == board[y][2]) {
-            return board[y][0];
-        }
-    }
-    // check cols
-    for (int x = 0; x < 3; ++x) {
-        if (board[0][x] != 0 &&
-            board[0][x] == board[1][x] &&
-            board[1][x] == board[2][x]) {
-            return board[0][x];
-        }
-    }
-    // check diagonals
-    if (board[1][1] != 0) {
-        if (board[0][0] == board[1][1] &&
-            board[1][1] == board[2][2]) {
-            return board[1][1];
-        }
-        if (board[2][0] == board[1][1] &&
-            board[1][1] == board[0][2]) {
-            return board[1][1];
-        }
-    }
-
-    return 0; // no winner
+    // rows, cols, then diagonals - see position_table.cpp
+    return positionInfo(position).winner;
 }
 
 bool TicTacToe::isFull() const {
-    for (int y = 0; y < 3; ++y) {
-        for (int x = 0; x < 3; ++x) {
-            if (board[y][x] == 0) {
-                return false;
-            }
-        }
-    }
-    return true;
+    return (positionInfo(position).flags & kPosFull) != 0;
 }
 
 bool TicTacToe::isGameOver() const {
     // end game if board is full, or no winner
-    if (checkWin() != 0) {
-        return true;
-    }
-    if (isFull()) {
-        return true;
-    }
-    return false;
+    return isTerminalPosition(position);
 }
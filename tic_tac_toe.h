@@ -10,6 +10,9 @@ class TicTacToe {
 public:
     TicTacToe();
 
+    // rebuilds a board from its position table index
+    static TicTacToe fromPositionIndex(int index);
+
     // prints the current board state
     //   bottom left is (0, 0)
     //   uses '1' and '2' to indicate player pieces, '.' for empty
@@ -35,8 +38,15 @@ public:
 
     const Board& getBoard() const { return board; }
 
+    // base-3 index of the board, see position_table.h
+    int positionIndex() const { return position; }
+
 private:
     Board board;
+
+    // kept in step with board by makeMove / undoMove so the
+    // win / full / game over checks are single table lookups
+    int position;
 };
 
 #endif
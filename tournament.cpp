@@ -0,0 +1,274 @@
+#include "tournament.h"
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "profiler.h"
+#include "position_table.h"
+
+// games per unit of work: big enough that taking a chunk costs nothing
+// next to playing it, small enough to keep every thread busy at the end
+static const long long kChunkGames = 4096;
+
+struct Chunk {
+    int first;
+    int second;
+    long long games;
+    Rng rng;
+};
+
+// the chunk's games are played side by side, a ply at a time: at each
+// ply every unfinished game has the same seat to move, so that seat gets
+// all of their boards in one Player::moves call
+static void playChunk(const Player& first, const Player& second, Chunk& chunk, PairResult& out) {
+    PROFILE_SCOPE("tournament/chunk");
+    const Player* seat[2] = { &first, &second };
+    std::vector<uint16_t> boards(size_t(chunk.games), 0);
+    std::vector<int8_t> actions(boards.size());
+    for (int ply = 0; !boards.empty(); ++ply) {
+        int current = 1 + (ply & 1);
+        seat[current - 1]->moves(boards.data(), int(boards.size()), actions.data(), chunk.rng);
+        size_t live = 0;
+        for (size_t g = 0; g < boards.size(); ++g) {
+            int index = boards[g];
+            if (actions[g] >= 0) {
+                index += current * kPow3[actions[g]];
+            }
+            const PositionInfo& info = positionInfo(index);
+            if (actions[g] < 0 || (info.flags & kPosTerminal)) {
+                out.wins[info.winner]++;
+            } else {
+                boards[live++] = uint16_t(index);
+            }
+        }
+        boards.resize(live);
+    }
+    out.games += chunk.games;
+}
+
+TournamentResult runTournament(const std::vector<std::unique_ptr<Player>>& players,
+                               long long gamesPerSeating, int threads, Rng& rng,
+                               const std::function<void(long long, long long)>& progress) {
+    int n = int(players.size());
+    TournamentResult result;
+    result.players = n;
+    result.seated.assign(size_t(n) * n, PairResult());
+
+    std::vector<Chunk> chunks;
+    for (int a = 0; a < n; ++a) {
+        for (int b = 0; b < n; ++b) {
+            if (a == b) continue;
+            for (long long start = 0; start < gamesPerSeating; start += kChunkGames) {
+                chunks.push_back({ a, b, std::min(kChunkGames, gamesPerSeating - start), rng.split() });
+            }
+        }
+    }
+    long long totalGames = gamesPerSeating * n * (n - 1);
+
+    // chunk results are kept apart and summed at the end, so workers
+    // never write to the same counters
+    std::vector<PairResult> chunkResults(chunks.size());
+    std::atomic<size_t> nextChunk(0);
+    std::atomic<long long> gamesDone(0);
+    auto worker = [&]() {
+        for (;;) {
+            size_t c = nextChunk.fetch_add(1);
+            if (c >= chunks.size()) break;
+            playChunk(*players[chunks[c].first], *players[chunks[c].second], chunks[c], chunkResults[c]);
+            gamesDone.fetch_add(chunks[c].games);
+        }
+    };
+
+    using namespace std::chrono;
+    auto start = steady_clock::now();
+    threads = std::max(1, std::min<int>(threads, int(chunks.size())));
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+    while (gamesDone.load() < totalGames) {
+        std::this_thread::sleep_for(milliseconds(100));
+        progress(gamesDone.load(), totalGames);
+    }
+    for (std::thread& t : pool) {
+        t.join();
+    }
+    result.seconds = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        PairResult& pair = result.seated[chunks[c].first * n + chunks[c].second];
+        pair.games += chunkResults[c].games;
+        for (int w = 0; w < 3; ++w) {
+            pair.wins[w] += chunkResults[c].wins[w];
+        }
+    }
+    return result;
+}
+
+// maximum likelihood Bradley-Terry fit by minorization-maximization
+// (Hunter 2004): p_i = W_i / sum_j n_ij / (p_i + p_j). points[i * n + j]
+// is i's score against j out of games[i * n + j]. one virtual draw per
+// pairing keeps a player who never scored at a finite rating
+static std::vector<double> fitElo(int n, const std::vector<double>& games,
+                                  const std::vector<double>& points) {
+    std::vector<double> p(n, 1.0);
+    std::vector<double> next(n);
+    for (int iter = 0; iter < 10000; ++iter) {
+        double change = 0.0;
+        for (int i = 0; i < n; ++i) {
+            double scored = 0.0;
+            double denom = 0.0;
+            for (int j = 0; j < n; ++j) {
+                double g = games[i * n + j];
+                if (j == i || g <= 0.0) continue;
+                scored += points[i * n + j] + 0.5;
+                denom += (g + 1.0) / (p[i] + p[j]);
+            }
+            next[i] = denom > 0.0 ? scored / denom : 1.0;
+        }
+        // geometric mean 1, so ratings come out with mean 0
+        double logMean = 0.0;
+        for (double v : next) logMean += std::log(v);
+        double scale = std::exp(-logMean / n);
+        for (int i = 0; i < n; ++i) {
+            next[i] *= scale;
+            change = std::max(change, std::fabs(std::log(next[i] / p[i])));
+        }
+        p.swap(next);
+        if (change < 1e-10) break;
+    }
+    std::vector<double> elo(n);
+    for (int i = 0; i < n; ++i) {
+        elo[i] = 400.0 * std::log10(p[i]);
+    }
+    return elo;
+}
+
+static double normal(Rng& rng) {
+    // Box-Muller
+    double u = 1.0 - rng.uniformReal();
+    double v = rng.uniformReal();
+    return std::sqrt(-2.0 * std::log(u)) * std::cos(6.283185307179586 * v);
+}
+
+std::vector<Rating> bradleyTerryRatings(const TournamentResult& result, int resamples, Rng& rng) {
+    int n = result.players;
+    std::vector<double> games(size_t(n) * n, 0.0);
+    std::vector<double> points(size_t(n) * n, 0.0);
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            if (i == j) continue;
+            games[i * n + j] = double(result.games(i, j));
+            points[i * n + j] = result.points(i, j);
+        }
+    }
+
+    std::vector<Rating> ratings(n);
+    std::vector<double> elo = fitElo(n, games, points);
+    for (int i = 0; i < n; ++i) {
+        ratings[i].elo = ratings[i].low = ratings[i].high = elo[i];
+    }
+    if (resamples <= 0) {
+        return ratings;
+    }
+
+    // resample each pairing's mean score from its normal approximation:
+    // per-game scores are 0, 1/2 or 1, with the observed mean and spread
+    std::vector<std::vector<double>> samples(n);
+    std::vector<double> resampled(points.size());
+    for (int r = 0; r < resamples; ++r) {
+        for (int i = 0; i < n; ++i) {
+            for (int j = i + 1; j < n; ++j) {
+                double g = games[i * n + j];
+                if (g <= 0.0) continue;
+                const PairResult& ij = result.at(i, j);
+                const PairResult& ji = result.at(j, i);
+                double mean = points[i * n + j] / g;
+                double wins = double(ij.wins[1] + ji.wins[2]);
+                double draws = double(ij.wins[0] + ji.wins[0]);
+                double var = std::max(0.0, (wins + 0.25 * draws) / g - mean * mean);
+                double s = std::min(1.0, std::max(0.0, mean + std::sqrt(var / g) * normal(rng)));
+                resampled[i * n + j] = s * g;
+                resampled[j * n + i] = (1.0 - s) * g;
+            }
+        }
+        std::vector<double> e = fitElo(n, games, resampled);
+        for (int i = 0; i < n; ++i) {
+            samples[i].push_back(e[i]);
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        std::sort(samples[i].begin(), samples[i].end());
+        ratings[i].low = samples[i][size_t(std::floor(0.025 * (resamples - 1)))];
+        ratings[i].high = samples[i][size_t(std::ceil(0.975 * (resamples - 1)))];
+    }
+    return ratings;
+}
+
+void printTournament(std::ostream& out, const std::vector<std::unique_ptr<Player>>& players,
+                     const TournamentResult& result, const std::vector<Rating>& ratings) {
+    int n = result.players;
+    char line[256];
+
+    out << "\nParticipants:\n";
+    for (int i = 0; i < n; ++i) {
+        std::snprintf(line, sizeof(line), "  %2d  %s\n", i + 1, players[i]->name().c_str());
+        out << line;
+    }
+
+    out << "\nCross-table: row player's score against the column player, both seats (%)\n     ";
+    for (int j = 0; j < n; ++j) {
+        std::snprintf(line, sizeof(line), "%7d", j + 1);
+        out << line;
+    }
+    out << "\n";
+    for (int i = 0; i < n; ++i) {
+        std::snprintf(line, sizeof(line), "  %2d ", i + 1);
+        out << line;
+        for (int j = 0; j < n; ++j) {
+            long long g = result.games(i, j);
+            if (i == j || g == 0) {
+                std::snprintf(line, sizeof(line), "%7s", "-");
+            } else {
+                std::snprintf(line, sizeof(line), "%7.1f", 100.0 * result.points(i, j) / double(g));
+            }
+            out << line;
+        }
+        out << "\n";
+    }
+
+    out << "\nBy seat: first vs second, first wins / draws / second wins\n";
+    for (int a = 0; a < n; ++a) {
+        for (int b = 0; b < n; ++b) {
+            const PairResult& r = result.at(a, b);
+            if (a == b || r.games == 0) continue;
+            std::snprintf(line, sizeof(line), "  %2d vs %2d: %lld / %lld / %lld\n",
+                          a + 1, b + 1, r.wins[1], r.wins[0], r.wins[2]);
+            out << line;
+        }
+    }
+
+    std::vector<int> order(n);
+    for (int i = 0; i < n; ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return ratings[a].elo > ratings[b].elo;
+    });
+    out << "\nRatings (Bradley-Terry, Elo scale, mean 0, 95% interval):\n";
+    for (int rank = 0; rank < n; ++rank) {
+        int i = order[rank];
+        double scored = 0.0;
+        long long games = 0;
+        for (int j = 0; j < n; ++j) {
+            if (j == i) continue;
+            scored += result.points(i, j);
+            games += result.games(i, j);
+        }
+        std::snprintf(line, sizeof(line), "  %2d. %-40s %8.1f  [%8.1f, %8.1f]  score %5.1f%%\n",
+                      rank + 1, players[i]->name().c_str(), ratings[i].elo,
+                      ratings[i].low, ratings[i].high,
+                      games ? 100.0 * scored / double(games) : 0.0);
+        out << line;
+    }
+}
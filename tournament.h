@@ -0,0 +1,58 @@
+#ifndef TOURNAMENT_H
+#define TOURNAMENT_H
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <ostream>
+#include <cstdint>
+#include "player.h"
+
+// results of one seat order: first moves first
+struct PairResult {
+    long long games = 0;
+    long long wins[3] = { 0, 0, 0 };   // by winner, 0 = draw
+};
+
+struct TournamentResult {
+    int players = 0;
+    std::vector<PairResult> seated;    // [first * players + second]
+    double seconds = 0.0;
+
+    const PairResult& at(int first, int second) const { return seated[first * players + second]; }
+
+    // games between a and b, both seat orders
+    long long games(int a, int b) const { return at(a, b).games + at(b, a).games; }
+
+    // a's points against b over both seat orders: 1 a win, 1/2 a draw
+    double points(int a, int b) const {
+        return double(at(a, b).wins[1] + at(b, a).wins[2])
+             + 0.5 * double(at(a, b).wins[0] + at(b, a).wins[0]);
+    }
+};
+
+// every ordered pair of different players plays gamesPerSeating games,
+// split into fixed chunks that threads take in turn. each chunk has its
+// own rng split from rng up front, so results depend on the seed and not
+// on the thread count. progress(done, total) is called on the calling
+// thread while the games run
+TournamentResult runTournament(const std::vector<std::unique_ptr<Player>>& players,
+                               long long gamesPerSeating, int threads, Rng& rng,
+                               const std::function<void(long long, long long)>& progress);
+
+// Bradley-Terry strengths on the Elo scale (mean 0), a draw counting as
+// half a win; low and high are a 95% interval from resampling every
+// pairing's score (parametric bootstrap)
+struct Rating {
+    double elo = 0.0;
+    double low = 0.0;
+    double high = 0.0;
+};
+
+std::vector<Rating> bradleyTerryRatings(const TournamentResult& result, int resamples, Rng& rng);
+
+// participants, cross-table, results by seat and the rating list
+void printTournament(std::ostream& out, const std::vector<std::unique_ptr<Player>>& players,
+                     const TournamentResult& result, const std::vector<Rating>& ratings);
+
+#endif
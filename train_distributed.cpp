@@ -0,0 +1,609 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "tic_tac_toe.h"
+#include "position_table.h"
+#include "qlearning.h"
+#include "opponents.h"
+#include "training.h"
+#include "policy_snapshot.h"
+#include "policy_protocol.h"
+#include "param_protocol.h"
+#include "rng.h"
+
+// Q-learning spread over processes, with a parameter server
+//
+//   train_distributed [--workers N] [--episodes N] [--opponent name]
+//                     [--push-every N] [--broadcast-ms N] [--listen address]
+//                     [--delta-scale X] [--out file] [--seed N]
+//                     [--alpha A] [--gamma G] [--epsilon E]
+//
+// the default mode is a localhost harness: it listens on address (a socket
+// path, default ttt_params.sock, or [host:]port for TCP), starts N worker
+// processes of this program and serves them until every worker is done,
+// printing aggregate and per-worker episodes/s every second. --episodes
+// is the total, split between the workers. the opponent is random,
+// minimax, buggy or buggy2 (default random), player 2 as in tic_tac_toe
+//
+//   train_distributed --server [--workers N] ...   serve, launching nothing
+//   train_distributed --worker --connect address [--worker-id N] ...
+//
+// for workers started by hand, on this or another host
+//
+// each worker plays episodes with the usual QLearningAgent update on its
+// own copy of the table. every --push-every episodes it sends the updates
+// since the last push, summed per (state, action), and takes in whatever
+// rows the server has sent meanwhile: a received row replaces the local
+// one, plus the worker's own updates not yet pushed. the server adds the
+// deltas to its table as they come, times --delta-scale, and every
+// --broadcast-ms sends each worker the rows changed since the version it
+// last got. workers never wait for the server, so the deltas they push
+// are computed against rows that may be a few pushes stale
+//
+// a worker's summed deltas for a common state are close to the whole
+// correction it needs, and N workers would apply it N times over, so the
+// scale defaults to 1 / --workers: the server moves by the mean of the
+// workers' corrections. the merged table is written to --out (default
+// q_policy_distributed.dat) at the end, with a .meta sidecar
+
+struct DistributedConfig {
+    int workers = 4;
+    long long episodes = 1000000;
+    std::string opponent = "random";
+    int pushEvery = 100;
+    int broadcastMs = 50;
+    double deltaScale = 0.0;       // 0 => 1 / workers
+    std::string address = kDefaultParamAddress;
+    std::string out = "q_policy_distributed.dat";
+    double alpha = 0.1;
+    double gamma = 1.0;
+    double epsilon = 0.2;
+    int workerId = 0;
+};
+
+#ifndef __linux__
+
+int main() {
+    std::cerr << "train_distributed needs Linux\n";
+    return 1;
+}
+
+#else
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <unistd.h>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+
+static const OpponentTable* opponentTable(const std::string& name) {
+    if (name == "random")  return &randomTable();
+    if (name == "minimax") return &minimaxTable();
+    if (name == "buggy")   return &buggyMinimaxTable();
+    if (name == "buggy2")  return &buggyMinimax2Table();
+    return nullptr;
+}
+
+static volatile std::sig_atomic_t g_stop = 0;
+
+static void onSignal(int) {
+    g_stop = 1;
+}
+
+static void appendMessage(std::vector<char>& out, uint32_t type, uint32_t value,
+                          const void* records, size_t bytes) {
+    ParamHeader h;
+    h.type = type;
+    h.bytes = uint32_t(sizeof(value) + bytes);
+    const char* p = reinterpret_cast<const char*>(&h);
+    out.insert(out.end(), p, p + sizeof(h));
+    p = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), p, p + sizeof(value));
+    p = static_cast<const char*>(records);
+    out.insert(out.end(), p, p + bytes);
+}
+
+// the next whole message in in[pos..), advancing pos past it; false if
+// it has not all arrived yet
+static bool nextMessage(const std::vector<char>& in, size_t& pos, ParamHeader& h,
+                        uint32_t& value, const char*& records, size_t& bytes) {
+    if (in.size() - pos < sizeof(h)) {
+        return false;
+    }
+    std::memcpy(&h, in.data() + pos, sizeof(h));
+    if (h.bytes < sizeof(value) || in.size() - pos - sizeof(h) < h.bytes) {
+        return false;
+    }
+    std::memcpy(&value, in.data() + pos + sizeof(h), sizeof(value));
+    records = in.data() + pos + sizeof(h) + sizeof(value);
+    bytes = h.bytes - sizeof(value);
+    pos += sizeof(h) + h.bytes;
+    return true;
+}
+
+// reads what the socket has without blocking; false if the peer closed
+// or the socket failed
+static bool readAvailable(int fd, std::vector<char>& in) {
+    char buf[64 * 1024];
+    for (;;) {
+        ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n == 0) {
+            return false;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        in.insert(in.end(), buf, buf + n);
+    }
+}
+
+static bool sendAll(int fd, const std::vector<char>& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        sent += size_t(n);
+    }
+    return true;
+}
+
+static int runWorker(const DistributedConfig& cfg, const std::string& address) {
+    const OpponentTable* opponent = opponentTable(cfg.opponent);
+    int fd = connectTo(address);
+    if (fd < 0) {
+        return 1;
+    }
+    QLearningAgent agent(cfg.alpha, cfg.gamma, cfg.epsilon);
+    Rng opponentRng = makeStream(nextStreamId());
+    std::vector<QDelta> log;
+    agent.setDeltaLog(&log);
+
+    // updates since the last push, summed per (state, action)
+    std::vector<double> pending(size_t(kNumPositions) * 9, 0.0);
+    std::vector<uint8_t> isTouched(kNumPositions, 0);
+    std::vector<int> touched;
+
+    std::vector<char> in;
+    std::vector<char> out;
+    std::vector<QDelta> deltas;
+    std::vector<PolicyEntry> rows;
+    std::vector<int> rowOf(kNumPositions, -1);
+    bool connected = true;
+
+    auto push = [&](uint32_t episodes) {
+        for (const QDelta& d : log) {
+            if (!isTouched[d.state]) {
+                isTouched[d.state] = 1;
+                touched.push_back(d.state);
+            }
+            pending[size_t(d.state) * 9 + d.action] += d.dq;
+        }
+        log.clear();
+
+        // the newest copy of each row the server sent, plus what the
+        // server has not seen yet
+        connected = readAvailable(fd, in) && connected;
+        size_t pos = 0;
+        ParamHeader h;
+        uint32_t version;
+        const char* records;
+        size_t bytes;
+        rows.clear();
+        while (nextMessage(in, pos, h, version, records, bytes)) {
+            if (h.type != kParamRows) continue;
+            for (size_t off = 0; off + sizeof(ParamRow) <= bytes; off += sizeof(ParamRow)) {
+                ParamRow r;
+                std::memcpy(&r, records + off, sizeof(r));
+                if (r.state >= kNumPositions) continue;
+                if (rowOf[r.state] < 0) {
+                    rowOf[r.state] = int(rows.size());
+                    rows.emplace_back();
+                    positionString(r.state).copy(rows.back().state, 9);
+                }
+                std::copy(r.q, r.q + 9, rows[rowOf[r.state]].qvals.begin());
+            }
+        }
+        in.erase(in.begin(), in.begin() + pos);
+        for (PolicyEntry& e : rows) {
+            int state = positionIndexFromString(std::string(e.state, 9));
+            for (int a = 0; a < 9; ++a) {
+                e.qvals[a] += pending[size_t(state) * 9 + a];
+            }
+            rowOf[state] = -1;
+        }
+        agent.mergeRows(rows);
+
+        deltas.clear();
+        for (int state : touched) {
+            for (int a = 0; a < 9; ++a) {
+                double& dq = pending[size_t(state) * 9 + a];
+                if (dq != 0.0) {
+                    deltas.push_back({ uint16_t(state), uint8_t(a), 0, float(dq) });
+                    dq = 0.0;
+                }
+            }
+            isTouched[state] = 0;
+        }
+        touched.clear();
+        out.clear();
+        appendMessage(out, kParamDeltas, episodes, deltas.data(), deltas.size() * sizeof(QDelta));
+        connected = sendAll(fd, out) && connected;
+    };
+
+    out.clear();
+    appendMessage(out, kParamHello, uint32_t(cfg.workerId), nullptr, 0);
+    connected = sendAll(fd, out);
+
+    long long played = 0;
+    uint32_t sincePush = 0;
+    OpponentMoveFn move = [&](TicTacToe& env, int) { return opponent->sample(env, opponentRng); };
+    while (played < cfg.episodes && connected && !g_stop) {
+        playTrainingEpisode(agent, move);
+        played++;
+        if (++sincePush == uint32_t(cfg.pushEvery)) {
+            push(sincePush);
+            sincePush = 0;
+        }
+    }
+    if (connected) {
+        push(sincePush);
+        out.clear();
+        appendMessage(out, kParamDone, uint32_t(played), nullptr, 0);
+        connected = sendAll(fd, out);
+    }
+    close(fd);
+    if (!connected) {
+        std::cerr << "worker " << cfg.workerId << ": lost the server after "
+                  << played << " episodes\n";
+        return 1;
+    }
+    return 0;
+}
+
+struct WorkerConnection {
+    int fd = -1;
+    int id = -1;                   // from kParamHello
+    std::vector<char> in;
+    std::vector<char> out;         // rows not yet sent
+    size_t outSent = 0;
+    uint32_t knownVersion = 0;     // newest table version sent
+    long long episodes = 0;
+    long long intervalEpisodes = 0;
+    bool done = false;
+    bool closed = false;
+};
+
+struct ParamTable {
+    std::vector<double> q = std::vector<double>(size_t(kNumPositions) * 9, 0.0);
+    std::vector<uint32_t> rowVersion = std::vector<uint32_t>(kNumPositions, 0);   // 0 => never updated
+    uint32_t version = 0;
+    long long deltas = 0;
+    long long rowsSent = 0;
+};
+
+// sends as much of conn.out as the socket takes; false if the peer is gone
+static bool flushRows(WorkerConnection& conn) {
+    while (conn.outSent < conn.out.size()) {
+        ssize_t n = send(conn.fd, conn.out.data() + conn.outSent, conn.out.size() - conn.outSent,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        conn.outSent += size_t(n);
+    }
+    conn.out.clear();
+    conn.outSent = 0;
+    return true;
+}
+
+static void applyMessages(WorkerConnection& conn, ParamTable& table, double scale,
+                          long long& episodes) {
+    size_t pos = 0;
+    ParamHeader h;
+    uint32_t value;
+    const char* records;
+    size_t bytes;
+    while (nextMessage(conn.in, pos, h, value, records, bytes)) {
+        if (h.type == kParamHello) {
+            conn.id = int(value);
+        } else if (h.type == kParamDeltas) {
+            table.version++;
+            for (size_t off = 0; off + sizeof(QDelta) <= bytes; off += sizeof(QDelta)) {
+                QDelta d;
+                std::memcpy(&d, records + off, sizeof(d));
+                if (d.state >= kNumPositions || d.action >= 9) continue;
+                table.q[size_t(d.state) * 9 + d.action] += scale * d.dq;
+                table.rowVersion[d.state] = table.version;
+                table.deltas++;
+            }
+            conn.episodes += value;
+            conn.intervalEpisodes += value;
+            episodes += value;
+        } else if (h.type == kParamDone) {
+            conn.done = true;
+        }
+    }
+    conn.in.erase(conn.in.begin(), conn.in.begin() + pos);
+}
+
+// queues the rows conn has not seen, if it has taken everything sent before
+static void queueRows(WorkerConnection& conn, ParamTable& table, std::vector<ParamRow>& rows) {
+    if (conn.closed || conn.done || !conn.out.empty() || conn.knownVersion == table.version) {
+        return;
+    }
+    rows.clear();
+    for (int state = 0; state < kNumPositions; ++state) {
+        if (table.rowVersion[state] <= conn.knownVersion) continue;
+        ParamRow r;
+        r.state = uint16_t(state);
+        r.reserved[0] = r.reserved[1] = r.reserved[2] = 0;
+        std::copy(table.q.begin() + size_t(state) * 9, table.q.begin() + size_t(state) * 9 + 9, r.q);
+        rows.push_back(r);
+    }
+    appendMessage(conn.out, kParamRows, table.version, rows.data(), rows.size() * sizeof(ParamRow));
+    conn.knownVersion = table.version;
+    table.rowsSent += (long long)rows.size();
+}
+
+static void printRates(double seconds, double intervalSeconds, long long episodes,
+                       long long intervalEpisodes,
+                       const std::vector<std::unique_ptr<WorkerConnection>>& conns) {
+    std::printf("%7.1fs  %lld episodes, %.0f/s (%.0f/s overall)  workers:",
+                seconds, episodes, double(intervalEpisodes) / intervalSeconds,
+                seconds > 0 ? double(episodes) / seconds : 0.0);
+    for (const auto& c : conns) {
+        std::printf(" %d:%.0f/s", c->id, double(c->intervalEpisodes) / intervalSeconds);
+        c->intervalEpisodes = 0;
+    }
+    std::printf("\n");
+    std::fflush(stdout);
+}
+
+// serves until cfg.workers workers are done, every child in children has
+// exited, or Ctrl-C, then writes cfg.out; returns the exit status
+static int serve(int listenFd, const DistributedConfig& cfg, std::vector<pid_t>& children,
+                 uint64_t seed) {
+    using namespace std::chrono;
+    ParamTable table;
+    std::vector<std::unique_ptr<WorkerConnection>> conns;
+    std::vector<ParamRow> rows;
+    std::vector<pollfd> fds;
+    long long episodes = 0;
+    long long lastEpisodes = 0;
+    int doneWorkers = 0;
+    int failedChildren = 0;
+    bool harness = !children.empty();
+    auto start = steady_clock::now();
+    auto lastBroadcast = start;
+    auto lastReport = start;
+
+    while (!g_stop) {
+        fds.clear();
+        fds.push_back({ listenFd, POLLIN, 0 });
+        for (const auto& c : conns) {
+            short events = POLLIN;
+            if (!c->out.empty()) events |= POLLOUT;
+            fds.push_back({ c->fd, events, 0 });
+        }
+        int timeout = std::max(1, cfg.broadcastMs);
+        if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) {
+            std::cerr << "poll: " << std::strerror(errno) << "\n";
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            for (;;) {
+                int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0) break;
+                conns.emplace_back(new WorkerConnection());
+                conns.back()->fd = fd;
+            }
+        }
+        for (size_t i = 1; i < fds.size(); ++i) {
+            WorkerConnection& c = *conns[i - 1];
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                c.closed = !readAvailable(c.fd, c.in);
+                bool wasDone = c.done;
+                applyMessages(c, table, cfg.deltaScale, episodes);
+                doneWorkers += (c.done && !wasDone);
+            }
+            if (!c.closed && (fds[i].revents & POLLOUT)) {
+                c.closed = !flushRows(c);
+            }
+        }
+
+        auto now = steady_clock::now();
+        if (now - lastBroadcast >= milliseconds(cfg.broadcastMs)) {
+            lastBroadcast = now;
+            for (auto& c : conns) {
+                queueRows(*c, table, rows);
+                if (!c->closed) c->closed = !flushRows(*c);
+            }
+        }
+        if (now - lastReport >= seconds(1)) {
+            printRates(duration<double>(now - start).count(),
+                       duration<double>(now - lastReport).count(),
+                       episodes, episodes - lastEpisodes, conns);
+            lastEpisodes = episodes;
+            lastReport = now;
+        }
+
+        for (size_t i = 0; i < conns.size();) {
+            if (conns[i]->closed) {
+                if (!conns[i]->done) {
+                    std::cerr << "worker " << conns[i]->id << " disconnected before it was done\n";
+                }
+                close(conns[i]->fd);
+                conns.erase(conns.begin() + long(i));
+            } else {
+                ++i;
+            }
+        }
+        for (size_t i = 0; i < children.size();) {
+            int status = 0;
+            if (waitpid(children[i], &status, WNOHANG) == children[i]) {
+                failedChildren += !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+                children.erase(children.begin() + long(i));
+            } else {
+                ++i;
+            }
+        }
+        if (doneWorkers >= cfg.workers && conns.empty()) break;
+        if (harness && children.empty() && conns.empty()) break;
+    }
+
+    double seconds = duration<double>(steady_clock::now() - start).count();
+    std::printf("\n%lld episodes in %.2fs: %.0f episodes/s from %d workers\n"
+                "%lld deltas applied in %u pushes, %lld rows broadcast\n",
+                episodes, seconds, seconds > 0 ? double(episodes) / seconds : 0.0,
+                doneWorkers, table.deltas, table.version, table.rowsSent);
+
+    std::vector<PolicyEntry> entries;
+    for (int state = 0; state < kNumPositions; ++state) {
+        if (table.rowVersion[state] == 0) continue;
+        entries.emplace_back();
+        positionString(state).copy(entries.back().state, 9);
+        std::copy(table.q.begin() + size_t(state) * 9, table.q.begin() + size_t(state) * 9 + 9,
+                  entries.back().qvals.begin());
+    }
+    if (!writePolicyFile(entries, cfg.out)) {
+        std::cerr << "Could not write " << cfg.out << "\n";
+        return 1;
+    }
+    TrainingCheckpoint cp;
+    cp.opponent = cfg.opponent;
+    cp.episodes = episodes;
+    cp.seed = seed;
+    cp.alpha = cfg.alpha;
+    cp.gamma = cfg.gamma;
+    cp.epsilon = cfg.epsilon;
+    saveCheckpointMeta(cfg.out, cp);
+    std::cout << "Wrote " << entries.size() << " states to " << cfg.out << "\n";
+    return (failedChildren > 0 || g_stop) ? 1 : 0;
+}
+
+static std::string selfPath(const char* argv0) {
+    char buf[4096];
+    ssize_t n = readlink("/proc/self/exe", buf, sizeof(buf) - 1);
+    if (n > 0) {
+        return std::string(buf, size_t(n));
+    }
+    return argv0;
+}
+
+static pid_t launchWorker(const std::string& self, const DistributedConfig& cfg, int id,
+                          long long episodes, uint64_t seed) {
+    std::vector<std::string> args = {
+        self, "--worker", "--connect", cfg.address, "--worker-id", std::to_string(id),
+        "--episodes", std::to_string(episodes), "--seed", std::to_string(seed),
+        "--opponent", cfg.opponent, "--push-every", std::to_string(cfg.pushEvery),
+        "--alpha", std::to_string(cfg.alpha), "--gamma", std::to_string(cfg.gamma),
+        "--epsilon", std::to_string(cfg.epsilon)
+    };
+    pid_t pid = fork();
+    if (pid == 0) {
+        std::vector<char*> argv;
+        for (std::string& a : args) argv.push_back(&a[0]);
+        argv.push_back(nullptr);
+        execv(self.c_str(), argv.data());
+        std::perror("execv");
+        _exit(127);
+    }
+    if (pid < 0) {
+        std::perror("fork");
+    }
+    return pid;
+}
+
+int main(int argc, char** argv) {
+    uint64_t seed = seedFromArgs(argc, argv);
+    DistributedConfig cfg;
+    bool server = false;
+    bool worker = false;
+    std::string connect;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--server") { server = true; continue; }
+        if (arg == "--worker") { worker = true; continue; }
+        if (i + 1 >= argc) {
+            std::cerr << "missing value for " << arg << "\n";
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (arg == "--workers")           cfg.workers = std::max(1, std::atoi(value));
+        else if (arg == "--episodes")     cfg.episodes = std::atoll(value);
+        else if (arg == "--opponent")     cfg.opponent = value;
+        else if (arg == "--push-every")   cfg.pushEvery = std::max(1, std::atoi(value));
+        else if (arg == "--broadcast-ms") cfg.broadcastMs = std::max(1, std::atoi(value));
+        else if (arg == "--delta-scale")  cfg.deltaScale = std::atof(value);
+        else if (arg == "--listen")       cfg.address = value;
+        else if (arg == "--connect")      connect = value;
+        else if (arg == "--worker-id")    cfg.workerId = std::atoi(value);
+        else if (arg == "--out")          cfg.out = value;
+        else if (arg == "--alpha")        cfg.alpha = std::atof(value);
+        else if (arg == "--gamma")        cfg.gamma = std::atof(value);
+        else if (arg == "--epsilon")      cfg.epsilon = std::atof(value);
+        else if (arg != "--seed") {
+            std::cerr << "unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+    if (cfg.deltaScale <= 0.0) {
+        cfg.deltaScale = 1.0 / cfg.workers;
+    }
+    if (!opponentTable(cfg.opponent)) {
+        std::cerr << "unknown opponent " << cfg.opponent << " (random, minimax, buggy or buggy2)\n";
+        return 1;
+    }
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    if (worker) {
+        return runWorker(cfg, connect.empty() ? cfg.address : connect);
+    }
+
+    int listenFd = listenOn(cfg.address);
+    if (listenFd < 0) {
+        return 1;
+    }
+    std::cout << "===== Tic-Tac-Toe Distributed Training =====\n"
+              << "Seed: " << seed << "\n"
+              << "Listening on " << cfg.address << "\n"
+              << cfg.workers << " workers, " << (server ? "started elsewhere" : "local") << ", vs "
+              << cfg.opponent << ", push every " << cfg.pushEvery << " episodes, broadcast every "
+              << cfg.broadcastMs << " ms, delta scale " << cfg.deltaScale << "\n";
+    std::cout.flush();
+
+    std::vector<pid_t> children;
+    if (!server) {
+        std::string self = selfPath(argv[0]);
+        for (int i = 0; i < cfg.workers; ++i) {
+            long long share = cfg.episodes / cfg.workers + (i < cfg.episodes % cfg.workers ? 1 : 0);
+            uint64_t workerSeed = makeStream(nextStreamId()).next();
+            pid_t pid = launchWorker(self, cfg, i, share, workerSeed);
+            if (pid > 0) children.push_back(pid);
+        }
+    }
+    int status = serve(listenFd, cfg, children, seed);
+    closeListener(listenFd, cfg.address);
+    for (pid_t pid : children) {
+        kill(pid, SIGTERM);
+        waitpid(pid, nullptr, 0);
+    }
+    return status;
+}
+
+#endif
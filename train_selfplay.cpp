@@ -2,57 +2,9 @@
 #include <string>
 #include "tic_tac_toe.h"
 #include "qlearning.h"
-
-
-void trainSelfPlay(QLearningAgent& agent1,
-                   QLearningAgent& agent2,
-                   int episodes)
-{
-    for (int ep = 0; ep < episodes; ++ep)
-    {
-        TicTacToe env;
-        int currentPlayer = 1; 
-
-        while (!env.isGameOver())
-        {
-
-            QLearningAgent& currentAgent = (currentPlayer == 1) ? agent1 : agent2;
-
-            std::string stateStr = currentAgent.encodeBoard(env.getBoard());
-            int action = currentAgent.chooseAction(env);
-            if (action < 0) {
-                break; 
-            }
-
-            int x, y;
-            QLearningAgent::fromActionIndex(action, x, y);
-
-            env.makeMove(x, y, currentPlayer);
-
-            if (env.isGameOver())
-            {
-                int winner = env.checkWin();
-                double reward = 0.0;
-                if (winner == currentPlayer) {
-                    reward = 1.0;  
-                } else if (winner != 0) {
-                    reward = -1.0;  
-                }
-
-                currentAgent.updateQ(stateStr, action, /*nextState=*/"", reward, /*terminal=*/true);
-                break;
-            }
-            else
-            {
-                std::string nextState = currentAgent.encodeBoard(env.getBoard());
-                currentAgent.updateQ(stateStr, action, nextState, 0.0, /*terminal=*/false);
-            }
-
-            currentPlayer = 3 - currentPlayer; 
-        }
-    }
-    std::cout << "Finished self-play training of " << episodes << " episodes.\n";
-}
+#include "training.h"
+#include "rng.h"
+#include "profiler.h"
 
 
 void playMatches(QLearningAgent& agent1,
@@ -104,27 +56,83 @@ void playMatches(QLearningAgent& agent1,
               << "  Draws:         " << draws  << "\n";
 }
 
-int main()
+int main(int argc, char** argv)
 {
-    std::cout << "Self-Play Q-Learning Demo\n\n";
+    // "--seed N" reproduces a previous run
+    uint64_t seed = seedFromArgs(argc, argv);
+
+    // "--record games.tttg" keeps every training game, see game_record.h
+    std::string recordFile;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--record") {
+            recordFile = argv[i + 1];
+        }
+    }
 
-    int episodes = 0;
-    std::cout << "Enter the number of self-play training episodes: ";
+    std::cout << "Self-Play Q-Learning Demo (seed " << seed << ")\n\n";
+
+    long long episodes = 0;
+    std::cout << "Enter the number of self-play training episodes"
+              << " (total, including resumed ones): ";
     std::cin >> episodes;
     if (!std::cin.good() || episodes < 0) {
         std::cerr << "Invalid number.\n";
         return 1;
     }
 
-    QLearningAgent agent1(0.1, 1.0, 0.2);
-    QLearningAgent agent2(0.1, 1.0, 0.2);
+    // "--alpha A[:END] --gamma G --epsilon E[:END] [--decay linear|exp]
+    // [--update one-step|qlambda|mc] [--lambda L]"
+    HyperParams params = hyperParamsFromArgs(argc, argv);
+    QLearningAgent agent1(params.alpha.start, params.gamma, params.epsilon.start);
+    QLearningAgent agent2(params.alpha.start, params.gamma, params.epsilon.start);
+
+    // "--q-backend linear|mlp" learns a QModel per player, see q_model.h
+    QModelConfig modelConfig;
+    if (qModelConfigFromArgs(argc, argv, modelConfig)) {
+        agent1.setModel(modelConfig);
+        agent2.setModel(modelConfig);
+    }
+    agent1.setUpdateMode(params.update, params.lambda);
+    agent2.setUpdateMode(params.update, params.lambda);
 
     if (episodes > 0) {
+        TrainingRun run;
+        run.policyFile = "player1_policy.dat";
+        run.policyFile2 = "player2_policy.dat";
+        run.state.seed = seed;
+        run.recordFile = recordFile;
+        run.params = params;
+
+        std::cout << "Resume from player1_policy.dat / player2_policy.dat? (y/n): ";
+        std::string resume;
+        std::cin >> resume;
+        if (resume == "y" || resume == "Y") {
+            // both files are checkpointed together, so one sidecar is enough
+            TrainingCheckpoint ignored;
+            if (!resumeTraining(agent1, run.policyFile, run.params, run.state) ||
+                !resumeTraining(agent2, run.policyFile2, run.params, ignored)) {
+                return 1;
+            }
+        }
 
-        trainSelfPlay(agent1, agent2, episodes);
+        std::cout << "Checkpoint every how many episodes? (0 = only at the end): ";
+        std::cin >> run.checkpointEvery;
+        std::cout << "Keep a numbered snapshot every how many episodes? (0 = none, at least "
+                  << kMinSnapshotEvery << "): ";
+        std::cin >> run.snapshotEvery;
+        std::cout << "Write telemetry every how many episodes? (0 = none): ";
+        std::cin >> run.telemetryEvery;
+        if (!std::cin.good() || run.checkpointEvery < 0 || run.snapshotEvery < 0
+            || run.telemetryEvery < 0) {
+            std::cerr << "Invalid number.\n";
+            return 1;
+        }
+        if (run.telemetryEvery > 0) {
+            run.telemetryFile = "selfplay_telemetry.jsonl";
+            std::cout << "Telemetry -> " << run.telemetryFile << "\n";
+        }
 
-        agent1.savePolicy("player1_policy.dat");
-        agent2.savePolicy("player2_policy.dat");
+        trainSelfPlay(agent1, agent2, episodes, run);
     }
     else {
         std::cout << "Loading existing policies...\n";
@@ -144,6 +152,7 @@ int main()
         playMatches(agent1, agent2, matches);
     }
 
+    profileDump("train_selfplay");
     std::cout << "Done.\n";
     return 0;
 }
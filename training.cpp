@@ -0,0 +1,515 @@
+#include "training.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include "opponents.h"
+#include "opening_book.h"
+#include "policy_snapshot.h"
+#include "telemetry.h"
+#include "profiler.h"
+#include "game_record.h"
+
+std::string checkpointMetaFile(const std::string& policyFile) {
+    return policyFile + ".meta";
+}
+
+std::string formatCheckpointMeta(const TrainingCheckpoint& cp) {
+    std::ostringstream out;
+    out << std::setprecision(17)
+        << "opponent " << cp.opponent << "\n"
+        << "episodes " << cp.episodes << "\n"
+        << "seed " << cp.seed << "\n"
+        << "rng_agent " << cp.agentRng << "\n"
+        << "rng_agent2 " << cp.agent2Rng << "\n"
+        << "rng_opponent " << cp.opponentRng << "\n"
+        << "alpha " << cp.alpha << "\n"
+        << "gamma " << cp.gamma << "\n"
+        << "epsilon " << cp.epsilon << "\n"
+        << "update " << cp.update << "\n"
+        << "lambda " << cp.lambda << "\n";
+    return out.str();
+}
+
+bool saveCheckpointMeta(const std::string& policyFile, const TrainingCheckpoint& cp) {
+    std::string filename = checkpointMetaFile(policyFile);
+    std::ofstream out(filename);
+    if (!out) {
+        std::cerr << "could not open " << filename << " to write\n";
+        return false;
+    }
+    out << formatCheckpointMeta(cp);
+    return bool(out);
+}
+
+double Schedule::at(double progress) const {
+    progress = std::min(1.0, std::max(0.0, progress));
+    switch (decay) {
+    case Decay::None:
+        return start;
+    case Decay::Exponential:
+        if (start > 0.0 && end > 0.0) {
+            return start * std::pow(end / start, progress);
+        }
+        break;
+    case Decay::Linear:
+        break;
+    }
+    return start + (end - start) * progress;
+}
+
+const char* decayName(Decay decay) {
+    switch (decay) {
+    case Decay::Linear:      return "linear";
+    case Decay::Exponential: return "exp";
+    default:                 return "none";
+    }
+}
+
+bool parseDecay(const std::string& name, Decay& decay) {
+    if (name == "none")        decay = Decay::None;
+    else if (name == "linear") decay = Decay::Linear;
+    else if (name == "exp")    decay = Decay::Exponential;
+    else return false;
+    return true;
+}
+
+// "A" or "A:END"; true if there was an END
+static bool parseSchedule(const std::string& text, Schedule& schedule) {
+    std::string::size_type colon = text.find(':');
+    schedule.start = std::atof(text.c_str());
+    schedule.end = (colon == std::string::npos) ? schedule.start : std::atof(text.c_str() + colon + 1);
+    return colon != std::string::npos;
+}
+
+HyperParams hyperParamsFromArgs(int argc, char** argv) {
+    HyperParams params;
+    bool ranged = false;
+    Decay decay = Decay::Linear;
+    for (int i = 1; i + 1 < argc; ++i) {
+        std::string arg = argv[i];
+        std::string value = argv[i + 1];
+        if (arg == "--alpha")        ranged |= parseSchedule(value, params.alpha);
+        else if (arg == "--epsilon") ranged |= parseSchedule(value, params.epsilon);
+        else if (arg == "--gamma")   params.gamma = std::atof(value.c_str());
+        else if (arg == "--decay" && !parseDecay(value, decay)) {
+            std::cerr << "unknown --decay " << value << " (none, linear or exp), using linear\n";
+            decay = Decay::Linear;
+        }
+        else if (arg == "--update" && !parseUpdateMode(value, params.update)) {
+            std::cerr << "unknown --update " << value << " (one-step, qlambda or mc), using one-step\n";
+            params.update = UpdateMode::OneStep;
+        }
+        else if (arg == "--lambda")  params.lambda = std::atof(value.c_str());
+    }
+    if (ranged) {
+        for (Schedule* s : { &params.alpha, &params.epsilon }) {
+            s->decay = (s->end != s->start) ? decay : Decay::None;
+        }
+    }
+    return params;
+}
+
+void applyHyperParams(QLearningAgent& agent, const HyperParams& params, double progress) {
+    agent.setAlpha(params.alpha.at(progress));
+    agent.setGamma(params.gamma);
+    agent.setEpsilon(params.epsilon.at(progress));
+}
+
+// position of the extension's dot, or the end if there is none
+static std::string::size_type extensionStart(const std::string& filename) {
+    std::string::size_type dot = filename.rfind('.');
+    std::string::size_type slash = filename.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return filename.size();
+    }
+    return dot;
+}
+
+std::string snapshotFile(const std::string& policyFile, long long episodes) {
+    std::string::size_type dot = extensionStart(policyFile);
+    return policyFile.substr(0, dot) + "_ep" + std::to_string(episodes) + policyFile.substr(dot);
+}
+
+std::string telemetryFile(const std::string& policyFile) {
+    return policyFile.substr(0, extensionStart(policyFile)) + "_telemetry.jsonl";
+}
+
+bool loadCheckpointMeta(const std::string& policyFile, TrainingCheckpoint& cp) {
+    std::ifstream in(checkpointMetaFile(policyFile));
+    if (!in) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        if (key == "opponent")     fields >> cp.opponent;
+        else if (key == "episodes") fields >> cp.episodes;
+        else if (key == "seed")     fields >> cp.seed;
+        else if (key == "rng_agent")    fields >> cp.agentRng;
+        else if (key == "rng_agent2")   fields >> cp.agent2Rng;
+        else if (key == "rng_opponent") fields >> cp.opponentRng;
+        else if (key == "alpha")    fields >> cp.alpha;
+        else if (key == "gamma")    fields >> cp.gamma;
+        else if (key == "epsilon")  fields >> cp.epsilon;
+        else if (key == "update")   fields >> cp.update;
+        else if (key == "lambda")   fields >> cp.lambda;
+    }
+    return true;
+}
+
+// says so when a flag is overruled by the sidecar
+static void keepSaved(const char* name, const std::string& saved, const std::string& given) {
+    if (saved != given) {
+        std::cout << "resumed run keeps " << name << " " << saved
+                  << " from its sidecar, not " << given << "\n";
+    }
+}
+
+static std::string numberText(double value) {
+    std::ostringstream out;
+    out << value;
+    return out.str();
+}
+
+bool resumeTraining(QLearningAgent& agent, const std::string& policyFile,
+                    const HyperParams& params, TrainingCheckpoint& state) {
+    if (!agent.loadPolicy(policyFile)) {
+        return false;
+    }
+    TrainingCheckpoint saved;
+    if (loadCheckpointMeta(policyFile, saved)) {
+        state = saved;
+        UpdateMode mode;
+        if (!parseUpdateMode(state.update, mode)) {
+            std::cerr << "unknown update " << state.update << " in the sidecar, using one-step\n";
+            mode = UpdateMode::OneStep;
+            state.update = updateModeName(mode);
+        }
+        keepSaved("--update", state.update, updateModeName(params.update));
+        if (mode == UpdateMode::QLambda) {
+            keepSaved("--lambda", numberText(state.lambda), numberText(params.lambda));
+        }
+        agent.setUpdateMode(mode, state.lambda);
+        if (!params.decays()) {
+            keepSaved("--alpha", numberText(state.alpha), numberText(params.alpha.start));
+            keepSaved("--gamma", numberText(state.gamma), numberText(params.gamma));
+            keepSaved("--epsilon", numberText(state.epsilon), numberText(params.epsilon.start));
+            agent.setAlpha(state.alpha);
+            agent.setGamma(state.gamma);
+            agent.setEpsilon(state.epsilon);
+        }
+        std::cout << "resuming from episode " << state.episodes << "\n";
+    } else {
+        // warm start from an old policy with no sidecar
+        state.episodes = 0;
+        std::cout << "no " << checkpointMetaFile(policyFile)
+                  << ", warm start with episode count 0\n";
+    }
+    return true;
+}
+
+// queues policy files and sidecars for the current state of the run,
+// including every random stream, so resuming from it later continues
+// with exactly the numbers this run would have drawn next
+static void writeCheckpoint(const QLearningAgent& agent, const QLearningAgent* agent2,
+                            TrainingRun& run, PolicySnapshotter& writer) {
+    if (run.policyFile.empty()) {
+        return;
+    }
+    run.state.agentRng = agent.getRng().saveState();
+    run.state.agent2Rng = agent2 ? agent2->getRng().saveState() : "";
+    run.state.opponentRng = run.opponentRng.saveState();
+    run.state.alpha = agent.getAlpha();
+    run.state.gamma = agent.getGamma();
+    run.state.epsilon = agent.getEpsilon();
+    run.state.update = updateModeName(agent.getUpdateMode());
+    run.state.lambda = agent.getLambda();
+
+    std::string meta = formatCheckpointMeta(run.state);
+    writer.snapshot(agent, run.policyFile, checkpointMetaFile(run.policyFile), meta);
+    if (agent2 && !run.policyFile2.empty()) {
+        writer.snapshot(*agent2, run.policyFile2, checkpointMetaFile(run.policyFile2), meta);
+    }
+    std::cout << "Checkpoint at episode " << run.state.episodes
+              << " -> " << run.policyFile << "\n";
+}
+
+// numbered copy of the policy, for convergence curves
+static void writeSnapshot(const QLearningAgent& agent, const QLearningAgent* agent2,
+                          const TrainingRun& run, PolicySnapshotter& writer) {
+    if (run.policyFile.empty()) {
+        return;
+    }
+    writer.snapshot(agent, snapshotFile(run.policyFile, run.state.episodes));
+    if (agent2 && !run.policyFile2.empty()) {
+        writer.snapshot(*agent2, snapshotFile(run.policyFile2, run.state.episodes));
+    }
+}
+
+static void printProgress(long long done, long long total, long long startEpisodes,
+                          std::chrono::high_resolution_clock::time_point start) {
+    using namespace std::chrono;
+    auto now = high_resolution_clock::now();
+    double seconds = duration_cast<duration<double>>(now - start).count();
+    // estimate from this session's episodes only
+    double perEpisode = seconds / double(done - startEpisodes);
+    double timeRemaining = perEpisode * double(total - done);
+
+    std::cout << "Episode " << done << "/" << total << " completed. ";
+    std::cout << "Elapsed time: " << seconds
+              << "s, Estimated remaining time: "
+              << timeRemaining/60 << "min\n";
+}
+
+static double rewardFor(int winner, int player) {
+    if (winner == player) return 1.0;
+    if (winner != 0) return -1.0;
+    return 0.0;
+}
+
+EpisodeResult playTrainingEpisode(QLearningAgent& agent, const OpponentMoveFn& opponent) {
+    TicTacToe env;
+    EpisodeResult result;
+    int moves = 0;
+    while (!env.isGameOver()) {
+        std::string stateStr = agent.encodeBoard(env.getBoard());
+        int action = agent.chooseAction(env);
+        if (action < 0) break;
+
+        int ax, ay;
+        QLearningAgent::fromActionIndex(action, ax, ay);
+        env.makeMove(ax, ay, 1);
+        result.actions[moves++] = uint8_t(action);
+
+        if (env.isGameOver()) {
+            agent.updateQ(stateStr, action, "", rewardFor(env.checkWin(), 1), true);
+            break;
+        }
+
+        Move oppMove = opponent(env, 2);
+        env.makeMove(oppMove.x, oppMove.y, 2);
+        result.actions[moves++] = uint8_t(oppMove.y * 3 + oppMove.x);
+
+        std::string nextState = agent.encodeBoard(env.getBoard());
+        if (env.isGameOver()) {
+            agent.updateQ(stateStr, action, nextState, rewardFor(env.checkWin(), 1), true);
+        } else {
+            agent.updateQ(stateStr, action, nextState, 0.0, false);
+        }
+    }
+    agent.endEpisode();
+    result.winner = env.checkWin();
+    result.moves = moves;
+    return result;
+}
+
+EpisodeResult playSelfPlayEpisode(QLearningAgent& agent1, QLearningAgent& agent2) {
+    TicTacToe env;
+    int currentPlayer = 1;
+    EpisodeResult result;
+    int moves = 0;
+
+    // in the multi-step modes a move is learnt from once the other side
+    // has replied, as in playTrainingEpisode: one TD error per move,
+    // terminal if the reply ended the game, else bootstrapped from the
+    // position the side moves from next. one-step keeps its update
+    // straight after the move
+    struct Waiting {
+        std::string state;
+        int action = -1;
+    } waiting[2];
+
+    while (!env.isGameOver()) {
+        QLearningAgent& currentAgent = (currentPlayer == 1) ? agent1 : agent2;
+        QLearningAgent& otherAgent = (currentPlayer == 1) ? agent2 : agent1;
+        Waiting& otherWaiting = waiting[2 - currentPlayer];
+
+        std::string stateStr = currentAgent.encodeBoard(env.getBoard());
+        int action = currentAgent.chooseAction(env);
+        if (action < 0) {
+            break;
+        }
+
+        int x, y;
+        QLearningAgent::fromActionIndex(action, x, y);
+        env.makeMove(x, y, currentPlayer);
+        result.actions[moves++] = uint8_t(action);
+
+        bool over = env.isGameOver();
+        if (otherWaiting.action >= 0) {
+            if (over) {
+                otherAgent.updateQ(otherWaiting.state, otherWaiting.action, "",
+                                   rewardFor(env.checkWin(), 3 - currentPlayer), true);
+            } else {
+                otherAgent.updateQ(otherWaiting.state, otherWaiting.action,
+                                   otherAgent.encodeBoard(env.getBoard()), 0.0, false);
+            }
+            otherWaiting.action = -1;
+        }
+
+        if (over) {
+            double reward = rewardFor(env.checkWin(), currentPlayer);
+            currentAgent.updateQ(stateStr, action, /*nextState=*/"", reward, /*terminal=*/true);
+            break;
+        } else if (currentAgent.getUpdateMode() != UpdateMode::OneStep) {
+            waiting[currentPlayer - 1] = { stateStr, action };
+        } else {
+            std::string nextState = currentAgent.encodeBoard(env.getBoard());
+            currentAgent.updateQ(stateStr, action, nextState, 0.0, /*terminal=*/false);
+        }
+
+        currentPlayer = 3 - currentPlayer;
+    }
+    agent1.endEpisode();
+    agent2.endEpisode();
+    result.winner = env.checkWin();
+    result.moves = moves;
+    return result;
+}
+
+// shared loop: episode counting, progress lines, telemetry and checkpoints
+template <typename PlayEpisode>
+static void runTraining(QLearningAgent& agent, QLearningAgent* agent2,
+                        long long totalEpisodes, TrainingRun& run,
+                        PlayEpisode playEpisode) {
+    using namespace std::chrono;
+    auto start = high_resolution_clock::now();
+    long long startEpisodes = run.state.episodes;
+
+    // files are written on a background thread, training carries on
+    PolicySnapshotter writer;
+
+    // carry on the random streams of a resumed run
+    if (!run.state.agentRng.empty()) agent.getRng().loadState(run.state.agentRng);
+    if (agent2 && !run.state.agent2Rng.empty()) agent2->getRng().loadState(run.state.agent2Rng);
+    if (!run.state.opponentRng.empty()) run.opponentRng.loadState(run.state.opponentRng);
+
+    TrainingTelemetry telemetry;
+    if (run.telemetryEvery > 0 && !run.telemetryFile.empty()) {
+        telemetry.open(run.telemetryFile, run.state.episodes, run.telemetryWindow);
+    }
+
+    // a resumed run starts a new record file rather than appending to one
+    GameRecordWriter recorder;
+    if (!run.recordFile.empty()) {
+        GameRecordHeader header;
+        header.seed = run.state.seed;
+        header.player1 = "qlearning";
+        header.player2 = (run.state.opponent == "selfplay") ? "qlearning" : run.state.opponent;
+        recorder.open(run.recordFile, header);
+    }
+
+    if (run.snapshotEvery > 0 && run.snapshotEvery < kMinSnapshotEvery) {
+        std::cout << "snapshots every " << kMinSnapshotEvery << " episodes, not "
+                  << run.snapshotEvery << "\n";
+        run.snapshotEvery = kMinSnapshotEvery;
+    }
+
+    bool scheduled = run.params.decays() && totalEpisodes > 0;
+    while (run.state.episodes < totalEpisodes) {
+        if (scheduled) {
+            double progress = double(run.state.episodes) / double(totalEpisodes);
+            applyHyperParams(agent, run.params, progress);
+            if (agent2) applyHyperParams(*agent2, run.params, progress);
+        }
+        EpisodeResult result;
+        {
+            PROFILE_SCOPE("training/episode");
+            result = playEpisode();
+        }
+        run.state.episodes++;
+        telemetry.record(result.winner, result.moves);
+        if (recorder.isOpen()) {
+            GameRecord game;
+            game.count = result.moves;
+            game.winner = result.winner;
+            std::copy(result.actions, result.actions + result.moves, game.moves);
+            recorder.write(game);
+        }
+
+        if ((run.state.episodes - startEpisodes) % 1000 == 0) {
+            printProgress(run.state.episodes, totalEpisodes, startEpisodes, start);
+        }
+        if (run.telemetryEvery > 0 && run.state.episodes % run.telemetryEvery == 0) {
+            PROFILE_SCOPE("training/telemetry");
+            telemetry.sample(run.state.episodes, agent, agent2);
+        }
+        if (run.snapshotEvery > 0 && run.state.episodes % run.snapshotEvery == 0) {
+            PROFILE_SCOPE("training/snapshot");
+            writeSnapshot(agent, agent2, run, writer);
+        }
+        if (run.checkpointEvery > 0 && run.state.episodes % run.checkpointEvery == 0
+            && run.state.episodes < totalEpisodes) {
+            PROFILE_SCOPE("training/checkpoint");
+            writeCheckpoint(agent, agent2, run, writer);
+        }
+    }
+
+    agent.flushUpdates();
+    if (agent2) agent2->flushUpdates();
+    writeCheckpoint(agent, agent2, run, writer);
+    writer.wait();
+    std::cout << "Finished training " << run.state.episodes - startEpisodes
+              << " episodes (" << run.state.episodes << " in total).\n";
+}
+
+void trainAgainst(QLearningAgent& agent, const OpponentMoveFn& opponent,
+                  long long totalEpisodes, TrainingRun& run) {
+    runTraining(agent, nullptr, totalEpisodes, run,
+                [&]() { return playTrainingEpisode(agent, opponent); });
+}
+
+// opponent, except where run.book has the position
+static OpponentMoveFn withBook(TrainingRun& run, OpponentMoveFn opponent) {
+    if (!run.book) {
+        return opponent;
+    }
+    return [&run, opponent](TicTacToe& env, int player) {
+        Move m = run.book->pickMove(env, run.opponentRng);
+        return m.x >= 0 ? m : opponent(env, player);
+    };
+}
+
+void trainQAgent(QLearningAgent& agent, Minimax& minimaxPlayer,
+                 long long totalEpisodes, TrainingRun& run) {
+    run.state.opponent = "minimax";
+    trainAgainst(agent, withBook(run, [&](TicTacToe& env, int player) {
+        return minimaxPlayer.getBestMove(env, player, run.opponentRng);
+    }), totalEpisodes, run);
+}
+
+void trainQAgentVsRandom(QLearningAgent& agent, long long totalEpisodes, TrainingRun& run) {
+    run.state.opponent = "random";
+    trainAgainst(agent, [&](TicTacToe& env, int player) {
+        return getRandomMove(env, player, run.opponentRng);
+    }, totalEpisodes, run);
+}
+
+void trainQAgentVsBuggy(QLearningAgent& agent, long long totalEpisodes, TrainingRun& run) {
+    run.state.opponent = "buggy";
+    trainAgainst(agent, [&](TicTacToe& env, int player) {
+        return getBuggyMinimaxMove(env, player, run.opponentRng);
+    }, totalEpisodes, run);
+}
+
+void trainQAgentVsBuggy2(QLearningAgent& agent, long long totalEpisodes, TrainingRun& run) {
+    run.state.opponent = "buggy2";
+    trainAgainst(agent, [&](TicTacToe& env, int player) {
+        return getBuggyMinimaxMove2(env, player, run.opponentRng);
+    }, totalEpisodes, run);
+}
+
+void trainSelfPlay(QLearningAgent& agent1, QLearningAgent& agent2,
+                   long long totalEpisodes, TrainingRun& run) {
+    run.state.opponent = "selfplay";
+    runTraining(agent1, &agent2, totalEpisodes, run,
+                [&]() { return playSelfPlayEpisode(agent1, agent2); });
+}
@@ -0,0 +1,156 @@
+#ifndef TRAINING_H
+#define TRAINING_H
+
+#include <string>
+#include <functional>
+#include <memory>
+#include "tic_tac_toe.h"
+#include "minimax.h"
+#include "qlearning.h"
+#include "rng.h"
+
+// progress of a training run, stored next to its policy as <policy>.meta
+// so the run can be continued later instead of starting from zero
+struct TrainingCheckpoint {
+    std::string opponent = "";  // minimax, random, buggy, buggy2 or selfplay
+    long long episodes = 0;     // episodes trained so far
+    uint64_t seed = 0;          // root seed the run was started with
+    std::string agentRng;       // Rng::saveState of each stream, empty if unknown
+    std::string agent2Rng;
+    std::string opponentRng;
+    double alpha = 0.1;
+    double gamma = 1.0;
+    double epsilon = 0.2;
+    std::string update = "one-step";   // updateModeName, lambda only for qlambda
+    double lambda = 0.8;
+};
+
+// <policyFile>.meta
+std::string checkpointMetaFile(const std::string& policyFile);
+
+// sidecar file contents
+std::string formatCheckpointMeta(const TrainingCheckpoint& cp);
+
+bool saveCheckpointMeta(const std::string& policyFile, const TrainingCheckpoint& cp);
+
+// returns false if there is no readable sidecar for policyFile
+bool loadCheckpointMeta(const std::string& policyFile, TrainingCheckpoint& cp);
+
+// how alpha or epsilon moves from its start to its end value over a run
+enum class Decay {
+    None,          // stays at start
+    Linear,
+    Exponential    // start * (end / start)^progress; linear unless both are > 0
+};
+
+struct Schedule {
+    double start = 0.0;
+    double end = 0.0;
+    Decay decay = Decay::None;
+
+    // value once progress (0 to 1) of the run is done
+    double at(double progress) const;
+};
+
+// "none", "linear", "exp"
+const char* decayName(Decay decay);
+bool parseDecay(const std::string& name, Decay& decay);
+
+// learning hyperparameters of a run; the defaults are the values
+// tic_tac_toe and train_selfplay have always trained with
+struct HyperParams {
+    Schedule alpha = { 0.1, 0.1, Decay::None };
+    double gamma = 1.0;
+    Schedule epsilon = { 0.2, 0.2, Decay::None };
+    UpdateMode update = UpdateMode::OneStep;
+    double lambda = 0.8;
+
+    bool decays() const { return alpha.decay != Decay::None || epsilon.decay != Decay::None; }
+};
+
+// reads --alpha A[:END], --gamma G, --epsilon E[:END],
+// --decay none|linear|exp, --update one-step|qlambda|mc and --lambda L
+// from argv; an END turns decay on (linear unless --decay says otherwise)
+HyperParams hyperParamsFromArgs(int argc, char** argv);
+
+// sets agent's alpha, gamma and epsilon for progress (0 to 1) of a run
+void applyHyperParams(QLearningAgent& agent, const HyperParams& params, double progress);
+
+// numbered snapshots are not taken more often than this. each one copies
+// the table on the training thread and writes a file on the snapshot
+// thread; on one core, every 10000 episodes costs about 5% of training
+// time, every 1000 about 25%
+const long long kMinSnapshotEvery = 10000;
+
+// output files and checkpoint schedule of a training run
+struct TrainingRun {
+    std::string policyFile;        // checkpoints overwrite this file
+    std::string policyFile2;       // second agent's file, self-play only
+    long long checkpointEvery = 0; // 0 => save only when the run ends
+    long long snapshotEvery = 0;   // extra copies as <stem>_ep<N>.dat, 0 => none, else >= kMinSnapshotEvery
+    std::string telemetryFile;     // see telemetry.h, .csv for CSV, else JSON lines
+    long long telemetryEvery = 0;  // 0 => no telemetry
+    int telemetryWindow = 1000;    // episodes in the win/draw/loss rates
+    std::string recordFile;        // every episode as a game record (game_record.h), "" => none
+    HyperParams params;            // applied every episode if it decays, by episodes / total
+    std::shared_ptr<const OpeningBook> book;   // the minimax opponent plays from it, nullptr => none
+    TrainingCheckpoint state;
+    Rng opponentRng = makeStream(nextStreamId());
+};
+
+// q_policy.dat, 5000 => q_policy_ep5000.dat
+std::string snapshotFile(const std::string& policyFile, long long episodes);
+
+// <stem>_telemetry.jsonl next to a policy file
+std::string telemetryFile(const std::string& policyFile);
+
+// how a game went: winner (0 for a draw), number of moves played and
+// the moves themselves as action indices
+struct EpisodeResult {
+    int winner;
+    int moves;
+    uint8_t actions[9];
+};
+
+// opponent callback, returns the move for player on game
+typedef std::function<Move(TicTacToe&, int)> OpponentMoveFn;
+
+// one game with agent as player 1, learning after each of its moves
+// (or at the end, in the MonteCarlo update mode)
+EpisodeResult playTrainingEpisode(QLearningAgent& agent, const OpponentMoveFn& opponent);
+
+// one self-play game, each agent learns from its own moves (in the
+// multi-step update modes once the other side has replied)
+EpisodeResult playSelfPlayEpisode(QLearningAgent& agent1, QLearningAgent& agent2);
+
+// trains agent as player 1 against opponent as player 2 until
+// run.state.episodes reaches totalEpisodes, checkpointing along the way
+void trainAgainst(QLearningAgent& agent, const OpponentMoveFn& opponent,
+                  long long totalEpisodes, TrainingRun& run);
+
+void trainQAgent(QLearningAgent& agent, Minimax& minimaxPlayer,
+                 long long totalEpisodes, TrainingRun& run);
+
+void trainQAgentVsRandom(QLearningAgent& agent, long long totalEpisodes, TrainingRun& run);
+
+void trainQAgentVsBuggy(QLearningAgent& agent, long long totalEpisodes, TrainingRun& run);
+
+void trainQAgentVsBuggy2(QLearningAgent& agent, long long totalEpisodes, TrainingRun& run);
+
+// agent1 plays as player 1, agent2 as player 2, both learn
+void trainSelfPlay(QLearningAgent& agent1, QLearningAgent& agent2,
+                   long long totalEpisodes, TrainingRun& run);
+
+// loads policyFile into agent along with its sidecar, if there is one;
+// without a sidecar the table is still loaded but counting starts at 0
+// and agent keeps the settings of params.
+//
+// a sidecar describes the run being continued, so its update mode,
+// lambda, alpha, gamma and epsilon are applied over params, with a
+// message for each flag that differs. the one exception is a decaying
+// params: its schedule sets alpha, gamma and epsilon every episode, by
+// episodes done out of the new total, as in a fresh run
+bool resumeTraining(QLearningAgent& agent, const std::string& policyFile,
+                    const HyperParams& params, TrainingCheckpoint& state);
+
+#endif